@@ -26,7 +26,7 @@ void BBDeltaBackend::updateBackend(Task* currentTask)
             uint32_t bbid = 0, lastBBID = 0;
             uint64_t prevTime = 0, currTime = 0, delta = 0;
             bool lastBlockCall = false, hasUninstCall = false , hasUninstTime = false;
-            string lastFuncName;
+            uint lastFuncId = 0;
             auto bba = currentTask->getBasicBlockActions();
             for (auto f = bba.begin(), e = bba.end(); f != e; ++f)
             {
@@ -38,13 +38,13 @@ void BBDeltaBackend::updateBackend(Task* currentTask)
                 
                 if (lastBlockCall || bbCall == bbInstCall.end())
                 {
-                    auto bbi = tgi->getBasicBlockInfo(bbid);
+                    const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(bbid);
                     if (lastBlockCall)
                     {
                         // There was a function call in the last basic block
                         //   If the next block is in the same function, then
                         //   the function was not instrumented, or recursion?
-                        if (lastFuncName == bbi.functionName)
+                        if (lastFuncId == bbi.functionId)
                         {
                             bbInstCall[lastBBID] = false;
                         }
@@ -59,7 +59,7 @@ void BBDeltaBackend::updateBackend(Task* currentTask)
                         if((bbi.flags & BBI_FLAG_CONTAIN_CALL) == BBI_FLAG_CONTAIN_CALL)
                         {
                             lastBlockCall = true;
-                            lastFuncName = bbi.functionName;
+                            lastFuncId = bbi.functionId;
                         }
                         else
                         {
@@ -130,7 +130,7 @@ void BBDeltaBackend::completeBackend(FILE* f, contech::TaskGraphInfo* tgi)
     for (auto it = bbHistogram.begin(), et = bbHistogram.end(); it != et; ++it)
     {
         fprintf(f, "%u, ",it->first);
-        auto bbi = tgi->getBasicBlockInfo(it->first);
+        const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(it->first);
         auto bbic = bbInstCall.find(it->first);
         
         fprintf(f, "%u, %u, %u, %u, %u, ", bbi.flags, (!bbic->second), bbi.numOfMemOps, bbi.numOfOps, bbi.critPathLen);
@@ -139,7 +139,7 @@ void BBDeltaBackend::completeBackend(FILE* f, contech::TaskGraphInfo* tgi)
         {
             fprintf(f, "%u, %u, ", itv->first, itv->second);
         }
-        fprintf(f, "%s:%d\n", bbi.fileName.c_str(), bbi.lineNumber);
+        fprintf(f, "%s:%d\n", tgi->getString(bbi.fileId), bbi.lineNumber);
     }
     fflush(f);
 }
@@ -35,8 +35,10 @@ int main(int argc, char const *argv[])
     map <unsigned int, set<ContextId> > bbExecMap;
     bool firstCreate = false;
     
-    while(Task* currentTask = tg->readContechTask())
+    Task current;
+    while (tg->readNextInto(current))
     {
+        Task* currentTask = &current;
         TaskId ctui = currentTask->getTaskId();
         ContextId ctci = currentTask->getContextId();
         
@@ -48,7 +50,6 @@ int main(int argc, char const *argv[])
         {
             if (currentTask->getType() != task_type_create)
             {
-                delete currentTask;
                 continue;
             }
             firstCreate = true;
@@ -61,8 +62,6 @@ int main(int argc, char const *argv[])
             
             bbExecMap[bbid].insert(ctci);
         }
-        
-        delete currentTask;
     }
     delete tg;
     
@@ -253,6 +253,7 @@ void bbCommAnalysisFromSrc(CommTracker* tracker, TaskGraph& taskGraph, string ou
     int i=0;
     clock_t t;
     unsigned long bbCount = 0;
+    Task src;
     for (CommRecord r : tracker->getRecords())
     {
         /*
@@ -271,7 +272,8 @@ void bbCommAnalysisFromSrc(CommTracker* tracker, TaskGraph& taskGraph, string ou
         }
         */
         // Obtain a signature of the source based on the basic blocks it executed
-        Task* srcTask = taskGraph.getTaskById(r.sender);
+        if (!taskGraph.readByIdInto(r.sender, src)) continue;
+        Task* srcTask = &src;
         bbCount += srcTask->getBasicBlockActions().size();
         
         
@@ -349,6 +351,7 @@ void bbCommAnalysisFromDst(CommTracker* tracker, TaskGraph& taskGraph, string ou
     int i=0;
     clock_t t;
     unsigned long bbCount = 0;
+    Task dst;
     for (CommRecord r : tracker->getRecords())
     {
 
@@ -370,7 +373,8 @@ void bbCommAnalysisFromDst(CommTracker* tracker, TaskGraph& taskGraph, string ou
 
         // Obtain a signature of the destination based on the basic blocks it executed
         //cout << "Receiver: " << r.receiver << endl;
-        Task* dstTask = taskGraph.getTaskById(r.receiver);
+        if (!taskGraph.readByIdInto(r.receiver, dst)) continue;
+        Task* dstTask = &dst;
         bbCount += dstTask->getBasicBlockActions().size();
         
         
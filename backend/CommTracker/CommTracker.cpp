@@ -191,8 +191,10 @@ CommTracker* CommTracker::fromFile(FILE* taskGraphIn)
     CommTracker* tracker = new CommTracker();
     TaskGraph* taskGraph = TaskGraph::initFromFile(taskGraphIn);
 
-    while(Task* currentTask = taskGraph->readContechTask())
+    Task current;
+    while (taskGraph->readNextInto(current))
     {
+        Task* currentTask = &current;
         TaskId uid = currentTask->getTaskId();
 
         // Iterate through every basic block
@@ -271,8 +273,6 @@ CommTracker* CommTracker::fromFile(FILE* taskGraphIn)
                 }
             }
         }
-
-        delete currentTask;
     }
     
     delete taskGraph;
@@ -333,13 +333,13 @@ int main(int argc, char const *argv[])
             BasicBlockAction bba = *it;
             if (bbS.find(bba.basic_block_id) == bbS.end())
             {
-                auto bbi = tgi->getBasicBlockInfo(bba.basic_block_id);
+                const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(bba.basic_block_id);
                 bbS.insert(bba.basic_block_id);
            
                 fprintf(stderr, "%u, %s, %s:%u, %d / %d\n", 
                                                      bba.basic_block_id, 
-                                                     bbi.functionName.c_str(), 
-                                                     bbi.fileName.c_str(),
+                                                     tgi->getString(bbi.functionId), 
+                                                     tgi->getString(bbi.fileId),
                                                  bbi.lineNumber,
                                                  bbi.critPathLen, bbi.numOfOps);
             }
@@ -350,8 +350,10 @@ int main(int argc, char const *argv[])
     }*/
     #if DEADLINE
 	tg->setTaskOrderCurrent(roiStart);
-    while (Task* currentTask = tg->getNextTask())
+    Task deadlineTask;
+    while (tg->readNextInto(deadlineTask))
     {
+        Task* currentTask = &deadlineTask;
         TaskId tid = currentTask->getTaskId();
         task_type tt = currentTask->getType();
         uint32_t lastBBId = 0;
@@ -383,8 +385,6 @@ int main(int argc, char const *argv[])
             
             staticBBMap[lastBBId][firstBBId].v[sRes] += (dur - nTime);
         }
-        
-        delete currentTask;
     }
     
     
@@ -416,8 +416,10 @@ int main(int argc, char const *argv[])
 	//   It should start at ROI end and work backward through the predecessors
 	//      For each task, look at its length and compute the schedule
 	//   For implementation, we will traverse and record these details
-    while (Task* currentTask = tg->getNextTask())
+    Task current;
+    while (tg->readNextInto(current))
 	{
+		Task* currentTask = &current;
 		TaskPathNode tpn;
 		TaskId tid = currentTask->getTaskId();
         task_type tt = currentTask->getType();
@@ -713,7 +715,6 @@ int main(int argc, char const *argv[])
            //printf("%s: %llu <-> %llu\n", tid.toString().c_str(), lastContextTime[tid.getContextId()], tpn.length[BASE_PATH]);
         }
         
-		delete currentTask;
 		if (tid == roiEnd) break;
 	}
 	
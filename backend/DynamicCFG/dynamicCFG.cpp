@@ -53,31 +53,77 @@ int main(int argc, char const *argv[])
     TaskGraph* tg = TaskGraph::initFromFile(taskGraphIn);
     if (tg == NULL) {}
 
-    while(Task* currentTask = tg->readContechTask()){
-        BasicBlock* bb;
-        for (BasicBlockAction a : currentTask->getBasicBlockActions())
+    // Tasks with the same basic block sequence run the same blocks with the same
+    //   edges between them, so each sequence is walked once and its counts reused
+    struct SequenceBlocks
+    {
+        vector<pair<BasicBlock*, uint32_t> > runCounts;
+        BasicBlock* first;
+        BasicBlock* last;
+    };
+    map<uint32_t, SequenceBlocks> sequenceBlocks;
+
+    Task current;
+    while (tg->readNextInto(current)){
+        Task* currentTask = &current;
+        BasicBlock* bb = NULL;
+        uint32_t ctx = (uint32_t)currentTask->getContextId();
+        uint32_t seqId = currentTask->getSequenceId();
+        auto sb = (seqId != 0) ? sequenceBlocks.find(seqId) : sequenceBlocks.end();
+
+        if (sb != sequenceBlocks.end())
         {
-            // Look up / create the basic block
-            bb = basicBlocks[a.basic_block_id];
-            if (bb == NULL)
+            for (auto& rc : sb->second.runCounts)
             {
-                bb = new BasicBlock(a.basic_block_id);
-                basicBlocks[a.basic_block_id] = bb;
+                rc.first->setRunCount(rc.first->getRunCount() + rc.second);
+                maxRunCount = max(rc.first->getRunCount(), maxRunCount);
             }
+            if (lastBlock[ctx] != NULL)
+            {
+                edgeSet.insert(make_pair(lastBlock[ctx]->getID(), sb->second.first->getID()));
+            }
+            bb = sb->second.last;
+            lastBlock[ctx] = bb;
+        }
+        else
+        {
+            map<BasicBlock*, uint32_t> taskRunCount;
+            BasicBlock* firstBlock = NULL;
 
-            // Increment the run count for this block
-            bb->incrementRunCount();
-
-            // Keep track of the largest run count for any block
-            maxRunCount = max(bb->getRunCount(), maxRunCount);
-
-            // Make an edge from the last block to run in this contech to this one
-            if (lastBlock[(uint32_t)currentTask->getContextId()] != NULL)
+            for (BasicBlockAction a : currentTask->getBasicBlockActions())
             {
-                edgeSet.insert(make_pair(lastBlock[(uint32_t)currentTask->getContextId()]->getID(), (uint32_t)a.basic_block_id));
+                // Look up / create the basic block
+                bb = basicBlocks[a.basic_block_id];
+                if (bb == NULL)
+                {
+                    bb = new BasicBlock(a.basic_block_id);
+                    basicBlocks[a.basic_block_id] = bb;
+                }
+
+                // Increment the run count for this block
+                bb->incrementRunCount();
+                if (seqId != 0) taskRunCount[bb]++;
+                if (firstBlock == NULL) firstBlock = bb;
+
+                // Keep track of the largest run count for any block
+                maxRunCount = max(bb->getRunCount(), maxRunCount);
+
+                // Make an edge from the last block to run in this contech to this one
+                if (lastBlock[ctx] != NULL)
+                {
+                    edgeSet.insert(make_pair(lastBlock[ctx]->getID(), (uint32_t)a.basic_block_id));
+                }
+
+                lastBlock[ctx] = bb;
             }
 
-            lastBlock[(uint32_t)currentTask->getContextId()] = bb;
+            if (seqId != 0 && firstBlock != NULL)
+            {
+                SequenceBlocks& seq = sequenceBlocks[seqId];
+                seq.runCounts.assign(taskRunCount.begin(), taskRunCount.end());
+                seq.first = firstBlock;
+                seq.last = bb;
+            }
         }
 
         //cout << "Processed " << currentTask->getBasicBlocks().size() << " basic blocks from task " << currentTask->getContextId() << ":" << currentTask->getSeqId() << endl;
@@ -111,8 +157,6 @@ int main(int argc, char const *argv[])
                 lastBasicBlock->setType(currentTask->getType());
             }
         }
-
-        delete currentTask;
     }
     
     delete tg;
@@ -155,12 +155,13 @@ void hbRaceDetector(FILE* taskGraphIn)
     bool inROI = false;
     uint64_t numRaceAccesses = 0;
 
-    while(Task* currentTask = tg->readContechTask())
+    Task current;
+    while (tg->readNextInto(current))
     {
-            
+        Task* currentTask = &current;
         TaskId tid = currentTask->getTaskId();
         if (tid == roiStart) {inROI = true;}
-        if (tid == roiEnd) {delete currentTask; break;}
+        if (tid == roiEnd) {break;}
         if(printVerbose){
                 cout << "Processing task with CTID:  " << tid << endl; 
                 cout << "Num Mem Actions: " << currentTask->getMemoryActions().size() << endl;
@@ -295,8 +296,6 @@ void hbRaceDetector(FILE* taskGraphIn)
                 }
             }
         }
-
-        delete currentTask;
     }
     delete tg;
     
@@ -338,20 +337,20 @@ void reportRace(MemoryAction existingMop,
         << newTID << ")\n" << endl;
     cerr << bb << endl;
     {
-        auto bbi = tgi->getBasicBlockInfo(srcBBID);
+        const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(srcBBID);
         fprintf(stderr, "%u, %s, %s:%u\n",
                                          srcBBID, 
-                                         bbi.functionName.c_str(), 
-                                         bbi.fileName.c_str(),
+                                         tgi->getString(bbi.functionId), 
+                                         tgi->getString(bbi.fileId),
                                      bbi.lineNumber);
     }
     {
         unsigned int bbid = bb.basic_block_id;
-        auto bbi = tgi->getBasicBlockInfo(bbid);
+        const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(bbid);
         fprintf(stderr, "%u, %s, %s:%u\n",
                                          bbid, 
-                                         bbi.functionName.c_str(), 
-                                         bbi.fileName.c_str(),
+                                         tgi->getString(bbi.functionId), 
+                                         tgi->getString(bbi.fileId),
                                      bbi.lineNumber);
     }                             
     cerr << endl;
@@ -0,0 +1,213 @@
+#include "coarsen.hpp"
+
+using namespace std;
+using namespace contech;
+
+CoarsenBackend::CoarsenBackend(TaskGraphWriter* o, uint64_t d) : out(o), minDuration(d)
+{
+    roiSet = false;
+    resetBackend();
+}
+
+void CoarsenBackend::setROI(TaskId start, TaskId end)
+{
+    roiStart = start;
+    roiEnd = end;
+    roiSet = true;
+}
+
+void CoarsenBackend::resetBackend()
+{
+    pending.clear();
+    pendingBase = 0;
+    chains.clear();
+    renames.clear();
+    tasksIn = 0;
+    tasksOut = 0;
+    chainCount = 0;
+}
+
+//
+// Only basic block tasks, a sync task records its lock as a memory action
+//
+bool CoarsenBackend::isMergeable(Task& t)
+{
+    return t.getType() == task_type_basic_blocks;
+}
+
+//
+// Must a chain end with t, as it has a successor in another context?
+//
+bool CoarsenBackend::endsChain(Task& t)
+{
+    vector<TaskId>& succ = t.getSuccessorTasks();
+    if (!isMergeable(t) || succ.empty()) return true;
+    for (TaskId s : succ)
+    {
+        if (s.getContextId() != t.getContextId()) return true;
+    }
+
+    return false;
+}
+
+bool CoarsenBackend::canMerge(Chain& ch, Task& t)
+{
+    Task& merged = pending[ch.pos - pendingBase].task;
+
+    if (t.getTaskId() != ch.last.getNext()) return false;
+    if (!isMergeable(t)) return false;
+    if (merged.getEndTime() - merged.getStartTime() >= minDuration) return false;
+
+    TaskId first = merged.getTaskId();
+    for (TaskId p : t.getPredecessorTasks())
+    {
+        if (p < first || p > ch.last) return false;
+    }
+
+    return true;
+}
+
+void CoarsenBackend::renamePredecessors(Task& t)
+{
+    if (renames.empty()) return;
+
+    vector<TaskId>& pred = t.getPredecessorTasks();
+    bool renamed = false;
+    for (TaskId& p : pred)
+    {
+        auto it = renames.find(p);
+        if (it == renames.end()) continue;
+
+        p = it->second.first;
+        renamed = true;
+        if (--it->second.second == 0) renames.erase(it);
+    }
+
+    // Several tasks of a chain may precede t
+    if (renamed)
+    {
+        for (size_t i = 1; i < pred.size(); i++)
+        {
+            if (find(pred.begin(), pred.begin() + i, pred[i]) != pred.begin() + i)
+            {
+                pred.erase(pred.begin() + i);
+                i--;
+            }
+        }
+    }
+}
+
+void CoarsenBackend::endChain(map<ContextId, Chain>::iterator it)
+{
+    Chain& ch = it->second;
+    PendingTask& pt = pending[ch.pos - pendingBase];
+    TaskId first = pt.task.getTaskId();
+
+    // Successors after the chain will name the merged tasks as predecessors
+    for (auto& m : ch.merged)
+    {
+        uint32_t uses = 0;
+        for (TaskId s : m.second)
+        {
+            if (s.getContextId() != first.getContextId() || s > ch.last) uses++;
+        }
+        if (uses > 0) renames[m.first] = make_pair(first, uses);
+    }
+    if (!ch.merged.empty()) chainCount++;
+
+    pt.open = false;
+    chains.erase(it);
+}
+
+void CoarsenBackend::endChains()
+{
+    while (!chains.empty())
+    {
+        endChain(chains.begin());
+    }
+    writePending();
+}
+
+void CoarsenBackend::writePending()
+{
+    while (!pending.empty() && !pending.front().open)
+    {
+        out->addTask(pending.front().task);
+        tasksOut++;
+        pending.pop_front();
+        pendingBase++;
+    }
+}
+
+void CoarsenBackend::updateBackend(Task* t)
+{
+    ContextId ctx = t->getContextId();
+    TaskId tid = t->getTaskId();
+
+    tasksIn++;
+    if (roiSet && (tid == roiStart || tid == roiEnd))
+    {
+        // No chain spans the ROI's start or end in the task order
+        endChains();
+    }
+    auto it = chains.find(ctx);
+    if (it != chains.end())
+    {
+        Chain& ch = it->second;
+        if (canMerge(ch, *t))
+        {
+            pending[ch.pos - pendingBase].task.mergeTask(*t);
+            ch.last = tid;
+            ch.merged.push_back(make_pair(tid, t->getSuccessorTasks()));
+            if (endsChain(*t))
+            {
+                endChain(it);
+                writePending();
+            }
+            return;
+        }
+
+        // t does not depend on the chain, other than as the next task of its context
+        endChain(it);
+        writePending();
+    }
+
+    renamePredecessors(*t);
+    bool open = !endsChain(*t) && !(roiSet && tid == roiEnd);
+    if (!open && pending.empty())
+    {
+        out->addTask(*t);
+        tasksOut++;
+        return;
+    }
+
+    pending.push_back(PendingTask());
+    pending.back().task.swap(*t);
+    pending.back().open = open;
+    if (open)
+    {
+        Chain& ch = chains[ctx];
+        ch.pos = pendingBase + pending.size() - 1;
+        ch.last = tid;
+    }
+
+    while (pending.size() > COARSEN_PENDING_DEPTH && pending.front().open)
+    {
+        endChain(chains.find(pending.front().task.getContextId()));
+        writePending();
+    }
+}
+
+void CoarsenBackend::completeBackend(FILE* f, TaskGraphInfo* tgi)
+{
+    endChains();
+
+    if (roiSet) out->setROI(roiStart, roiEnd);
+    bool valid = out->close();
+
+    fprintf(f, "Coarsened %lu tasks into %lu, with %lu merged chains\n", tasksIn, tasksOut, chainCount);
+    if (!valid)
+    {
+        fprintf(f, "Coarsened graph has edges out of the task order\n");
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef COARSEN_HPP
+#define COARSEN_HPP
+
+#include <Backend.hpp>
+#include <TaskGraphWriter.hpp>
+#include <map>
+#include <deque>
+#include <unordered_map>
+
+// Tasks held behind the oldest unfinished chain
+#define COARSEN_PENDING_DEPTH 65536
+
+//
+// Writes a coarser copy of a task graph, merging chains of tasks in a context
+//
+//   A chain is a run of tasks of one context, in sequence order, whose interior
+//   edges are only within the context: each task after the first only has
+//   predecessors in the chain, and each task before the last only has successors
+//   in its own context.  The tasks are basic block tasks, so every sync task is
+//   kept, as its lock is recorded as a memory action that would otherwise read
+//   as an access.  The merged task has the id of the first task, the actions of
+//   each task in order, the first start time and the last end time.
+//
+//   A chain stops growing once it runs for minDuration cycles, so that tasks
+//   are coarsened to about that duration without merging whole contexts.
+//
+//   Tasks are written in the order they are read, with each chain at the place
+//   of its first task.  Tasks after an unfinished chain are held until it ends,
+//   up to COARSEN_PENDING_DEPTH tasks, when the oldest chain is ended early.
+//   The tasks given to updateBackend are changed, so they must not be shared
+//   with other backends.
+//
+class CoarsenBackend : public contech::Backend
+{
+    // A task waiting to be written, open while it is a chain that may grow
+    struct PendingTask
+    {
+        contech::Task task;
+        bool open;
+    };
+
+    struct Chain
+    {
+        uint64_t pos;           // of the merged task in pending
+        contech::TaskId last;   // the last task merged
+        // The merged tasks after the first, with their successors
+        std::vector<std::pair<contech::TaskId, std::vector<contech::TaskId> > > merged;
+    };
+
+    contech::TaskGraphWriter* out;
+    uint64_t minDuration;
+    contech::TaskId roiStart;
+    contech::TaskId roiEnd;
+    bool roiSet;
+
+    // pendingBase is the number of tasks read before pending.front()
+    std::deque<PendingTask> pending;
+    uint64_t pendingBase;
+    // The open chains
+    std::map<contech::ContextId, Chain> chains;
+    // Merged tasks named by tasks not yet read, as the chain's id and the predecessor lists still naming it
+    std::unordered_map<contech::TaskId, std::pair<contech::TaskId, uint32_t> > renames;
+
+    uint64_t tasksIn;
+    uint64_t tasksOut;
+    uint64_t chainCount;
+
+    bool isMergeable(contech::Task& t);
+    bool endsChain(contech::Task& t);
+    bool canMerge(Chain& ch, contech::Task& t);
+    void renamePredecessors(contech::Task& t);
+    void endChain(std::map<contech::ContextId, Chain>::iterator it);
+    void endChains();
+    void writePending();
+
+public:
+    // The backend writes to out, and closes it once complete
+    CoarsenBackend(contech::TaskGraphWriter* out, uint64_t minDuration = ~0ULL);
+
+    // The ROI of the input, no chain spans its start or end in the task order
+    void setROI(contech::TaskId start, contech::TaskId end);
+
+    virtual void resetBackend();
+    virtual void updateBackend(contech::Task*);
+    virtual void completeBackend(FILE*, contech::TaskGraphInfo*);
+};
+
+#endif
@@ -474,15 +474,15 @@ void SimpleCacheBackend::completeBackend(FILE* f, contech::TaskGraphInfo* tgi)
         for (auto it = basicBlockMisses.begin(), et = basicBlockMisses.end(); it != et; ++it)
         {
             unsigned int bbid = ((it->first) >> 32);
-            auto bbi = tgi->getBasicBlockInfo(bbid);
+            const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(bbid);
             if ((((it->second) / (double)p_stats->misses) * 100.0) > 1.0)
             {
                 fprintf(f, "%u, %lf, %u, %u, %s, %s:%u\n", it->second, 
                                             (((it->second) / (double)p_stats->misses) * 100.0),
                                              bbid, 
                                              (unsigned int)(it->first), 
-                                             bbi.functionName.c_str(), 
-                                             bbi.fileName.c_str(),
+                                             tgi->getString(bbi.functionId), 
+                                             tgi->getString(bbi.fileId),
                                          bbi.lineNumber);
             }
         }
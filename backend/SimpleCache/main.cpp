@@ -1,15 +1,33 @@
 #include "simpleCache.hpp"
+#include <MultiBackendRunner.hpp>
+#include <ContextParallelRunner.hpp>
 #include <stdio.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+
+using namespace std;
 
 int main(int argc, char** argv)
 {
     if (argc < 2)
     {
-        fprintf(stderr, "%s <size of cache, log2> <taskgraph>\n", argv[0]);
+        fprintf(stderr, "%s [-p] <size of cache, log2> <taskgraph>\n", argv[0]);
+        fprintf(stderr, "\t-p\tgive each context a private cache, simulating the contexts in parallel\n");
+        fprintf(stderr, "\t\twithout the misses of each allocation, which need the tasks in order\n");
         return 1;
     }
     
-    if (argc == 3)
+    if (argc == 4 && 0 == strcmp(argv[1], "-p"))
+    {
+        SimpleCacheBackend* bsc = new SimpleCacheBackend(atoi(argv[2]), 2, 1, true);
+        contech::ContextParallelRunner* cpr = new contech::ContextParallelRunner(argv[3], bsc);
+        
+        cpr->runBackend();
+        cpr->completeRun(stdout);
+        delete cpr;
+        delete bsc;
+    }
+    else if (argc == 3)
     {
         SimpleCacheBackend* bsc = new SimpleCacheBackend(atoi(argv[1]), 2, 1);
         contech::SimpleBackendWrapper* sbw = new contech::SimpleBackendWrapper(argv[2], bsc);
@@ -21,14 +39,25 @@ int main(int argc, char** argv)
     }
     else
     {
+        // Every cache size is simulated from a single pass over the graph
+        contech::MultiBackendRunner* mbr = new contech::MultiBackendRunner(argv[1]);
+        vector<SimpleCacheBackend*> caches;
+        
         for (int c = 10; c <= 28; c++)
         {
             SimpleCacheBackend* bsc = new SimpleCacheBackend(c, 2, 0);
-            contech::SimpleBackendWrapper* sbw = new contech::SimpleBackendWrapper(argv[1], bsc);
+            string name = "cache 2^" + to_string(c);
+            caches.push_back(bsc);
+            mbr->addBackend(bsc, name.c_str());
+        }
+        mbr->setThreaded(get_nprocs() > 1);
         
-            sbw->runBackend();
-            sbw->completeRun(stdout);
-            delete sbw;
+        mbr->runBackends();
+        mbr->completeRun(stdout);
+        mbr->printTimes(stderr);
+        delete mbr;
+        for (SimpleCacheBackend* bsc : caches)
+        {
             delete bsc;
         }
     }
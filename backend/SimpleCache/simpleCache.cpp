@@ -8,21 +8,19 @@ using namespace contech;
 enum {BLOCKING, SUBBLOCKING};
 enum {LRU, NMRU_FIFO};
 
-// This would be better stored as static fields in the class
-static uint64_t global_c; 
+// The size and associativity are per cache, so caches of several sizes can run together
 static const uint64_t global_b = 6; 
-static uint64_t global_s; 
 static const char global_st = BLOCKING; 
 static const char global_r = LRU;
 
-SimpleCache::SimpleCache()
+SimpleCache::SimpleCache(uint64_t c, uint64_t s) : cacheSizeLog2(c), assocLog2(s)
 {
     //cacheBlocks.resize(0x1 << (SC_CACHE_SIZE - (SC_CACHE_ASSOC + SC_CACHE_LINE)));
-    cacheBlocks.resize(0x1 << (global_c - (global_s + global_b)));
+    cacheBlocks.resize(0x1 << (cacheSizeLog2 - (assocLog2 + global_b)));
     read_misses = 0;
     write_misses = 0;
     accesses = 0;
-    //printf("Cache created: %d of %d\n", cacheBlocks.size(), 0x1 << global_s); 
+    //printf("Cache created: %d of %d\n", cacheBlocks.size(), 0x1 << assocLog2); 
 }
 
 void SimpleCache::printIndex(uint64_t idx)
@@ -62,7 +60,7 @@ bool SimpleCache::updateCacheLine(uint64_t idx, uint64_t tag, uint64_t offset, u
     
     // The block is not in the cache
     //   First check if there is space to place it in the cache
-    if (cacheBlocks[idx].size() < (0x1<<global_s))
+    if (cacheBlocks[idx].size() < (0x1<<assocLog2))
     {
         cache_line t;
         
@@ -80,7 +78,7 @@ bool SimpleCache::updateCacheLine(uint64_t idx, uint64_t tag, uint64_t offset, u
     if (global_r == LRU)
     {
         cacheBlocks[idx].erase(oldest);
-        assert(cacheBlocks[idx].size() < (0x1 << global_s));
+        assert(cacheBlocks[idx].size() < (0x1 << assocLog2));
     }
     
     {
@@ -102,12 +100,12 @@ bool SimpleCache::updateCache(bool write, char numOfBytes, uint64_t address, cac
     uint64_t cacheIdx = address >> global_b;
     uint64_t offset = address & ((0x1<<global_b) - 1);
     uint64_t size = numOfBytes;
-    uint64_t tag = address >> ((global_c - global_s));
+    uint64_t tag = address >> ((cacheSizeLog2 - assocLog2));
     uint64_t accessCount = p_stats->accesses;
 
     assert(offset < (0x1 << global_b));
     
-    cacheIdx &= ((0x1 << (global_c - (global_b + global_s))) - 1);
+    cacheIdx &= ((0x1 << (cacheSizeLog2 - (global_b + assocLog2))) - 1);
     
     assert (cacheIdx < cacheBlocks.size());
     accesses++;
@@ -145,10 +143,12 @@ double SimpleCache::getMissRate()
     return (double)(read_misses + write_misses) / (double)(accesses);
 }
 
-SimpleCacheBackend::SimpleCacheBackend(uint64_t c, uint64_t s, int printMissLoc) {
-    global_c = c;
-    global_s = s;
-    assert(global_c >= (global_s + global_b));
+SimpleCacheBackend::SimpleCacheBackend(uint64_t c, uint64_t s, int printMissLoc, bool privateCaches) {
+    cacheSizeLog2 = c;
+    assocLog2 = s;
+    this->privateCaches = privateCaches;
+    trackAllocations = true;
+    assert(cacheSizeLog2 >= (assocLog2 + global_b));
     // zero out p_stats
     p_stats = new cache_stats_t;
     p_stats->accesses = 0;
@@ -165,7 +165,7 @@ void SimpleCacheBackend::updateBackend(Task* currentTask)
     //auto memOps = currentTask->getMemOps();
     ContextId ctid = currentTask->getContextId();
     bool rw = false;
-    ctid = 0;
+    if (!privateCaches) ctid = 0;
     
     uint64_t lastBBID = 0;
     auto bbOps = currentTask->getBasicBlockActions();
@@ -185,6 +185,7 @@ void SimpleCacheBackend::updateBackend(Task* currentTask)
                 ++iReq;
                 assert((*iReq).getType() == action_type_size);
                 uint32_t allocSize = ((MemoryAction)(*iReq)).addr;
+                if (!trackAllocations) continue;
                 
                 mallocStats ms;
                 ms.size = allocSize;
@@ -220,12 +221,12 @@ void SimpleCacheBackend::updateBackend(Task* currentTask)
                     bytesToAccess -= accessSize;
                     if (srcAddress != 0)
                     {
-                        contextCacheState[ctid].updateCache(false, accessSize, srcAddress, p_stats);
+                        getCache(ctid).updateCache(false, accessSize, srcAddress, p_stats);
                         srcAddress += accessSize;
                         p_stats->accesses ++;
                     }
                     
-                    contextCacheState[ctid].updateCache(true, accessSize, dstAddress, p_stats);
+                    getCache(ctid).updateCache(true, accessSize, dstAddress, p_stats);
                     dstAddress += accessSize;
                     p_stats->accesses ++;
                 } while (bytesToAccess > 0);
@@ -251,7 +252,7 @@ void SimpleCacheBackend::updateBackend(Task* currentTask)
                     rw = false;
                 }
                 
-                if (!contextCacheState[ctid].updateCache(rw, accessBytes, address, p_stats))
+                if (!getCache(ctid).updateCache(rw, accessBytes, address, p_stats))
                 {
                     basicBlockMisses[(lastBBID << 32) + memOpPos] ++;
                     auto elem = allocBlocks.upper_bound(address);
@@ -272,6 +273,52 @@ void SimpleCacheBackend::updateBackend(Task* currentTask)
     }
 }
 
+SimpleCacheBackend::~SimpleCacheBackend()
+{
+    delete p_stats;
+}
+
+Backend* SimpleCacheBackend::createContextBackend(ContextId ctx)
+{
+    if (!privateCaches) return NULL;
+    
+    SimpleCacheBackend* scb = new SimpleCacheBackend(cacheSizeLog2, assocLog2, printMissLines ? 1 : 0, true);
+    scb->trackAllocations = false;
+    
+    return scb;
+}
+
+//
+// The caches are disjoint, and the counts are summed
+//
+void SimpleCacheBackend::mergeContextBackend(Backend* ctxBackend)
+{
+    SimpleCacheBackend* scb = (SimpleCacheBackend*)ctxBackend;
+    
+    for (auto it = scb->contextCacheState.begin(), et = scb->contextCacheState.end(); it != et; ++it)
+    {
+        contextCacheState.insert(make_pair(it->first, std::move(it->second)));
+    }
+    for (auto it = scb->basicBlockMisses.begin(), et = scb->basicBlockMisses.end(); it != et; ++it)
+    {
+        basicBlockMisses[it->first] += it->second;
+    }
+    trackAllocations = false;
+    allocBlocks.clear();
+    p_stats->accesses += scb->p_stats->accesses;
+    p_stats->misses += scb->p_stats->misses;
+}
+
+SimpleCache& SimpleCacheBackend::getCache(ContextId ctid)
+{
+    auto it = contextCacheState.find(ctid);
+    if (it == contextCacheState.end())
+    {
+        it = contextCacheState.insert(make_pair(ctid, SimpleCache(cacheSizeLog2, assocLog2))).first;
+    }
+    return it->second;
+}
+
 void SimpleCacheBackend::resetBackend()
 {
     contextCacheState.clear();
@@ -318,19 +365,21 @@ void SimpleCacheBackend::completeBackend(FILE* f, contech::TaskGraphInfo* tgi)
         for (auto it = basicBlockMisses.begin(), et = basicBlockMisses.end(); it != et; ++it)
         {
             unsigned int bbid = ((it->first) >> 32);
-            auto bbi = tgi->getBasicBlockInfo(bbid);
+            const BasicBlockInfo& bbi = tgi->getBasicBlockInfo(bbid);
             if ((((it->second) / (double)p_stats->misses) * 100.0) > 1.0)
             {
                 fprintf(f, "%u, %lf, %u, %u, %s, %s:%u\n", it->second, 
                                             (((it->second) / (double)p_stats->misses) * 100.0),
                                              bbid, 
                                              (unsigned int)(it->first), 
-                                             bbi.functionName.c_str(), 
-                                             bbi.fileName.c_str(),
+                                             tgi->getString(bbi.functionId), 
+                                             tgi->getString(bbi.fileId),
                                          bbi.lineNumber);
             }
         }
     }
+    if (trackAllocations == false) return;
+    
     fprintf(f, "Address, Size, BBID, Misses\n");
     for (auto it = allocBlocks.begin(), et = allocBlocks.end(); it != et; ++it)
     {
@@ -24,6 +24,10 @@ struct cache_line
     uint64_t read_misses;
     uint64_t write_misses;
     uint64_t accesses;
+    
+    // log2 of the cache size and associativity
+    uint64_t cacheSizeLog2;
+    uint64_t assocLog2;
 
     std::vector< std::deque<cache_line> > cacheBlocks;
 
@@ -31,7 +35,7 @@ struct cache_line
     void printIndex(uint64_t idx);
 
 public:    
-    SimpleCache();
+    SimpleCache(uint64_t c, uint64_t s);
     double getMissRate();
     bool updateCache(bool rw, char numOfBytes, uint64_t address, cache_stats_t* p_stats);
 };
@@ -50,13 +54,29 @@ class SimpleCacheBackend  : public contech::Backend
     std::map <uint64_t, mallocStats> allocBlocks;
     cache_stats_t* p_stats;
     bool printMissLines;
+    uint64_t cacheSizeLog2;
+    uint64_t assocLog2;
+    // Each context has its own cache, rather than all sharing one
+    bool privateCaches;
+    // Misses are attributed to allocations, which needs every task in order
+    //   A context's backend does not see the other contexts' allocations, so
+    //   neither it nor the backend it is merged into reports them
+    bool trackAllocations;
+    
+    SimpleCache& getCache(contech::ContextId ctid);
 
 public:
     virtual void resetBackend();
     virtual void updateBackend(contech::Task*);
     virtual void completeBackend(FILE*, contech::TaskGraphInfo*);
     
-    SimpleCacheBackend(uint64_t c, uint64_t s, int printMissLoc);
+    // With private caches, each context can be simulated separately, without
+    //   the misses of each allocation
+    virtual contech::Backend* createContextBackend(contech::ContextId ctx);
+    virtual void mergeContextBackend(contech::Backend* ctxBackend);
+    
+    SimpleCacheBackend(uint64_t c, uint64_t s, int printMissLoc, bool privateCaches = false);
+    ~SimpleCacheBackend();
 };
 
 #endif
@@ -56,40 +56,42 @@ int main(int argc, char const *argv[])
     }
     
     TaskGraphInfo* tgi = tg->getTaskGraphInfo();
-    if (modelROI) tg->setTaskOrderCurrent(tg->getROIStart());
+    // The ROI cursor starts at the ROI start and stops at its end, without a scan
+    TaskCursor tasks = modelROI ? tg->getROICursor() : tg->getCursor();
 
-    while(Task* currentTask = tg->getNextTask())
+    // Tasks are only read, so use views into the decoded blocks
+    TaskView currentTask;
+    while(tasks.getNextTaskView(currentTask))
     {
 
         totalTasks++;
         uint basicBlocksInTask = 0;
         uint memOpsInTask = 0;
         
-        if (currentTask->getTaskId() == tg->getROIStart())
+        if (currentTask.getTaskId() == tg->getROIStart())
         {
             inROI = true;
         }
-        else if (currentTask->getTaskId() == tg->getROIEnd())
+        else if (currentTask.getTaskId() == tg->getROIEnd())
         {
             inROI = false;
             if (modelROI)
             {
-                delete currentTask;
                 break;
             }
         }
 
-        switch(currentTask->getType())
+        switch(currentTask.getType())
         {
             case task_type_basic_blocks:
             {
-                auto bba = currentTask->getBasicBlockActions();
+                auto bba = currentTask.getBasicBlockActions();
                 for (auto f = bba.begin(), e = bba.end(); f != e; ++f)
                 {
                     BasicBlockAction bb = *f;
                     uniqueBlocks.insert((uint)bb.basic_block_id);
                     
-                    auto bbi = tgi->getBasicBlockInfo((uint)bb.basic_block_id);
+                    const BasicBlockInfo& bbi = tgi->getBasicBlockInfo((uint)bb.basic_block_id);
                     
                     if (0 != (bbi.flags & BBI_FLAG_CONTAIN_CALL))
                     {
@@ -141,8 +143,6 @@ int main(int argc, char const *argv[])
                 break;
 
         }
-
-        delete currentTask;
     }
     
     delete tg;
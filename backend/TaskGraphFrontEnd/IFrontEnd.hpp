@@ -5,6 +5,7 @@
 class IFrontEnd
 {
 public:
+    virtual ~IFrontEnd() {}
 
     // Represents an x86 instruction, along with memory addresses accessed
     struct Instruction
@@ -32,10 +32,11 @@ TaskGraphFrontEnd::TaskGraphFrontEnd(string basename, unsigned int cpuId)
     // Find my first task
     
     tg = TaskGraph::initFromFile(taskGraphFile);
-    if (tg == NULL) {}
+    if (tg == NULL) { cerr << "Could not read task graph " << taskGraphFileName << endl; exit(1); }
 
-    TaskId firstId(cpuId, 0);
-    currentTask = tg->getContechTask(firstId);
+    // Only this core's context is read, in sequence order
+    myTasks = new ContextCursor(tg->contextCursor(cpuId));
+    currentTask = myTasks->getNextTask();
     
     if (currentTask == NULL) { cerr << "No tasks for core " << cpuId << endl; return; }
 
@@ -57,6 +58,14 @@ TaskGraphFrontEnd::TaskGraphFrontEnd(string basename, unsigned int cpuId)
     currentInstruction = currentBlock->begin();
 }
 
+TaskGraphFrontEnd::~TaskGraphFrontEnd()
+{
+    delete currentTask;
+    delete myTasks;
+    delete tg;
+    fclose(taskGraphFile);
+}
+
 bool TaskGraphFrontEnd::getNextInstruction(IFrontEnd::Instruction& inst)
 {    
     // Return false after the trace has been exhausted
@@ -160,9 +169,12 @@ bool TaskGraphFrontEnd::getNextInstruction(IFrontEnd::Instruction& inst)
             }
             
             // Get the next task for this core
-            TaskId nextId = currentTask->getTaskId().getNext();
-            delete currentTask;
-            currentTask = tg->getContechTask(nextId);
+            //   read into the current task, so its vectors are reused
+            if (!myTasks->readNextInto(*currentTask))
+            {
+                delete currentTask;
+                currentTask = NULL;
+            }
 
             // If there are no more tasks, we are done. The last instruction will return true, the next call will return false
             if (currentTask == NULL) { return true; }
@@ -14,6 +14,7 @@ class TaskGraphFrontEnd : public IFrontEnd
 {
 public:
     TaskGraphFrontEnd(std::string basename, unsigned int cpuId);
+    virtual ~TaskGraphFrontEnd();
 
     virtual unsigned int getCpuId();
     virtual bool getNextInstruction(IFrontEnd::Instruction& inst);
@@ -30,6 +31,7 @@ private:
     // Maintain position within the task graph
     FILE* taskGraphFile;
     contech::TaskGraph* tg;
+    contech::ContextCursor* myTasks;
     contech::Task* currentTask;
     contech::Task::basicBlockActionCollection blocksInTask;
     contech::Task::basicBlockActionCollection::iterator currentBlockId;
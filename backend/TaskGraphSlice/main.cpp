@@ -0,0 +1,418 @@
+#include "../../common/taskLib/TaskGraph.hpp"
+#include "../../common/taskLib/TaskGraphWriter.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+using namespace contech;
+
+//
+// Slice a task graph, writing the tasks that meet every condition given
+//
+//   The tasks to keep are chosen from the summaries, then only the blocks with a
+//   kept task are decoded.  An edge into a dropped task is replaced by edges to
+//   the kept tasks reached through dropped tasks, so the slice keeps the
+//   ordering of the original graph.
+//
+//   The kept tasks of a context are ordered by the context's own edges, so only
+//   the earliest task of each context is kept among the tasks reached.
+//
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "%s [-t <start time>:<end time>] [-r] [-c <context>[,<context>]*] "
+                    "[-i <ctx:seq> <ctx:seq>] <input taskgraph> <output taskgraph>\n", name);
+    fprintf(stderr, "\t-t tasks running during the time window, either end may be empty\n");
+    fprintf(stderr, "\t-r tasks in the region of interest\n");
+    fprintf(stderr, "\t-c tasks of the contexts\n");
+    fprintf(stderr, "\t-i tasks from one task through another in the task order\n");
+}
+
+static bool parseTaskId(const char* s, TaskId& tid)
+{
+    unsigned int ctx, seq;
+    if (sscanf(s, "%u:%u", &ctx, &seq) != 2) return false;
+    tid = TaskId(ContextId(ctx), SeqId(seq));
+    return true;
+}
+
+//
+// Merge the tasks of b into a, keeping the earliest task of each context
+//   Both are sorted by TaskId, so a context's tasks are adjacent.
+//
+static void mergeReach(vector<TaskId>& a, const vector<TaskId>& b, vector<TaskId>& scratch)
+{
+    if (b.empty()) return;
+    if (a.empty())
+    {
+        a = b;
+        return;
+    }
+
+    scratch.clear();
+    vector<TaskId>::const_iterator ai = a.begin(), bi = b.begin();
+    while (ai != a.end() || bi != b.end())
+    {
+        TaskId next;
+        if (bi == b.end() || (ai != a.end() && *ai < *bi)) next = *ai++;
+        else next = *bi++;
+        if (scratch.empty() || scratch.back().getContextId() != next.getContextId())
+        {
+            scratch.push_back(next);
+        }
+    }
+    a.swap(scratch);
+}
+
+int main(int argc, char const *argv[])
+{
+    bool useTime = false, useROI = false, useRange = false;
+    ct_timestamp timeStart = 0, timeEnd = ~0ULL;
+    vector<ContextId> contexts;
+    TaskId rangeFrom, rangeTo;
+    int argPos = 1;
+
+    while (argPos < argc - 2 && argv[argPos][0] == '-')
+    {
+        if (!strcmp(argv[argPos], "-t") && argPos + 1 < argc)
+        {
+            const char* w = argv[argPos + 1];
+            const char* sep = strchr(w, ':');
+            if (sep == NULL) { usage(argv[0]); return 1; }
+            if (sep != w) timeStart = strtoull(w, NULL, 0);
+            if (sep[1] != '\0') timeEnd = strtoull(sep + 1, NULL, 0);
+            useTime = true;
+            argPos += 2;
+        }
+        else if (!strcmp(argv[argPos], "-r"))
+        {
+            useROI = true;
+            argPos += 1;
+        }
+        else if (!strcmp(argv[argPos], "-c") && argPos + 1 < argc)
+        {
+            for (const char* c = argv[argPos + 1]; c != NULL; c = strchr(c, ','))
+            {
+                if (*c == ',') c++;
+                contexts.push_back(ContextId(atoi(c)));
+            }
+            argPos += 2;
+        }
+        else if (!strcmp(argv[argPos], "-i") && argPos + 2 < argc)
+        {
+            if (!parseTaskId(argv[argPos + 1], rangeFrom) || !parseTaskId(argv[argPos + 2], rangeTo))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            useRange = true;
+            argPos += 3;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - argPos != 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TaskGraph* tg = TaskGraph::initFromFile(argv[argPos]);
+    if (tg == NULL)
+    {
+        fprintf(stderr, "Failure to open task graph - %s\n", argv[argPos]);
+        return 1;
+    }
+    sort(contexts.begin(), contexts.end());
+
+    // The part of the task order that is sliced
+    Span<const TaskSummary> summaries = tg->getTaskSummaries();
+    uint64 taskCount = summaries.size();
+    uint64 begin = 0, end = taskCount;
+    if (useROI)
+    {
+        begin = tg->getROIStartPosition();
+        end = min(end, tg->getROIEndPosition() + 1);
+    }
+    if (useRange)
+    {
+        uint64 from, to;
+        if (!tg->getOrderPosition(rangeFrom, from) || !tg->getOrderPosition(rangeTo, to))
+        {
+            fprintf(stderr, "Task range is not in the task graph\n");
+            return 1;
+        }
+        begin = max(begin, from);
+        end = min(end, to + 1);
+    }
+
+    vector<bool> keep(taskCount, false);
+    uint64 firstKept = taskCount, lastKept = 0, keptCount = 0;
+    for (uint64 i = begin; i < end; i++)
+    {
+        const TaskSummary& ts = summaries[i];
+        if (useTime && (ts.startTime >= timeEnd || ts.endTime < timeStart)) continue;
+        if (!contexts.empty() &&
+            !binary_search(contexts.begin(), contexts.end(), ts.taskId.getContextId())) continue;
+        keep[i] = true;
+        firstKept = min(firstKept, i);
+        lastKept = i;
+        keptCount++;
+    }
+
+    //
+    // Rewrite the successors of the kept tasks, in reverse task order
+    //
+    //   Each dropped task records the kept tasks it reaches, which its predecessors
+    //   use in place of it.  That record is released once every predecessor that
+    //   could use it has done so.  Successors after the last kept task cannot reach
+    //   a kept task.  Only the tasks whose edges change keep their new edges.
+    //
+    unordered_map<uint64, vector<TaskId> > reach;
+    vector<uint32_t> pendingUses;
+    unordered_map<uint64, vector<TaskId> > newSucc;
+    if (keptCount > 0)
+    {
+        pendingUses.assign(lastKept - firstKept + 1, 0);
+
+        for (uint64 i = firstKept; i <= lastKept; i++)
+        {
+            const TaskSummary& ts = summaries[i];
+            for (TaskId s : tg->getSummarySuccessors(ts))
+            {
+                uint64 p;
+                if (tg->getOrderPosition(s, p) && p <= lastKept && !keep[p]) pendingUses[p - firstKept]++;
+            }
+        }
+
+        vector<TaskId> direct, merged, scratch, one(1);
+        for (uint64 i = lastKept + 1; i-- > firstKept; )
+        {
+            const TaskSummary& ts = summaries[i];
+            bool dropped = false;
+
+            // The kept successors, then the kept tasks reached through the dropped ones
+            direct.clear();
+            merged.clear();
+            for (TaskId s : tg->getSummarySuccessors(ts))
+            {
+                uint64 p;
+                if (!tg->getOrderPosition(s, p) || p > lastKept)
+                {
+                    dropped = true;
+                }
+                else if (keep[p])
+                {
+                    direct.push_back(s);
+                }
+                else
+                {
+                    dropped = true;
+                    auto r = reach.find(p);
+                    if (r == reach.end()) continue;
+                    mergeReach(merged, r->second, scratch);
+                    if (--pendingUses[p - firstKept] == 0) reach.erase(r);
+                }
+            }
+
+            if (!keep[i])
+            {
+                if (pendingUses[i - firstKept] == 0) continue;
+                for (TaskId s : direct)
+                {
+                    one[0] = s;
+                    mergeReach(merged, one, scratch);
+                }
+                if (!merged.empty()) reach[i] = merged;
+                continue;
+            }
+            if (!dropped) continue;
+
+            // A reached task is left out when a kept successor of its context is no later
+            vector<TaskId>& ns = newSucc[i];
+            ns = direct;
+            for (TaskId r : merged)
+            {
+                bool implied = false;
+                for (TaskId s : direct)
+                {
+                    if (s.getContextId() == r.getContextId() && s <= r) implied = true;
+                }
+                if (!implied) ns.push_back(r);
+            }
+        }
+    }
+
+    //
+    // Predecessors are the inverse of the successors, in task order
+    //
+    //   A kept predecessor with unchanged successors still leads to the task, so
+    //   only the edges of the rewritten tasks are added to the original ones.
+    //
+    unordered_map<uint64, vector<uint64> > addedPred;
+    for (auto& ns : newSucc)
+    {
+        for (TaskId s : ns.second)
+        {
+            uint64 p;
+            tg->getOrderPosition(s, p);
+            addedPred[p].push_back(ns.first);
+        }
+    }
+    unordered_map<uint64, vector<TaskId> > newPred;
+    vector<uint64> predPos;
+    for (uint64 i = firstKept; i <= lastKept && keptCount > 0; i++)
+    {
+        if (!keep[i]) continue;
+        Span<const TaskId> pred = tg->getSummaryPredecessors(summaries[i]);
+        predPos.clear();
+        for (TaskId pt : pred)
+        {
+            uint64 p;
+            if (tg->getOrderPosition(pt, p) && keep[p] && newSucc.count(p) == 0) predPos.push_back(p);
+        }
+        auto added = addedPred.find(i);
+        bool hasAdded = (added != addedPred.end());
+        if (hasAdded)
+        {
+            predPos.insert(predPos.end(), added->second.begin(), added->second.end());
+            addedPred.erase(added);
+        }
+        // A task with new successors is written with its predecessors in task order
+        bool succChanged = (newSucc.count(i) != 0);
+        if (predPos.size() == pred.size() && !hasAdded && !succChanged) continue;
+
+        sort(predPos.begin(), predPos.end());
+        vector<TaskId>& np = newPred[i];
+        for (uint64 p : predPos)
+        {
+            np.push_back(summaries[p].taskId);
+        }
+        if (!succChanged && np.size() == pred.size() && is_permutation(pred.begin(), pred.end(), np.begin()))
+        {
+            newPred.erase(i);
+        }
+    }
+    auto changed = [&](uint64 i) { return newSucc.count(i) != 0 || newPred.count(i) != 0; };
+    uint64 rewritten = 0;
+    for (uint64 i = firstKept; i <= lastKept && keptCount > 0; i++)
+    {
+        if (keep[i] && changed(i)) rewritten++;
+    }
+
+    //
+    // Blocks of version 4 and later with every task kept and unchanged are copied
+    //   as they are stored, with the same basic block sequences
+    //
+    bool copyBlocks = (tg->getVersion() >= TASK_GRAPH_VERSION_V4);
+    uint64 blockCount = copyBlocks ? tg->getBlockCount() : 0;
+    vector<uint64> blockFirst(blockCount, taskCount), blockLast(blockCount, 0), blockTasks(blockCount, 0);
+    vector<bool> blockKept(blockCount, true);
+    for (uint64 i = 0; i < taskCount && copyBlocks; i++)
+    {
+        uint32_t b, slot;
+        if (!tg->getTaskLocation(i, b, slot) || b >= blockCount)
+        {
+            copyBlocks = false;
+            break;
+        }
+        blockFirst[b] = min(blockFirst[b], i);
+        blockLast[b] = max(blockLast[b], i);
+        blockTasks[b]++;
+        if (!keep[i] || changed(i)) blockKept[b] = false;
+    }
+
+    TaskGraphWriter* out = TaskGraphWriter::initToFile(argv[argPos + 1], tg->getTaskGraphInfo());
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failure to open output - %s\n", argv[argPos + 1]);
+        return 1;
+    }
+    Span<const TaskAddressSummary> addresses;
+    if (copyBlocks)
+    {
+        out->setBasicBlockSequences(tg->getBasicBlockSequences());
+        addresses = tg->getAddressSummaries();
+    }
+
+    // The ROI is the kept tasks within the original ROI, if any are
+    uint64 roiStartPos = tg->getROIStartPosition(), roiEndPos = tg->getROIEndPosition();
+    uint64 roiFirst = taskCount, roiLast = taskCount;
+    for (uint64 i = max(roiStartPos, firstKept); i <= min(roiEndPos, lastKept) && keptCount > 0; i++)
+    {
+        if (!keep[i]) continue;
+        if (roiFirst == taskCount) roiFirst = i;
+        roiLast = i;
+    }
+    if (roiFirst != taskCount)
+    {
+        out->setROI(summaries[roiFirst].taskId, summaries[roiLast].taskId);
+    }
+
+    // Read only the kept tasks, seeking over the runs of dropped tasks
+    Task t;
+    uint64 nextPos = 0, copiedBlocks = 0;
+    for (uint64 i = firstKept; i <= lastKept && keptCount > 0; i++)
+    {
+        if (!keep[i]) continue;
+
+        uint32_t b, slot;
+        if (copyBlocks && tg->getTaskLocation(i, b, slot) && blockKept[b] &&
+            blockFirst[b] == i && blockLast[b] - i + 1 == blockTasks[b])
+        {
+            uint64 uncompLength, compLength;
+            unsigned char* buffer;
+            const unsigned char* comp = tg->getCompressedBlock(b, uncompLength, compLength, buffer);
+            if (comp != NULL)
+            {
+                out->addCompressedBlock(comp, uncompLength, compLength);
+                free(buffer);
+                for (; i <= blockLast[b]; i++)
+                {
+                    tg->getTaskLocation(i, b, slot);
+                    out->addBlockTask(summaries[i], addresses[i], tg->getSummarySuccessors(summaries[i]),
+                                      tg->getSummaryPredecessors(summaries[i]), slot);
+                }
+                i--;
+                copiedBlocks++;
+                continue;
+            }
+        }
+
+        if (i != nextPos) tg->seekToOrderPosition(i);
+        if (!tg->readNextInto(t))
+        {
+            fprintf(stderr, "Failure to read task %s\n", summaries[i].taskId.toString().c_str());
+            return 1;
+        }
+        nextPos = i + 1;
+
+        auto ns = newSucc.find(i);
+        if (ns != newSucc.end())
+        {
+            t.getSuccessorTasks().swap(ns->second);
+            newSucc.erase(ns);
+        }
+        auto np = newPred.find(i);
+        if (np != newPred.end())
+        {
+            t.getPredecessorTasks().swap(np->second);
+            newPred.erase(np);
+        }
+        out->addTask(t);
+    }
+
+    uint64 outBlocks = out->getBlockCount();
+    bool valid = out->close();
+    delete out;
+
+    printf("Sliced %lu of %lu tasks into %lu blocks, copying %lu, rewriting the edges of %lu tasks\n",
+           keptCount, taskCount, outBlocks, copiedBlocks, rewritten);
+    delete tg;
+
+    return valid ? 0 : 1;
+}
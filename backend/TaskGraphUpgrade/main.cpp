@@ -0,0 +1,60 @@
+#include "../../common/taskLib/TaskGraph.hpp"
+#include "../../common/taskLib/TaskGraphWriter.hpp"
+#include <stdio.h>
+
+using namespace std;
+using namespace contech;
+
+//
+// Upgrade a task graph to the current (block compressed, sorted index) version
+//
+//   Tasks are written in the order of the index, so that reading the upgraded
+//   graph in order decodes each block once.
+//
+int main(int argc, char const *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <input taskgraph> <output taskgraph>\n", argv[0]);
+        return 1;
+    }
+
+    TaskGraph* tg = TaskGraph::initFromFile(argv[1]);
+    if (tg == NULL)
+    {
+        fprintf(stderr, "Failure to open task graph - %s\n", argv[1]);
+        return 1;
+    }
+    if (tg->getVersion() == TASK_GRAPH_VERSION)
+    {
+        printf("%s is already version %u, re-encoding it\n", argv[1], TASK_GRAPH_VERSION);
+    }
+
+    TaskGraphWriter* out = TaskGraphWriter::initToFile(argv[2], tg->getTaskGraphInfo());
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failure to open output - %s\n", argv[2]);
+        return 1;
+    }
+    out->setROI(tg->getROIStart(), tg->getROIEnd());
+
+    Task t;
+    while (tg->readNextInto(t))
+    {
+        out->addTask(t);
+    }
+
+    uint64 taskCount = out->getTaskCount(), blockCount = out->getBlockCount();
+    uint32_t sequenceCount = out->getSequenceCount();
+    if (!out->close())
+    {
+        fprintf(stderr, "Upgraded graph has edges out of the task order - %s\n", argv[1]);
+    }
+    delete out;
+
+    printf("Upgraded %lu tasks into %lu blocks, with %u basic block sequences\n",
+           taskCount, blockCount, sequenceCount);
+    delete tg;
+
+    return 0;
+}
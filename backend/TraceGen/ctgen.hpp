@@ -0,0 +1,261 @@
+#ifndef CTGEN_HPP
+#define CTGEN_HPP
+
+#include "../../common/taskLib/TaskGraph.hpp"
+#include "../../common/taskLib/TaskGraphWriter.hpp"
+#include "../../common/eventLib/ct_event_st.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <random>
+
+// Bytes of each event in a trace of CONTECH_EVENT_VERSION, with the type and padding
+#define CTGEN_BLOCK_BYTES 3
+#define CTGEN_MEMOP_BYTES 6
+#define CTGEN_MEMORY_BYTES 21
+#define CTGEN_CREATE_BYTES 32
+#define CTGEN_SYNC_BYTES 40
+#define CTGEN_BARRIER_BYTES 37
+#define CTGEN_JOIN_BYTES 25
+#define CTGEN_ROI_BYTES 9
+#define CTGEN_BUFFER_BYTES 12
+
+// The skew a created context records, so that its clock starts after its creator's
+#define CTGEN_CHILD_SKEW 1
+
+namespace contech
+{
+
+//
+// The shape of a synthetic program
+//
+//   Each context runs iterations of a loop, where the body is one of a few fixed
+//   runs of basic blocks, optionally takes a lock around one more block, and
+//   meets the other contexts at a barrier every barrierInterval iterations.
+//
+struct GenOptions
+{
+    uint32_t threads;
+    uint32_t bbCount;
+    uint32_t bodyCount;         // distinct loop bodies, and the blocks in each
+    uint32_t bodyMin;
+    uint32_t bodyMax;
+    uint32_t memOpMin;          // memops of each block
+    uint32_t memOpMax;
+    uint32_t dupPercent;        // memops at an offset from the block's first memop
+    uint32_t stridedPercent;    // memops that walk an array, the rest are random
+    uint32_t sharedPercent;     // random memops to the region every context shares
+    uint64_t footprint;         // bytes of each context's region, and the shared one
+    uint32_t lockPercent;       // iterations that take a lock
+    uint32_t lockCount;
+    uint32_t barrierInterval;   // 0 for no barriers
+    uint64_t iterations;        // 0 to run until the size is reached
+    uint64_t targetBytes;       // 0 to run for the iterations
+    uint64_t seed;
+
+    GenOptions();
+};
+
+// A memop of a block, as the instrumentation describes it
+struct GenMemOp
+{
+    bool isWrite;
+    bool isDup;
+    bool isStrided;
+    uint8_t powSize;
+    int32_t dupOffset;          // from the block's first memop
+};
+
+struct GenBlock
+{
+    uint32_t line;
+    uint32_t numOps;
+    uint32_t critPathLen;
+    uint32_t flags;
+    uint32_t firstStream;       // index of its first memop among all the memops
+    std::string function;
+    std::string file;
+    std::string callsFunction;
+    std::vector<GenMemOp> memOps;
+};
+
+//
+// Receives the events of the program, in the order of the trace
+//
+//   Times are from one clock that every context shares.  Ticket and barrier
+//   numbers count every sync and barrier event, as the runtime's do.
+//
+class GenSink
+{
+public:
+    virtual ~GenSink() {}
+
+    virtual void basicBlockInfo(const std::vector<GenBlock>& blocks) = 0;
+    virtual void basicBlock(uint32_t ctx, uint32_t bbid, const uint64_t* addrs, ct_timestamp time) = 0;
+    virtual void memory(uint32_t ctx, bool isAllocate, uint64_t size, uint64_t addr) = 0;
+    virtual void create(uint32_t ctx, uint32_t other, bool isChild, ct_timestamp start, ct_timestamp end) = 0;
+    virtual void sync(uint32_t ctx, bool isAcquire, uint64_t addr, uint64_t ticket, ct_timestamp start, ct_timestamp end) = 0;
+    virtual void barrier(uint32_t ctx, bool onEnter, uint64_t addr, uint64_t barrierNum, ct_timestamp start, ct_timestamp end) = 0;
+    virtual void join(uint32_t ctx, uint32_t other, bool isExit, ct_timestamp start, ct_timestamp end) = 0;
+    virtual void roi(uint32_t ctx, ct_timestamp time) = 0;
+    // Returns false if the output could not be written
+    virtual bool finish() = 0;
+};
+
+//
+// Generates the events of a program from the options and the seed
+//
+//   The same options give the same events for every sink, so a trace and the task
+//   graph generated directly describe one program.  The size counts the bytes of
+//   the events in a trace, without the buffer markers.
+//
+class Workload
+{
+private:
+    GenOptions opt;
+    std::mt19937_64 rng;
+    std::vector<GenBlock> blocks;
+    std::vector<std::vector<uint32_t> > bodies;
+    uint32_t streamCount;
+    // The next address and the stride of each context's memops that walk arrays
+    std::vector<uint64_t> streamNext;
+    std::vector<uint32_t> streamStride;
+    std::vector<uint64_t> addrs;
+
+    ct_timestamp now;
+    uint64_t ticketNum;
+    uint64_t barrierNum;
+    uint64_t eventBytes;
+
+    uint32_t random(uint32_t low, uint32_t high);
+    bool percent(uint32_t p);
+    ct_timestamp tick(uint32_t low, uint32_t high);
+    uint64_t regionBase(uint32_t ctx);
+
+    void buildBlocks();
+    void emitBlock(GenSink* sink, uint32_t ctx, uint32_t bbid);
+    void emitSync(GenSink* sink, uint32_t ctx, bool isAcquire, uint64_t addr);
+    void emitBarrier(GenSink* sink, uint64_t addr);
+
+public:
+    Workload(const GenOptions& o);
+
+    const std::vector<GenBlock>& getBlocks() const { return blocks; }
+    // Generate the whole program into the sink
+    void run(GenSink* sink);
+    uint64_t getEventBytes() const { return eventBytes; }
+};
+
+//
+// Writes a raw trace, as the runtime does, for the middle layer to read
+//
+//   Each context's events are kept in its own buffer, which is written out behind
+//   a buffer event when it fills or at a synchronization event, so that the
+//   events in the file are in ticket order.
+//
+class TraceSink : public GenSink
+{
+private:
+    FILE* out;
+    uint32_t bufferSize;
+    std::vector<std::vector<uint8_t> > buffers;
+    std::vector<const GenBlock*> blockTable;
+    uint64_t bytesWritten;
+    bool failed;
+
+    std::vector<uint8_t>& buffer(uint32_t ctx);
+    void flush(uint32_t ctx);
+    void write(const void* data, size_t length);
+
+public:
+    TraceSink(FILE* f, uint32_t bufSize);
+
+    virtual void basicBlockInfo(const std::vector<GenBlock>& blocks);
+    virtual void basicBlock(uint32_t ctx, uint32_t bbid, const uint64_t* addrs, ct_timestamp time);
+    virtual void memory(uint32_t ctx, bool isAllocate, uint64_t size, uint64_t addr);
+    virtual void create(uint32_t ctx, uint32_t other, bool isChild, ct_timestamp start, ct_timestamp end);
+    virtual void sync(uint32_t ctx, bool isAcquire, uint64_t addr, uint64_t ticket, ct_timestamp start, ct_timestamp end);
+    virtual void barrier(uint32_t ctx, bool onEnter, uint64_t addr, uint64_t barrierNum, ct_timestamp start, ct_timestamp end);
+    virtual void join(uint32_t ctx, uint32_t other, bool isExit, ct_timestamp start, ct_timestamp end);
+    virtual void roi(uint32_t ctx, ct_timestamp time);
+    virtual bool finish();
+
+    uint64_t getBytesWritten() const { return bytesWritten; }
+};
+
+//
+// Builds the tasks that the middle layer would, and writes them as a task graph
+//
+//   Times are relative to the creation of each context, and a block task ends
+//   when the next event of its context starts, as in the middle layer.
+//
+//   A task is written once every task that follows it is known.  That is the next
+//   task of its context, or for a lock release the next acquire of the lock, so
+//   only a window of recent tasks is kept.  A release still waiting when the
+//   window is full is left without a successor, as if the lock were not taken
+//   again.  Basic block tasks are split after maxBlocks blocks.
+//
+class GraphSink : public GenSink
+{
+private:
+    struct PendingTask
+    {
+        Task task;
+        uint32_t open;          // followers that are not yet known
+        bool awaitsLock;
+    };
+
+    TaskGraphWriter* out;
+    TaskGraphInfo tgi;
+    const char* fileName;
+    uint32_t maxBlocks;
+    size_t maxWindow;
+
+    std::deque<PendingTask*> window;
+    std::vector<PendingTask*> last;         // of each context
+    std::vector<PendingTask*> exited;       // the last task of each context that exited
+    std::vector<PendingTask*> beforeBarrier;
+    std::vector<ct_timestamp> timeOffset;
+    std::vector<std::vector<std::pair<uint64_t, PendingTask*> > > heldLocks;
+    std::vector<uint32_t> nextSeq;
+    std::vector<uint32_t> blocksInTask;
+    std::vector<std::pair<uint64_t, PendingTask*> > lockRelease;
+    std::vector<const GenBlock*> blockTable;
+    PendingTask* barrierTask;
+    bool barrierOpen;           // between the first enter and the first exit
+    TaskId roiStart;
+    TaskId roiEnd;
+    bool roiStarted;
+    bool roiEnded;
+    bool failed;
+
+    void ensureContext(uint32_t ctx);
+    void link(PendingTask* from, PendingTask* to);
+    void follow(uint32_t ctx, PendingTask* pt, ct_timestamp time);
+    ct_timestamp localTime(uint32_t ctx, ct_timestamp t) const { return t - timeOffset[ctx]; }
+    PendingTask* newTask(uint32_t ctx, task_type type, ct_timestamp start);
+    void continueContext(uint32_t ctx, ct_timestamp time);
+    PendingTask* blockTask(uint32_t ctx, ct_timestamp time);
+    void drain(bool all);
+
+public:
+    GraphSink(const char* f, uint32_t maxBlocksPerTask);
+    ~GraphSink();
+
+    virtual void basicBlockInfo(const std::vector<GenBlock>& blocks);
+    virtual void basicBlock(uint32_t ctx, uint32_t bbid, const uint64_t* addrs, ct_timestamp time);
+    virtual void memory(uint32_t ctx, bool isAllocate, uint64_t size, uint64_t addr);
+    virtual void create(uint32_t ctx, uint32_t other, bool isChild, ct_timestamp start, ct_timestamp end);
+    virtual void sync(uint32_t ctx, bool isAcquire, uint64_t addr, uint64_t ticket, ct_timestamp start, ct_timestamp end);
+    virtual void barrier(uint32_t ctx, bool onEnter, uint64_t addr, uint64_t barrierNum, ct_timestamp start, ct_timestamp end);
+    virtual void join(uint32_t ctx, uint32_t other, bool isExit, ct_timestamp start, ct_timestamp end);
+    virtual void roi(uint32_t ctx, ct_timestamp time);
+    virtual bool finish();
+
+    uint64 getTaskCount() const { return (out == NULL) ? 0 : out->getTaskCount(); }
+};
+
+}
+
+#endif
@@ -0,0 +1,388 @@
+#include "ctgen.hpp"
+#include <assert.h>
+
+using namespace std;
+using namespace contech;
+
+// Tasks kept before a waiting release is given up on
+#define MAX_PENDING_TASKS (1 << 16)
+
+GraphSink::GraphSink(const char* f, uint32_t maxBlocksPerTask)
+{
+    out = NULL;
+    fileName = f;
+    maxBlocks = maxBlocksPerTask;
+    maxWindow = MAX_PENDING_TASKS;
+    barrierTask = NULL;
+    barrierOpen = false;
+    roiStarted = false;
+    roiEnded = false;
+    failed = false;
+}
+
+GraphSink::~GraphSink()
+{
+    for (PendingTask* pt : window)
+    {
+        delete pt;
+    }
+    delete out;
+}
+
+void GraphSink::ensureContext(uint32_t ctx)
+{
+    if (ctx < last.size()) return;
+
+    last.resize(ctx + 1, NULL);
+    exited.resize(ctx + 1, NULL);
+    nextSeq.resize(ctx + 1, 0);
+    blocksInTask.resize(ctx + 1, 0);
+    beforeBarrier.resize(ctx + 1, NULL);
+    heldLocks.resize(ctx + 1);
+    timeOffset.resize(ctx + 1, 0);
+}
+
+void GraphSink::link(PendingTask* from, PendingTask* to)
+{
+    from->task.addSuccessor(to->task.getTaskId());
+    to->task.addPredecessor(from->task.getTaskId());
+    assert(from->open > 0);
+    from->open--;
+}
+
+//
+// The next task of a context follows its last task, and the task before the
+//   barrier it left, as the middle layer orders them.  A block task ends when the
+//   next one starts.
+//
+void GraphSink::follow(uint32_t ctx, PendingTask* pt, ct_timestamp time)
+{
+    if (beforeBarrier[ctx] != NULL)
+    {
+        link(beforeBarrier[ctx], pt);
+        beforeBarrier[ctx] = NULL;
+    }
+    if (last[ctx] != NULL)
+    {
+        Task& t = last[ctx]->task;
+        if (t.getType() == task_type_basic_blocks && t.getContextId() == ContextId(ctx)) t.setEndTime(time);
+        link(last[ctx], pt);
+    }
+}
+
+//
+// A new task is open until the task after it is known
+//
+GraphSink::PendingTask* GraphSink::newTask(uint32_t ctx, task_type type, ct_timestamp start)
+{
+    ensureContext(ctx);
+
+    PendingTask* pt = new PendingTask;
+    pt->task = Task(TaskId(ContextId(ctx), SeqId(nextSeq[ctx]++)), type);
+    pt->task.setStartTime(start);
+    pt->task.setEndTime(start);
+    pt->open = 1;
+    pt->awaitsLock = false;
+    window.push_back(pt);
+
+    follow(ctx, pt, start);
+    last[ctx] = pt;
+    blocksInTask[ctx] = 0;
+    drain(false);
+
+    return pt;
+}
+
+// Blocks go in the context's current block task, or start a new one
+//   The middle layer starts a block task after each synchronization, even if it
+//   stays empty, and so does continueContext.
+void GraphSink::continueContext(uint32_t ctx, ct_timestamp time)
+{
+    newTask(ctx, task_type_basic_blocks, time);
+}
+
+GraphSink::PendingTask* GraphSink::blockTask(uint32_t ctx, ct_timestamp time)
+{
+    ensureContext(ctx);
+
+    PendingTask* pt = last[ctx];
+    if (pt == NULL || blocksInTask[ctx] >= maxBlocks ||
+        pt->task.getType() != task_type_basic_blocks ||
+        pt->task.getContextId() != ContextId(ctx))
+    {
+        pt = newTask(ctx, task_type_basic_blocks, time);
+    }
+
+    return pt;
+}
+
+//
+// Write the tasks at the front of the window whose followers are all known
+//
+void GraphSink::drain(bool all)
+{
+    while (!window.empty())
+    {
+        PendingTask* pt = window.front();
+        if (pt->open > 0 && pt->awaitsLock && (all || window.size() > maxWindow))
+        {
+            // The next acquire is too far away, so the release leads nowhere
+            for (auto& lr : lockRelease)
+            {
+                if (lr.second == pt) lr.second = NULL;
+            }
+            pt->awaitsLock = false;
+            pt->open--;
+        }
+        if (pt->open > 0 && !all) break;
+
+        window.pop_front();
+        if (out != NULL) out->addTask(pt->task);
+        delete pt;
+    }
+}
+
+void GraphSink::basicBlockInfo(const vector<GenBlock>& blocks)
+{
+    for (uint32_t b = 0; b < blocks.size(); b++)
+    {
+        const GenBlock& blk = blocks[b];
+        tgi.addRawBasicBlockInfo(b, blk.flags, blk.line, blk.memOps.size(), blk.numOps, blk.critPathLen,
+                                 blk.function, blk.file, blk.callsFunction);
+        blockTable.push_back(&blk);
+    }
+
+    out = TaskGraphWriter::initToFile(fileName, &tgi);
+    if (out == NULL) failed = true;
+}
+
+void GraphSink::basicBlock(uint32_t ctx, uint32_t bbid, const uint64_t* addrs, ct_timestamp time)
+{
+    const GenBlock& blk = *blockTable[bbid];
+    time = localTime(ctx, time);
+    Task& t = blockTask(ctx, time)->task;
+
+    t.reserveActions(1 + blk.memOps.size());
+    t.recordBasicBlockAction(bbid);
+    for (uint32_t i = 0; i < blk.memOps.size(); i++)
+    {
+        t.recordMemOpAction(blk.memOps[i].isWrite, blk.memOps[i].powSize, addrs[i]);
+    }
+    t.setEndTime(time);
+    blocksInTask[ctx]++;
+}
+
+void GraphSink::memory(uint32_t ctx, bool isAllocate, uint64_t size, uint64_t addr)
+{
+    ensureContext(ctx);
+    PendingTask* pt = blockTask(ctx, (last[ctx] != NULL) ? last[ctx]->task.getEndTime() : 0);
+
+    if (isAllocate) pt->task.recordMallocAction(addr, size);
+    else pt->task.recordFreeAction(addr);
+}
+
+//
+// One create task of the creator is followed by the first task of each context it
+//   creates, which starts when the context records its creation
+//
+void GraphSink::create(uint32_t ctx, uint32_t other, bool isChild, ct_timestamp start, ct_timestamp end)
+{
+    ensureContext(ctx);
+    ensureContext(other);
+
+    // The first context's clock starts at its own creation
+    if (ctx == other)
+    {
+        timeOffset[ctx] = start;
+        continueContext(ctx, 0);
+        return;
+    }
+
+    if (isChild)
+    {
+        PendingTask* creator = last[other];
+        assert(creator != NULL && creator->task.getType() == task_type_create);
+        timeOffset[ctx] = timeOffset[other] + CTGEN_CHILD_SKEW;
+        creator->open++;
+        last[ctx] = creator;
+        continueContext(ctx, localTime(ctx, end));
+        return;
+    }
+
+    PendingTask* pt = last[ctx];
+    if (pt == NULL || pt->task.getType() != task_type_create)
+    {
+        pt = newTask(ctx, task_type_create, localTime(ctx, start));
+    }
+    pt->task.setEndTime(localTime(ctx, end));
+}
+
+//
+// Each sync is its own task, writing the lock.  An acquire is followed by its
+//   release, and a release by the next acquire of the same lock.
+//
+void GraphSink::sync(uint32_t ctx, bool isAcquire, uint64_t addr, uint64_t ticket, ct_timestamp start, ct_timestamp end)
+{
+    ensureContext(ctx);
+    start = localTime(ctx, start);
+    end = localTime(ctx, end);
+    PendingTask* prev = last[ctx];
+    PendingTask* pt = newTask(ctx, task_type_sync, start);
+    pt->task.setSyncType(sync_type_lock);
+    pt->task.setEndTime(end);
+    pt->task.recordMemOpAction(true, 8, addr);
+
+    auto it = lockRelease.begin();
+    for (; it != lockRelease.end(); ++it)
+    {
+        if (it->first == addr) break;
+    }
+    if (it == lockRelease.end())
+    {
+        lockRelease.push_back(make_pair(addr, (PendingTask*)NULL));
+        it = lockRelease.end() - 1;
+    }
+
+    if (isAcquire)
+    {
+        if (it->second != NULL)
+        {
+            it->second->awaitsLock = false;
+            link(it->second, pt);
+            it->second = NULL;
+        }
+        pt->open++;
+        heldLocks[ctx].push_back(make_pair(addr, pt));
+    }
+    else
+    {
+        vector<pair<uint64_t, PendingTask*> >& held = heldLocks[ctx];
+        for (auto h = held.begin(); h != held.end(); ++h)
+        {
+            if (h->first != addr) continue;
+            if (h->second == prev) h->second->open--;
+            else link(h->second, pt);
+            held.erase(h);
+            break;
+        }
+        pt->open++;
+        pt->awaitsLock = true;
+        it->second = pt;
+    }
+    continueContext(ctx, end);
+}
+
+//
+// The first context to arrive holds the barrier task, which follows the last task
+//   of every context, and is followed by the next task of each one.  That next
+//   task also follows the task before the barrier.  The barrier runs from the
+//   last arrival to the first departure.
+//
+void GraphSink::barrier(uint32_t ctx, bool onEnter, uint64_t addr, uint64_t barrierNum, ct_timestamp start, ct_timestamp end)
+{
+    ensureContext(ctx);
+    start = localTime(ctx, start);
+    end = localTime(ctx, end);
+
+    if (!onEnter)
+    {
+        if (barrierOpen) barrierTask->task.setEndTime(end);
+        barrierOpen = false;
+        continueContext(ctx, end);
+        return;
+    }
+
+    // The task before stays open for the task after
+    PendingTask* prev = last[ctx];
+    if (prev != NULL) prev->open++;
+
+    if (!barrierOpen)
+    {
+        barrierTask = newTask(ctx, task_type_barrier, start);
+        barrierTask->task.recordMemOpAction(true, 8, addr);
+        barrierOpen = true;
+    }
+    else
+    {
+        barrierTask->open++;
+        barrierTask->task.setStartTime(start);
+        follow(ctx, barrierTask, start);
+        last[ctx] = barrierTask;
+    }
+    beforeBarrier[ctx] = prev;
+}
+
+//
+// A context that exits is followed by the join of the context that waits on it
+//
+void GraphSink::join(uint32_t ctx, uint32_t other, bool isExit, ct_timestamp start, ct_timestamp end)
+{
+    ensureContext(ctx);
+    ensureContext(other);
+    start = localTime(ctx, start);
+    end = localTime(ctx, end);
+
+    if (isExit)
+    {
+        if (last[ctx] != NULL && last[ctx]->task.getType() == task_type_basic_blocks) last[ctx]->task.setEndTime(start);
+        exited[ctx] = last[ctx];
+        last[ctx] = NULL;
+        return;
+    }
+
+    PendingTask* pt = newTask(ctx, task_type_join, start);
+    pt->task.setEndTime(end);
+    if (exited[other] != NULL)
+    {
+        link(exited[other], pt);
+        exited[other] = NULL;
+    }
+    continueContext(ctx, end);
+}
+
+//
+// The region starts and ends with new tasks of the context, as in the middle layer
+//
+void GraphSink::roi(uint32_t ctx, ct_timestamp time)
+{
+    ensureContext(ctx);
+    time = localTime(ctx, time);
+
+    continueContext(ctx, time);
+    if (!roiStarted)
+    {
+        roiStart = last[ctx]->task.getTaskId();
+        roiStarted = true;
+    }
+    else if (!roiEnded)
+    {
+        roiEnd = last[ctx]->task.getTaskId();
+        roiEnded = true;
+    }
+}
+
+bool GraphSink::finish()
+{
+    // Every context's last task and every waiting release has no follower
+    for (uint32_t c = 0; c < last.size(); c++)
+    {
+        if (last[c] != NULL && last[c]->open > 0) last[c]->open--;
+        last[c] = NULL;
+        if (exited[c] != NULL && exited[c]->open > 0) exited[c]->open--;
+        exited[c] = NULL;
+        if (beforeBarrier[c] != NULL && beforeBarrier[c]->open > 0) beforeBarrier[c]->open--;
+        beforeBarrier[c] = NULL;
+        for (auto& h : heldLocks[c])
+        {
+            if (h.second->open > 0) h.second->open--;
+        }
+        heldLocks[c].clear();
+    }
+    drain(true);
+    if (out == NULL) return false;
+
+    if (roiStarted && roiEnded) out->setROI(roiStart, roiEnd);
+    if (!out->close()) failed = true;
+
+    return !failed;
+}
@@ -0,0 +1,180 @@
+#include "ctgen.hpp"
+#include <string.h>
+
+using namespace std;
+using namespace contech;
+
+//
+// Generate a synthetic program, either as a raw trace for the middle layer, or
+//   directly as a task graph, so that each layer can be benchmarked on inputs of
+//   any size that are the same from run to run
+//
+//   The trace is written as it is generated, so its size is only limited by the
+//   disk.  The output is determined by the options and the seed alone.
+//
+
+// The middle layer's limit on contexts, and the bits of a block id in a trace
+#define MAX_THREADS 1024
+#define MAX_BLOCKS (1U << 23)
+#define MAX_ADDRESS (1ULL << 48)
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "%s [options] <output>\n", name);
+    fprintf(stderr, "\t-g write a task graph, rather than a trace\n");
+    fprintf(stderr, "\t-t <contexts> (4)\n");
+    fprintf(stderr, "\t-b <basic blocks> (256)\n");
+    fprintf(stderr, "\t-B <loop bodies>[:<min blocks>:<max blocks>] (6:2:12)\n");
+    fprintf(stderr, "\t-m <min>:<max> memops of each block (0:6)\n");
+    fprintf(stderr, "\t-d <percent> of memops at an offset from another (10)\n");
+    fprintf(stderr, "\t-a <percent> of memops that walk an array, the rest are random (90)\n");
+    fprintf(stderr, "\t-s <percent> of random memops to the shared region (10)\n");
+    fprintf(stderr, "\t-f <bytes> of each region (1M)\n");
+    fprintf(stderr, "\t-l <percent>[:<locks>] of iterations that take a lock (30:4)\n");
+    fprintf(stderr, "\t-p <iterations> between barriers, 0 for none (10)\n");
+    fprintf(stderr, "\t-i <iterations> of each context (1000 without -z)\n");
+    fprintf(stderr, "\t-z <bytes> of trace events to stop at, such as 100G\n");
+    fprintf(stderr, "\t-r <seed> (1)\n");
+    fprintf(stderr, "\t-T <blocks> of a task before it is split, for -g (65536)\n");
+    fprintf(stderr, "\t-w <bytes> of each context's buffer, for traces (1M)\n");
+    fprintf(stderr, "\tThe trace is written to stdout if the output is -\n");
+}
+
+// A count of bytes, with an optional K, M or G
+static bool parseSize(const char* s, uint64_t& v)
+{
+    char* end;
+    v = strtoull(s, &end, 0);
+    if (end == s) return false;
+    switch (*end)
+    {
+        case 'G': case 'g': v <<= 10;
+        case 'M': case 'm': v <<= 10;
+        case 'K': case 'k': v <<= 10; end++;
+        default: break;
+    }
+    return *end == '\0';
+}
+
+static bool parsePair(const char* s, uint32_t& a, uint32_t& b)
+{
+    return sscanf(s, "%u:%u", &a, &b) == 2;
+}
+
+int main(int argc, char const *argv[])
+{
+    GenOptions opt;
+    bool writeGraph = false;
+    uint64_t maxBlocks = 65536, bufferSize = 1 << 20;
+    bool valid = true;
+    int argPos = 1;
+
+    while (argPos < argc - 1 && argv[argPos][0] == '-' && argv[argPos][1] != '\0')
+    {
+        const char* o = argv[argPos];
+        const char* v = argv[argPos + 1];
+        uint64_t n;
+
+        if (!strcmp(o, "-g"))
+        {
+            writeGraph = true;
+            argPos += 1;
+            continue;
+        }
+        if (argPos + 2 >= argc)
+        {
+            valid = false;
+            break;
+        }
+
+        if (!strcmp(o, "-t")) opt.threads = atoi(v);
+        else if (!strcmp(o, "-b")) opt.bbCount = atoi(v);
+        else if (!strcmp(o, "-B"))
+        {
+            int c = sscanf(v, "%u:%u:%u", &opt.bodyCount, &opt.bodyMin, &opt.bodyMax);
+            valid = (c == 1 || c == 3);
+        }
+        else if (!strcmp(o, "-m")) valid = parsePair(v, opt.memOpMin, opt.memOpMax);
+        else if (!strcmp(o, "-d")) opt.dupPercent = atoi(v);
+        else if (!strcmp(o, "-a")) opt.stridedPercent = atoi(v);
+        else if (!strcmp(o, "-s")) opt.sharedPercent = atoi(v);
+        else if (!strcmp(o, "-f")) valid = parseSize(v, opt.footprint);
+        else if (!strcmp(o, "-l"))
+        {
+            int c = sscanf(v, "%u:%u", &opt.lockPercent, &opt.lockCount);
+            valid = (c >= 1);
+        }
+        else if (!strcmp(o, "-p")) opt.barrierInterval = atoi(v);
+        else if (!strcmp(o, "-i")) opt.iterations = strtoull(v, NULL, 0);
+        else if (!strcmp(o, "-z")) valid = parseSize(v, opt.targetBytes);
+        else if (!strcmp(o, "-r")) opt.seed = strtoull(v, NULL, 0);
+        else if (!strcmp(o, "-T")) maxBlocks = strtoull(v, NULL, 0);
+        else if (!strcmp(o, "-w")) valid = parseSize(v, bufferSize);
+        else valid = false;
+
+        if (!valid) break;
+        argPos += 2;
+    }
+    if (!valid || argc - argPos != 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opt.iterations == 0 && opt.targetBytes == 0) opt.iterations = 1000;
+
+    // Every address fits in the 48 bits of a trace's memop
+    uint64_t regionSize = (opt.footprint + (1 << 20) - 1) & ~((1ULL << 20) - 1);
+    const char* error = NULL;
+    if (opt.threads == 0 || opt.threads > MAX_THREADS) error = "Contexts must be from 1 to 1024";
+    else if (opt.bbCount == 0 || opt.bbCount > MAX_BLOCKS) error = "Basic blocks must be from 1 to 2^23";
+    else if (opt.bodyCount == 0 || opt.bodyMin == 0 || opt.bodyMin > opt.bodyMax) error = "Loop bodies need at least one block";
+    else if (opt.memOpMin > opt.memOpMax || opt.memOpMax > 1024) error = "Memops must be a range within 0 to 1024";
+    else if (opt.dupPercent > 100 || opt.stridedPercent > 100 || opt.sharedPercent > 100 || opt.lockPercent > 100) error = "Percents must be at most 100";
+    else if (opt.footprint < 4096 || (opt.footprint % 64) != 0) error = "Regions must be a multiple of 64 bytes, and at least 4K";
+    else if (0x10000000ULL + (opt.threads + 1) * regionSize > MAX_ADDRESS) error = "Regions do not fit in 48 bit addresses";
+    else if (opt.lockCount == 0) error = "There must be at least one lock";
+    else if (maxBlocks == 0 || bufferSize == 0) error = "Tasks and buffers must not be empty";
+    if (error != NULL)
+    {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+
+    const char* fname = argv[argPos];
+    Workload w(opt);
+
+    if (writeGraph)
+    {
+        GraphSink sink(fname, maxBlocks);
+        w.run(&sink);
+        if (!sink.finish())
+        {
+            fprintf(stderr, "Failure to write task graph - %s\n", fname);
+            return 1;
+        }
+        printf("Wrote %lu tasks, of %lu bytes of events, to %s\n", sink.getTaskCount(), w.getEventBytes(), fname);
+        return 0;
+    }
+
+    bool toStdout = !strcmp(fname, "-");
+    FILE* out = toStdout ? stdout : fopen(fname, "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failure to open output - %s\n", fname);
+        return 1;
+    }
+
+    TraceSink sink(out, bufferSize);
+    w.run(&sink);
+    bool written = sink.finish();
+    if (!toStdout && fclose(out) != 0) written = false;
+    if (!written)
+    {
+        fprintf(stderr, "Failure to write trace - %s\n", fname);
+        return 1;
+    }
+    fprintf(toStdout ? stderr : stdout, "Wrote %lu bytes, of %lu bytes of events, to %s\n",
+            sink.getBytesWritten(), w.getEventBytes(), fname);
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include "ctgen.hpp"
+#include <string.h>
+#include <assert.h>
+
+using namespace std;
+using namespace contech;
+
+//
+// Append the bytes of a value, as the runtime stores it on this (little endian) host
+//
+template <typename T>
+static inline void put(vector<uint8_t>& buf, T v)
+{
+    const uint8_t* p = (const uint8_t*)&v;
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+// Events other than blocks, infos, buffers and rois are padded to 4 bytes
+static inline void putType(vector<uint8_t>& buf, uint8_t type, bool pad)
+{
+    buf.push_back(type);
+    if (pad)
+    {
+        buf.push_back(0);
+        buf.push_back(0);
+        buf.push_back(0);
+    }
+}
+
+TraceSink::TraceSink(FILE* f, uint32_t bufSize)
+{
+    out = f;
+    bufferSize = bufSize;
+    bytesWritten = 0;
+    failed = false;
+}
+
+void TraceSink::write(const void* data, size_t length)
+{
+    if (length == 0) return;
+    if (fwrite(data, 1, length, out) != length) failed = true;
+    bytesWritten += length;
+}
+
+vector<uint8_t>& TraceSink::buffer(uint32_t ctx)
+{
+    if (ctx >= buffers.size())
+    {
+        buffers.resize(ctx + 1);
+    }
+    return buffers[ctx];
+}
+
+//
+// A buffer event names the context of the bytes that follow it, and their length
+//
+void TraceSink::flush(uint32_t ctx)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+    if (buf.empty()) return;
+
+    unsigned int marker[3];
+    marker[0] = ct_event_buffer;
+    marker[1] = ctx;
+    marker[2] = buf.size();
+    write(marker, sizeof(marker));
+    write(buf.data(), buf.size());
+    buf.clear();
+}
+
+//
+// The version event, the rank, and then an info event for each block
+//
+void TraceSink::basicBlockInfo(const vector<GenBlock>& blocks)
+{
+    vector<uint8_t> info;
+    unsigned int header[6];
+
+    header[0] = 0;
+    header[1] = ct_event_version;
+    header[2] = CONTECH_EVENT_VERSION;
+    header[3] = blocks.size();
+    header[4] = ct_event_rank;
+    header[5] = 0;
+    write(header, sizeof(header));
+
+    blockTable.clear();
+    for (uint32_t b = 0; b < blocks.size(); b++)
+    {
+        const GenBlock& blk = blocks[b];
+        blockTable.push_back(&blk);
+
+        info.clear();
+        putType(info, ct_event_basic_block_info, false);
+        put<uint32_t>(info, b);
+        put<int32_t>(info, -1);
+        put<uint32_t>(info, blk.flags);
+        put<uint32_t>(info, blk.line);
+        put<uint32_t>(info, blk.numOps);
+        put<uint32_t>(info, blk.critPathLen);
+        const string* names[3] = {&blk.function, &blk.file, &blk.callsFunction};
+        for (int i = 0; i < 3; i++)
+        {
+            put<uint32_t>(info, names[i]->length());
+            info.insert(info.end(), names[i]->begin(), names[i]->end());
+        }
+        put<uint32_t>(info, blk.memOps.size());
+        for (const GenMemOp& op : blk.memOps)
+        {
+            info.push_back((op.isWrite ? 0x1 : 0) | (op.isDup ? BBI_FLAG_MEM_DUP : 0));
+            info.push_back(op.powSize);
+            if (op.isDup)
+            {
+                put<uint16_t>(info, 0);
+                put<int32_t>(info, op.dupOffset);
+            }
+        }
+        write(info.data(), info.size());
+    }
+}
+
+//
+// The low 7 bits of the id are the event type, then the high bits, then the
+//   48 bit address of each memop that is not a duplicate
+//
+void TraceSink::basicBlock(uint32_t ctx, uint32_t bbid, const uint64_t* addrs, ct_timestamp time)
+{
+    const GenBlock& blk = *blockTable[bbid];
+    vector<uint8_t>& buf = buffer(ctx);
+
+    buf.push_back(bbid & 0x7f);
+    put<uint16_t>(buf, bbid >> 7);
+    for (uint32_t i = 0; i < blk.memOps.size(); i++)
+    {
+        if (blk.memOps[i].isDup) continue;
+        put<uint32_t>(buf, (uint32_t)addrs[i]);
+        put<uint16_t>(buf, (uint16_t)(addrs[i] >> 32));
+    }
+
+    if (buf.size() >= bufferSize) flush(ctx);
+}
+
+void TraceSink::memory(uint32_t ctx, bool isAllocate, uint64_t size, uint64_t addr)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_memory, true);
+    put<bool>(buf, isAllocate);
+    put<uint64_t>(buf, size);
+    put<uint64_t>(buf, addr);
+
+    if (buf.size() >= bufferSize) flush(ctx);
+}
+
+// The child records its creation with a skew, which is 0 for the creator
+void TraceSink::create(uint32_t ctx, uint32_t other, bool isChild, ct_timestamp start, ct_timestamp end)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_task_create, true);
+    put<uint64_t>(buf, start);
+    put<uint64_t>(buf, end);
+    put<uint32_t>(buf, other);
+    put<int64_t>(buf, isChild ? CTGEN_CHILD_SKEW : 0);
+
+    flush(ctx);
+}
+
+void TraceSink::sync(uint32_t ctx, bool isAcquire, uint64_t addr, uint64_t ticket, ct_timestamp start, ct_timestamp end)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_sync, true);
+    put<uint64_t>(buf, start);
+    put<uint64_t>(buf, end);
+    put<int32_t>(buf, isAcquire ? ct_sync_acquire : ct_sync_release);
+    put<uint64_t>(buf, addr);
+    put<uint64_t>(buf, ticket);
+
+    flush(ctx);
+}
+
+void TraceSink::barrier(uint32_t ctx, bool onEnter, uint64_t addr, uint64_t barrierNum, ct_timestamp start, ct_timestamp end)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_barrier, true);
+    put<bool>(buf, onEnter);
+    put<uint64_t>(buf, start);
+    put<uint64_t>(buf, end);
+    put<uint64_t>(buf, addr);
+    put<uint64_t>(buf, barrierNum);
+
+    flush(ctx);
+}
+
+void TraceSink::join(uint32_t ctx, uint32_t other, bool isExit, ct_timestamp start, ct_timestamp end)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_task_join, true);
+    put<bool>(buf, isExit);
+    put<uint64_t>(buf, start);
+    put<uint64_t>(buf, end);
+    put<uint32_t>(buf, other);
+
+    flush(ctx);
+}
+
+void TraceSink::roi(uint32_t ctx, ct_timestamp time)
+{
+    vector<uint8_t>& buf = buffer(ctx);
+
+    putType(buf, ct_event_roi, false);
+    put<uint64_t>(buf, time);
+
+    flush(ctx);
+}
+
+bool TraceSink::finish()
+{
+    for (uint32_t c = 0; c < buffers.size(); c++)
+    {
+        flush(c);
+    }
+    if (fflush(out) != 0) failed = true;
+
+    return !failed;
+}
@@ -0,0 +1,294 @@
+#include "ctgen.hpp"
+#include <assert.h>
+
+using namespace std;
+using namespace contech;
+
+// The regions of memory are aligned to 1MB, after the shared one
+#define REGION_START 0x10000000ULL
+#define REGION_ALIGN (1ULL << 20)
+#define LOCK_BASE 0x9000ULL
+#define BARRIER_ADDR 0x7000ULL
+// Iterations that a context runs the same body before the next one
+#define PHASE_ITERATIONS 50
+
+GenOptions::GenOptions()
+{
+    threads = 4;
+    bbCount = 256;
+    bodyCount = 6;
+    bodyMin = 2;
+    bodyMax = 12;
+    memOpMin = 0;
+    memOpMax = 6;
+    dupPercent = 10;
+    stridedPercent = 90;
+    sharedPercent = 10;
+    footprint = 1ULL << 20;
+    lockPercent = 30;
+    lockCount = 4;
+    barrierInterval = 10;
+    iterations = 0;
+    targetBytes = 0;
+    seed = 1;
+}
+
+Workload::Workload(const GenOptions& o) : opt(o), rng(o.seed)
+{
+    now = 1000;
+    ticketNum = 0;
+    barrierNum = 0;
+    eventBytes = 0;
+
+    buildBlocks();
+}
+
+//
+// The distributions of <random> differ between libraries, so the values are
+//   taken from the engine directly, which the standard fixes
+//
+uint32_t Workload::random(uint32_t low, uint32_t high)
+{
+    if (high <= low) return low;
+    return low + (uint32_t)(rng() % ((uint64_t)high - low + 1));
+}
+
+bool Workload::percent(uint32_t p)
+{
+    return (rng() % 100) < p;
+}
+
+ct_timestamp Workload::tick(uint32_t low, uint32_t high)
+{
+    now += random(low, high);
+    return now;
+}
+
+// Context regions follow the shared region, which is ctx ~0
+uint64_t Workload::regionBase(uint32_t ctx)
+{
+    uint64_t size = (opt.footprint + REGION_ALIGN - 1) & ~(REGION_ALIGN - 1);
+    return REGION_START + (uint64_t)(ctx + 1) * size;
+}
+
+void Workload::buildBlocks()
+{
+    char name[64];
+
+    streamCount = 0;
+    blocks.resize(opt.bbCount);
+    for (uint32_t b = 0; b < opt.bbCount; b++)
+    {
+        GenBlock& blk = blocks[b];
+        uint32_t memOps = random(opt.memOpMin, opt.memOpMax);
+
+        blk.line = 10 + b;
+        blk.numOps = memOps + random(1, 8);
+        blk.critPathLen = random(1, blk.numOps);
+        blk.flags = percent(10) ? BBI_FLAG_CONTAIN_CALL : 0;
+        blk.firstStream = streamCount;
+
+        // A few blocks to a function, and many functions to a file
+        snprintf(name, sizeof(name), "func%u", b / 8);
+        blk.function = name;
+        snprintf(name, sizeof(name), "file%u.c", b / 64);
+        blk.file = name;
+        if (blk.flags & BBI_FLAG_CONTAIN_CALL)
+        {
+            snprintf(name, sizeof(name), "func%u", random(0, (opt.bbCount - 1) / 8));
+            blk.callsFunction = name;
+        }
+
+        blk.memOps.resize(memOps);
+        for (uint32_t i = 0; i < memOps; i++)
+        {
+            GenMemOp& op = blk.memOps[i];
+            op.isWrite = percent(30);
+            op.powSize = random(2, 3);
+            op.isDup = (i > 0 && percent(opt.dupPercent));
+            op.isStrided = percent(opt.stridedPercent);
+            op.dupOffset = 8 * i;
+        }
+        streamCount += memOps;
+    }
+
+    bodies.resize(opt.bodyCount);
+    for (uint32_t i = 0; i < opt.bodyCount; i++)
+    {
+        uint32_t len = random(opt.bodyMin, opt.bodyMax);
+        for (uint32_t j = 0; j < len; j++)
+        {
+            bodies[i].push_back(random(0, opt.bbCount - 1));
+        }
+    }
+
+    streamNext.assign((uint64_t)opt.threads * streamCount, 0);
+    streamStride.assign((uint64_t)opt.threads * streamCount, 0);
+    addrs.resize(opt.memOpMax + 1);
+}
+
+//
+// Each memop either walks an array of its own with a fixed stride, wrapping
+//   within the context's region, or goes to a random line of the context's or the
+//   shared region.  Duplicate memops are at an offset from the first memop.
+//
+void Workload::emitBlock(GenSink* sink, uint32_t ctx, uint32_t bbid)
+{
+    const GenBlock& blk = blocks[bbid];
+    uint32_t nonDup = 0;
+
+    for (uint32_t i = 0; i < blk.memOps.size(); i++)
+    {
+        const GenMemOp& op = blk.memOps[i];
+        uint64_t size = 1ULL << op.powSize;
+
+        if (op.isDup)
+        {
+            addrs[i] = addrs[0] + op.dupOffset;
+            continue;
+        }
+        nonDup++;
+
+        if (op.isStrided)
+        {
+            uint64_t s = (uint64_t)ctx * streamCount + blk.firstStream + i;
+            uint64_t base = regionBase(ctx);
+            if (streamNext[s] == 0)
+            {
+                static const uint32_t strides[] = {1, 1, 2, 16};
+                streamNext[s] = base + ((rng() % opt.footprint) & ~(size - 1));
+                streamStride[s] = (uint32_t)size * strides[random(0, 3)];
+            }
+            addrs[i] = streamNext[s];
+            streamNext[s] += streamStride[s];
+            if (streamNext[s] + size > base + opt.footprint) streamNext[s] -= opt.footprint & ~(size - 1);
+        }
+        else
+        {
+            uint64_t base = percent(opt.sharedPercent) ? regionBase(~0U) : regionBase(ctx);
+            addrs[i] = base + ((rng() % opt.footprint) & ~(size - 1));
+        }
+    }
+
+    eventBytes += CTGEN_BLOCK_BYTES + nonDup * CTGEN_MEMOP_BYTES;
+    sink->basicBlock(ctx, bbid, addrs.data(), tick(1, blk.numOps));
+}
+
+void Workload::emitSync(GenSink* sink, uint32_t ctx, bool isAcquire, uint64_t addr)
+{
+    ct_timestamp start = tick(1, 20);
+    ct_timestamp end = tick(1, 20);
+
+    eventBytes += CTGEN_SYNC_BYTES;
+    sink->sync(ctx, isAcquire, addr, ticketNum++, start, end);
+}
+
+//
+// Every context enters before any leaves, and each event has its own number
+//
+void Workload::emitBarrier(GenSink* sink, uint64_t addr)
+{
+    for (int onEnter = 1; onEnter >= 0; onEnter--)
+    {
+        for (uint32_t c = 0; c < opt.threads; c++)
+        {
+            ct_timestamp start = tick(1, 20);
+            ct_timestamp end = tick(1, 20);
+
+            eventBytes += CTGEN_BARRIER_BYTES;
+            sink->barrier(c, onEnter != 0, addr, barrierNum++, start, end);
+        }
+    }
+}
+
+void Workload::run(GenSink* sink)
+{
+    ct_timestamp start, end;
+
+    // The version and rank events, and then the info of each block
+    eventBytes += 6 * sizeof(uint32_t);
+    for (const GenBlock& blk : blocks)
+    {
+        eventBytes += 1 + 9 * sizeof(uint32_t) + blk.function.length() + blk.file.length() + blk.callsFunction.length();
+        for (const GenMemOp& op : blk.memOps)
+        {
+            eventBytes += op.isDup ? 8 : 2;
+        }
+    }
+    sink->basicBlockInfo(blocks);
+
+    // The main context starts and allocates the shared region
+    start = tick(1, 20);
+    end = tick(1, 20);
+    eventBytes += CTGEN_CREATE_BYTES;
+    sink->create(0, 0, false, start, end);
+    for (int i = 0; i < 5; i++)
+    {
+        emitBlock(sink, 0, random(0, opt.bbCount - 1));
+    }
+    eventBytes += CTGEN_MEMORY_BYTES;
+    sink->memory(0, true, opt.footprint, regionBase(~0U));
+
+    // Then creates the others, which each record their creation
+    for (uint32_t c = 1; c < opt.threads; c++)
+    {
+        start = tick(1, 20);
+        end = tick(1, 20);
+        eventBytes += 2 * CTGEN_CREATE_BYTES;
+        sink->create(0, c, false, start, end);
+        sink->create(c, 0, true, start, end);
+    }
+    eventBytes += CTGEN_ROI_BYTES;
+    sink->roi(0, tick(1, 20));
+
+    for (uint64_t it = 0; ; it++)
+    {
+        if (opt.iterations != 0 && it >= opt.iterations) break;
+        if (opt.targetBytes != 0 && eventBytes >= opt.targetBytes) break;
+
+        for (uint32_t c = 0; c < opt.threads; c++)
+        {
+            const vector<uint32_t>& body = bodies[(c + it / PHASE_ITERATIONS) % bodies.size()];
+            for (uint32_t bbid : body)
+            {
+                emitBlock(sink, c, bbid);
+            }
+
+            if (percent(opt.lockPercent))
+            {
+                uint64_t lock = LOCK_BASE + 64 * random(0, opt.lockCount - 1);
+                emitSync(sink, c, true, lock);
+                emitBlock(sink, c, random(0, opt.bbCount - 1));
+                emitSync(sink, c, false, lock);
+            }
+        }
+
+        if (opt.barrierInterval != 0 && (it % opt.barrierInterval) == opt.barrierInterval - 1)
+        {
+            emitBarrier(sink, BARRIER_ADDR);
+        }
+    }
+    eventBytes += CTGEN_ROI_BYTES;
+    sink->roi(0, tick(1, 20));
+
+    // The others exit, and the main context joins them in order
+    for (uint32_t c = 1; c < opt.threads; c++)
+    {
+        emitBlock(sink, c, 1 % opt.bbCount);
+        start = tick(1, 20);
+        end = tick(1, 20);
+        eventBytes += CTGEN_JOIN_BYTES;
+        sink->join(c, 0, true, start, end);
+    }
+    for (uint32_t c = 1; c < opt.threads; c++)
+    {
+        start = tick(1, 20);
+        end = tick(1, 20);
+        eventBytes += CTGEN_JOIN_BYTES;
+        sink->join(0, c, false, start, end);
+        emitBlock(sink, 0, 2 % opt.bbCount);
+    }
+    eventBytes += CTGEN_MEMORY_BYTES;
+    sink->memory(0, false, 0, regionBase(~0U));
+    emitBlock(sink, 0, 3 % opt.bbCount);
+}
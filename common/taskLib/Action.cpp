@@ -1,9 +1,9 @@
 #include "Action.hpp"
 using namespace contech;
 
-MemoryAction::MemoryAction() {}
+MemoryAction::MemoryAction() : data(0) {}
 MemoryAction::MemoryAction(Action a) : data(a.data) {}
-BasicBlockAction::BasicBlockAction() {}
+BasicBlockAction::BasicBlockAction() : data(0) {}
 BasicBlockAction::BasicBlockAction(Action a) : data(a.data) {}
 
 Action::Action() {}
@@ -0,0 +1,66 @@
+#include "ActionArena.hpp"
+#include <stdlib.h>
+#include <new>
+
+using namespace contech;
+
+ActionArena::ActionArena()
+{
+    pthread_mutex_init(&freeLock, NULL);
+}
+
+ActionArena::~ActionArena()
+{
+    for (Action* seg : freeSegments)
+    {
+        free(seg);
+    }
+    pthread_mutex_destroy(&freeLock);
+}
+
+ActionSegment ActionArena::allocSegment(uint32_t minCapacity)
+{
+    ActionSegment seg;
+
+    seg.actions = NULL;
+    seg.used = 0;
+    seg.capacity = (minCapacity > ACTION_SEGMENT_SIZE) ? minCapacity : ACTION_SEGMENT_SIZE;
+
+    if (seg.capacity == ACTION_SEGMENT_SIZE)
+    {
+        pthread_mutex_lock(&freeLock);
+        if (!freeSegments.empty())
+        {
+            seg.actions = freeSegments.back();
+            freeSegments.pop_back();
+        }
+        pthread_mutex_unlock(&freeLock);
+    }
+
+    if (seg.actions == NULL)
+    {
+        seg.actions = (Action*) malloc(seg.capacity * sizeof(Action));
+        if (seg.actions == NULL) throw std::bad_alloc();
+    }
+
+    return seg;
+}
+
+void ActionArena::freeSegment(ActionSegment& seg)
+{
+    if (seg.capacity == ACTION_SEGMENT_SIZE)
+    {
+        pthread_mutex_lock(&freeLock);
+        if (freeSegments.size() < ACTION_ARENA_MAX_FREE)
+        {
+            freeSegments.push_back(seg.actions);
+            seg.actions = NULL;
+        }
+        pthread_mutex_unlock(&freeLock);
+    }
+
+    free(seg.actions);
+    seg.actions = NULL;
+    seg.used = 0;
+    seg.capacity = 0;
+}
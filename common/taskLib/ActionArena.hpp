@@ -0,0 +1,51 @@
+#ifndef CT_ACTION_ARENA_HPP
+#define CT_ACTION_ARENA_HPP
+
+#include "Action.hpp"
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+namespace contech {
+
+// Number of actions in a standard segment, and the most free segments an arena retains
+#define ACTION_SEGMENT_SIZE 4096
+#define ACTION_ARENA_MAX_FREE 4
+
+// A contiguous, append-only run of actions
+struct ActionSegment
+{
+    Action* actions;
+    uint32_t used;
+    uint32_t capacity;
+};
+
+//
+// Slab of action segments for tasks under construction
+//
+//   Once a task with an arena outgrows a standard segment, it records further
+//   actions into segments rather than growing its vector, so a large task never
+//   reallocates and copies its actions.  Standard segments are recycled through
+//   the arena, larger ones are allocated exactly.  Tasks are often deleted on a
+//   different thread than the one building them, so the free list is locked.
+//
+class ActionArena
+{
+public:
+    ActionArena();
+    ~ActionArena();
+    ActionArena(const ActionArena&) = delete;
+    ActionArena& operator=(const ActionArena&) = delete;
+
+    // Allocate a segment with room for at least minCapacity actions
+    ActionSegment allocSegment(uint32_t minCapacity);
+    void freeSegment(ActionSegment& seg);
+
+private:
+    pthread_mutex_t freeLock;
+    std::vector<Action*> freeSegments;
+};
+
+} // end namespace contech
+
+#endif
@@ -5,6 +5,10 @@ using namespace contech;
 
 void Backend::initBackend(TaskGraphInfo*) {}
 
+Backend* Backend::createContextBackend(ContextId) { return NULL; }
+
+void Backend::mergeContextBackend(Backend*) {}
+
 SimpleBackendWrapper::SimpleBackendWrapper(char* f, Backend* b) : backend(b)
 {
     tg = TaskGraph::initFromFile(f);
@@ -13,12 +17,23 @@ SimpleBackendWrapper::SimpleBackendWrapper(char* f, Backend* b) : backend(b)
 
 void SimpleBackendWrapper::runBackend()
 {
-    Task* t = NULL;
+    Task t;
+    
+    // Each task is read into the same Task
+    while (tg->readNextInto(t))
+    {
+        backend->updateBackend(&t);
+    }
+}
+
+void SimpleBackendWrapper::runBackendReverse()
+{
+    ReverseTaskCursor c = tg->getReverseCursor();
+    Task t;
     
-    while ((t = tg->getNextTask()) != NULL)
+    while (c.readNextInto(t))
     {
-        backend->updateBackend(t);
-        delete t;
+        backend->updateBackend(&t);
     }
 }
 
@@ -9,10 +9,19 @@ namespace contech
 class Backend
 {
 public:
+    virtual ~Backend() {}
     virtual void initBackend(contech::TaskGraphInfo*);
     virtual void resetBackend() = 0;
+    // The task is only valid during the call, the wrapper reuses it for the next task
     virtual void updateBackend(contech::Task*) = 0;
     virtual void completeBackend(FILE*, contech::TaskGraphInfo*) = 0;
+    
+    // Backends whose state for each context is independent can process each context
+    //   on its own, see ContextParallelRunner.  Returns a new backend that is only
+    //   given the tasks of ctx, or NULL if this backend needs every task in order.
+    virtual Backend* createContextBackend(contech::ContextId ctx);
+    // Add the results of a backend from createContextBackend to this one
+    virtual void mergeContextBackend(Backend* ctxBackend);
 };
 
 class SimpleBackendWrapper
@@ -25,6 +34,8 @@ public:
     SimpleBackendWrapper(char*, contech::Backend*);
     ~SimpleBackendWrapper();
     void runBackend();
+    // Each task after all of its successors, for backward analyses
+    void runBackendReverse();
     void initBackend();
     void completeRun(FILE*);
 };
@@ -0,0 +1,182 @@
+#include "BasicBlockSequences.hpp"
+#include "ct_file.h"
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <zlib.h>
+
+using namespace std;
+using namespace contech;
+
+BasicBlockSequences::BasicBlockSequences()
+{
+    starts.push_back(0);
+}
+
+uint64_t BasicBlockSequences::hashWords(const uint64_t* w, uint64_t n) const
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (uint64_t i = 0; i < n; i++)
+    {
+        h = (h ^ w[i]) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+uint32_t BasicBlockSequences::addSequence(const Action* actions, uint64_t count)
+{
+    uint64_t run = 0;
+    bool hasBasicBlock = false;
+
+    // Build the sequence, runs of memory actions become their count
+    shape.clear();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        Action act = actions[i];
+        if (act.getType() == action_type_null) return 0;
+        if (!act.isBasicBlockAction())
+        {
+            run++;
+            continue;
+        }
+        if (run > 0) shape.push_back(run);
+        run = 0;
+        shape.push_back(act.data);
+        hasBasicBlock = true;
+        if (shape.size() > BB_SEQUENCE_MAX_LENGTH) return 0;
+    }
+    if (run > 0) shape.push_back(run);
+    if (!hasBasicBlock || shape.size() > BB_SEQUENCE_MAX_LENGTH) return 0;
+
+    uint64_t h = hashWords(shape.data(), shape.size());
+    auto range = byHash.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Span<const uint64_t> s = getSequence(it->second);
+        if (s.size() == shape.size() &&
+            0 == memcmp(s.data(), shape.data(), shape.size() * sizeof(uint64_t)))
+        {
+            return it->second;
+        }
+    }
+
+    // A full dictionary only matches, so there is no need to remember the hash
+    if (words.size() + shape.size() > BB_SEQUENCE_MAX_WORDS ||
+        getSequenceCount() == UINT32_MAX)
+    {
+        return 0;
+    }
+
+    // The first time, only remember the hash.  Forgetting them all once there are
+    //   too many only delays adding the sequences that do repeat.
+    if (seenOnce.count(h) == 0)
+    {
+        if (seenOnce.size() >= BB_SEQUENCE_MAX_SEEN) seenOnce.clear();
+        seenOnce.insert(h);
+        return 0;
+    }
+    seenOnce.erase(h);
+
+    words.insert(words.end(), shape.begin(), shape.end());
+    starts.push_back(words.size());
+    uint32_t id = getSequenceCount();
+    byHash.insert(make_pair(h, id));
+
+    return id;
+}
+
+Span<const uint64_t> BasicBlockSequences::getSequence(uint32_t id) const
+{
+    if (id == 0 || id > getSequenceCount()) return Span<const uint64_t>();
+
+    return Span<const uint64_t>(words.data() + starts[id - 1], starts[id] - starts[id - 1]);
+}
+
+void BasicBlockSequences::indexSequences()
+{
+    byHash.clear();
+    for (uint32_t id = 1; id <= getSequenceCount(); id++)
+    {
+        Span<const uint64_t> s = getSequence(id);
+        byHash.insert(make_pair(hashWords(s.data(), s.size()), id));
+    }
+}
+
+uint32_t BasicBlockSequences::getSequenceCount() const
+{
+    return starts.size() - 1;
+}
+
+size_t BasicBlockSequences::write(FILE* out) const
+{
+    uint64_t counts[2] = {getSequenceCount(), words.size()};
+    uint64_t uncompLength = sizeof(counts) + (starts.size() + words.size()) * sizeof(uint64_t);
+    unsigned char* src = (unsigned char*) malloc(uncompLength);
+    assert(src != NULL);
+
+    memcpy(src, counts, sizeof(counts));
+    memcpy(src + sizeof(counts), starts.data(), starts.size() * sizeof(uint64_t));
+    memcpy(src + sizeof(counts) + starts.size() * sizeof(uint64_t), words.data(), words.size() * sizeof(uint64_t));
+
+    uLongf dstLen = compressBound(uncompLength);
+    unsigned char* dst = (unsigned char*) malloc(dstLen);
+    assert(dst != NULL);
+    int r = compress(dst, &dstLen, src, uncompLength);
+    assert(r == Z_OK);
+    free(src);
+
+    uint64_t compLength = dstLen;
+    ct_write(&uncompLength, sizeof(uint64_t), out);
+    ct_write(&compLength, sizeof(uint64_t), out);
+    ct_write(dst, compLength, out);
+    free(dst);
+
+    return compLength + 2 * sizeof(uint64_t);
+}
+
+bool BasicBlockSequences::decode(const unsigned char* comp, uint64_t uncompLength, uint64_t compLength)
+{
+    uint64_t counts[2];
+
+    byHash.clear();
+    seenOnce.clear();
+    starts.assign(1, 0);
+    words.clear();
+    if (uncompLength < sizeof(counts)) return false;
+
+    unsigned char* src = (unsigned char*) malloc(uncompLength);
+    assert(src != NULL);
+    uLongf srcLen = uncompLength;
+    if (Z_OK != uncompress(src, &srcLen, comp, compLength) || srcLen != uncompLength)
+    {
+        free(src);
+        return false;
+    }
+
+    memcpy(counts, src, sizeof(counts));
+    if (uncompLength != sizeof(counts) + (counts[0] + 1 + counts[1]) * sizeof(uint64_t))
+    {
+        free(src);
+        return false;
+    }
+    starts.resize(counts[0] + 1);
+    memcpy(starts.data(), src + sizeof(counts), starts.size() * sizeof(uint64_t));
+    words.resize(counts[1]);
+    memcpy(words.data(), src + sizeof(counts) + starts.size() * sizeof(uint64_t), words.size() * sizeof(uint64_t));
+    free(src);
+
+    // Every sequence must be within the words
+    for (uint64_t i = 0; i < counts[0]; i++)
+    {
+        if (starts[i] > starts[i + 1] || starts[i + 1] > counts[1])
+        {
+            starts.assign(1, 0);
+            words.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef BASIC_BLOCK_SEQUENCES_HPP
+#define BASIC_BLOCK_SEQUENCES_HPP
+
+#include "Action.hpp"
+#include "Span.hpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace contech {
+
+// Sequences longer than this many words are not added, as they are unlikely to repeat
+#define BB_SEQUENCE_MAX_LENGTH 4096
+// Once the dictionary holds this many words, only existing sequences are matched
+#define BB_SEQUENCE_MAX_WORDS (1 << 22)
+// Hashes of sequences seen once that are remembered, before they are all forgotten
+#define BB_SEQUENCE_MAX_SEEN (1 << 20)
+
+//
+// Dictionary of the basic block sequences of the tasks in a graph
+//
+//   Tasks from the same loop often run the same basic blocks, with the same number
+//   of memory actions after each, and differ only in their addresses.  A sequence
+//   is the task's action list with each run of memory actions replaced by a count:
+//   the basic block action words, and action_type_null words holding the number of
+//   actions in a run.  Tasks with the same sequence share its id, so blocks only
+//   store their memory actions, and backends can reuse work done on the same id.
+//   Ids start at 1, 0 is a task without a sequence.  A sequence is only added the
+//   second time it is seen, so tasks that do not repeat keep their basic blocks.
+//
+//   Stored in a version 4 graph after the task summaries, compressed with the same
+//   length header as a block:
+//     uint64 uncompressed length, uint64 compressed length, zlib data of
+//     uint64 sequence count, uint64 word count,
+//     uint64 sequence starts[sequence count + 1], uint64 words[word count]
+//
+class BasicBlockSequences
+{
+public:
+    BasicBlockSequences();
+
+    // Find or add the sequence of a list of actions, returns 0 if it has none
+    uint32_t addSequence(const Action* actions, uint64_t count);
+    // Words of a sequence, empty for an unknown id
+    Span<const uint64_t> getSequence(uint32_t id) const;
+    uint32_t getSequenceCount() const;
+
+    // Returns the bytes written
+    size_t write(FILE* out) const;
+    // Replace the sequences with those from a compressed buffer
+    bool decode(const unsigned char* comp, uint64_t uncompLength, uint64_t compLength);
+    // Find the existing sequences in addSequence, e.g., once decoded to add to a graph's sequences
+    void indexSequences();
+
+private:
+    uint64_t hashWords(const uint64_t* w, uint64_t n) const;
+
+    // Start of each sequence in the words, with the end of the last
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> words;
+
+    // Sequences by their hash, and the hashes of those only seen once, while building
+    std::unordered_multimap<uint64_t, uint32_t> byHash;
+    std::unordered_set<uint64_t> seenOnce;
+    std::vector<uint64_t> shape;
+};
+
+}
+
+#endif
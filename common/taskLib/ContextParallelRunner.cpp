@@ -0,0 +1,221 @@
+#include "ContextParallelRunner.hpp"
+#include <sys/sysinfo.h>
+
+using namespace contech;
+
+ContextParallelRunner::ContextParallelRunner(const char* f, Backend* b) : backend(b)
+{
+    tg = TaskGraph::initFromFile(f);
+    assert(tg != NULL);
+    produced = 0;
+    readDone = false;
+    pthread_mutex_init(&queueLock, NULL);
+    pthread_cond_init(&taskReady, NULL);
+    pthread_cond_init(&slotFree, NULL);
+
+    threadCount = get_nprocs();
+    if (char* bt = getenv("CONTECH_BACKEND_THREADS"))
+    {
+        threadCount = atoi(bt);
+    }
+    threadCount = max(1, threadCount);
+}
+
+ContextParallelRunner::~ContextParallelRunner()
+{
+    delete tg;
+    pthread_mutex_destroy(&queueLock);
+    pthread_cond_destroy(&taskReady);
+    pthread_cond_destroy(&slotFree);
+}
+
+void ContextParallelRunner::setThreads(int n)
+{
+    threadCount = max(1, n);
+}
+
+void ContextParallelRunner::initBackend()
+{
+    backend->initBackend(tg->getTaskGraphInfo());
+}
+
+ContextParallelRunner::ContextWork* ContextParallelRunner::findWork(ContextId ctx)
+{
+    auto it = lower_bound(work.begin(), work.end(), ctx,
+                          [](const ContextWork& a, ContextId b) { return a.ctx < b; });
+    assert(it != work.end() && it->ctx == ctx);
+    return &*it;
+}
+
+//
+// Each context goes to the thread with the fewest tasks, largest contexts first
+//
+void ContextParallelRunner::assignThreads(int n)
+{
+    vector<ContextWork*> bySize;
+    vector<uint64> load(n, 0);
+
+    for (ContextWork& cw : work)
+    {
+        bySize.push_back(&cw);
+    }
+    stable_sort(bySize.begin(), bySize.end(),
+                [](const ContextWork* a, const ContextWork* b) { return a->taskCount > b->taskCount; });
+    for (ContextWork* cw : bySize)
+    {
+        int t = min_element(load.begin(), load.end()) - load.begin();
+        cw->thread = t;
+        load[t] += cw->taskCount;
+    }
+}
+
+void ContextParallelRunner::runBackend()
+{
+    vector<ContextId> contexts = tg->getContextIds();
+    Task t;
+
+    // The backends for each context are created on this thread, in case creating them is not thread safe
+    work.clear();
+    for (ContextId ctx : contexts)
+    {
+        ContextWork cw;
+        cw.ctx = ctx;
+        cw.taskCount = tg->contextCursor(ctx).getTaskCount();
+        cw.backend = backend->createContextBackend(ctx);
+        cw.thread = 0;
+        if (cw.backend == NULL) break;
+        cw.backend->initBackend(tg->getTaskGraphInfo());
+        work.push_back(cw);
+    }
+
+    if (work.size() != contexts.size())
+    {
+        // The backend needs every task in order
+        for (ContextWork& cw : work)
+        {
+            delete cw.backend;
+        }
+        work.clear();
+
+        while (tg->readNextInto(t))
+        {
+            backend->updateBackend(&t);
+        }
+        return;
+    }
+
+    int n = min((size_t)threadCount, work.size());
+    if (n <= 1)
+    {
+        while (tg->readNextInto(t))
+        {
+            findWork(t.getContextId())->backend->updateBackend(&t);
+        }
+    }
+    else
+    {
+        vector<pthread_t> threads(n);
+        vector<WorkerArg> args(n);
+
+        assignThreads(n);
+        queue.resize(CONTEXT_PARALLEL_QUEUE_DEPTH);
+        produced = 0;
+        readDone = false;
+        for (int i = 0; i < n; i++)
+        {
+            args[i].runner = this;
+            args[i].thread = i;
+            int r = pthread_create(&threads[i], NULL, contextWorker, &args[i]);
+            assert(r == 0);
+        }
+
+        // Fill the queue in task order, each context's tasks are then in sequence order
+        while (true)
+        {
+            QueueSlot& slot = queue[produced % queue.size()];
+
+            pthread_mutex_lock(&queueLock);
+            while (slot.pending > 0)
+            {
+                pthread_cond_wait(&slotFree, &queueLock);
+            }
+            pthread_mutex_unlock(&queueLock);
+
+            // No thread reads a slot until it is produced
+            if (!tg->readNextInto(slot.task)) break;
+            slot.work = findWork(slot.task.getContextId());
+
+            pthread_mutex_lock(&queueLock);
+            slot.pending = n;
+            produced++;
+            pthread_cond_broadcast(&taskReady);
+            pthread_mutex_unlock(&queueLock);
+        }
+
+        pthread_mutex_lock(&queueLock);
+        readDone = true;
+        pthread_cond_broadcast(&taskReady);
+        pthread_mutex_unlock(&queueLock);
+
+        for (pthread_t& th : threads)
+        {
+            pthread_join(th, NULL);
+        }
+        queue.clear();
+    }
+
+    for (ContextWork& cw : work)
+    {
+        backend->mergeContextBackend(cw.backend);
+        delete cw.backend;
+    }
+    work.clear();
+}
+
+//
+// Each thread walks the whole queue, only updating its own contexts' tasks
+//
+void* ContextParallelRunner::contextWorker(void* v)
+{
+    WorkerArg* arg = (WorkerArg*)v;
+    ContextParallelRunner* r = arg->runner;
+    size_t depth = r->queue.size();
+    uint64 pos = 0;
+
+    pthread_mutex_lock(&r->queueLock);
+    while (true)
+    {
+        while (pos == r->produced && !r->readDone)
+        {
+            pthread_cond_wait(&r->taskReady, &r->queueLock);
+        }
+        if (pos == r->produced) break;
+
+        uint64 end = min(r->produced, pos + CONTEXT_PARALLEL_QUEUE_BATCH);
+        pthread_mutex_unlock(&r->queueLock);
+
+        for (uint64 p = pos; p < end; p++)
+        {
+            QueueSlot& slot = r->queue[p % depth];
+            if (slot.work->thread != arg->thread) continue;
+            slot.work->backend->updateBackend(&slot.task);
+        }
+
+        pthread_mutex_lock(&r->queueLock);
+        bool freed = false;
+        for (; pos < end; pos++)
+        {
+            if (--r->queue[pos % depth].pending == 0) freed = true;
+        }
+        if (freed) pthread_cond_signal(&r->slotFree);
+    }
+    pthread_mutex_unlock(&r->queueLock);
+
+    return NULL;
+}
+
+void ContextParallelRunner::completeRun(FILE* f)
+{
+    backend->completeBackend(f, tg->getTaskGraphInfo());
+    fflush(f);
+}
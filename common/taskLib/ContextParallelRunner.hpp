@@ -0,0 +1,87 @@
+#ifndef CONTECH_CONTEXT_PARALLEL_RUNNER_HPP
+#define CONTECH_CONTEXT_PARALLEL_RUNNER_HPP
+
+#include "Backend.hpp"
+#include "TaskGraph.hpp"
+#include <vector>
+#include <pthread.h>
+
+// Tasks read ahead of the threads, and the tasks a thread takes from the queue together
+#define CONTEXT_PARALLEL_QUEUE_DEPTH 1024
+#define CONTEXT_PARALLEL_QUEUE_BATCH 64
+
+namespace contech
+{
+
+//
+// Runs a backend over the contexts of a task graph in parallel
+//
+//   Backends that implement createContextBackend get a backend for each context.
+//   Each context belongs to one thread, which gives that context's tasks to its
+//   backend in sequence order.  Once every task is done, the context backends are
+//   merged into the backend in increasing ContextId order, so the results do not
+//   depend on the number of threads.  Other backends are run over every task in
+//   order, as SimpleBackendWrapper.
+//
+//   The tasks are read once in task order, rather than with a cursor for each
+//   context, as the tasks in a block are from many contexts.
+//
+class ContextParallelRunner
+{
+private:
+    struct ContextWork
+    {
+        ContextId ctx;
+        uint64 taskCount;
+        Backend* backend;
+        int thread;
+    };
+
+    // A task in the queue, pending is the number of threads yet to pass it
+    struct QueueSlot
+    {
+        Task task;
+        ContextWork* work;
+        size_t pending;
+        QueueSlot() : work(NULL), pending(0) {}
+    };
+
+    struct WorkerArg
+    {
+        ContextParallelRunner* runner;
+        int thread;
+    };
+
+    TaskGraph* tg;
+    Backend* backend;
+    int threadCount;
+
+    // In ContextId order
+    vector<ContextWork> work;
+
+    vector<QueueSlot> queue;
+    uint64 produced;
+    bool readDone;
+    pthread_mutex_t queueLock;
+    pthread_cond_t taskReady;
+    pthread_cond_t slotFree;
+
+    ContextWork* findWork(ContextId ctx);
+    void assignThreads(int n);
+    static void* contextWorker(void*);
+
+public:
+    ContextParallelRunner(const char*, Backend*);
+    ~ContextParallelRunner();
+
+    // Defaults to the number of processors, or CONTECH_BACKEND_THREADS
+    void setThreads(int n);
+
+    void initBackend();
+    void runBackend();
+    void completeRun(FILE*);
+};
+
+}
+
+#endif
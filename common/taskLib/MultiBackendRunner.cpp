@@ -0,0 +1,235 @@
+#include "MultiBackendRunner.hpp"
+#include <time.h>
+
+using namespace contech;
+
+static double getSeconds(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+MultiBackendRunner::MultiBackendRunner(const char* f)
+{
+    tg = TaskGraph::initFromFile(f);
+    assert(tg != NULL);
+    readSeconds = 0.0;
+    threaded = false;
+    produced = 0;
+    readDone = false;
+    pthread_mutex_init(&queueLock, NULL);
+    pthread_cond_init(&taskReady, NULL);
+    pthread_cond_init(&slotFree, NULL);
+}
+
+MultiBackendRunner::~MultiBackendRunner()
+{
+    delete tg;
+    pthread_mutex_destroy(&queueLock);
+    pthread_cond_destroy(&taskReady);
+    pthread_cond_destroy(&slotFree);
+}
+
+void MultiBackendRunner::addBackend(Backend* b, const char* name)
+{
+    BackendEntry be;
+
+    be.backend = b;
+    be.name = (name != NULL) ? name : "backend " + to_string(backends.size());
+    be.seconds = 0.0;
+    backends.push_back(be);
+}
+
+void MultiBackendRunner::setThreaded(bool t, size_t depth)
+{
+    assert(depth > 0);
+    threaded = t;
+    queue.resize(depth);
+}
+
+void MultiBackendRunner::initBackends()
+{
+    for (BackendEntry& be : backends)
+    {
+        be.backend->initBackend(tg->getTaskGraphInfo());
+    }
+}
+
+void MultiBackendRunner::runBackends()
+{
+    if (backends.empty()) return;
+
+    // A single backend gains nothing from a thread of its own
+    if (threaded && backends.size() > 1) runThreaded();
+    else runSerial();
+}
+
+//
+// Tasks are read into the queue, then each backend runs over all of them in turn
+//   Giving a backend several tasks at once keeps its state in the processor's caches
+//
+void MultiBackendRunner::runSerial()
+{
+    bool more = true;
+    
+    if (queue.empty()) queue.resize(MULTI_BACKEND_QUEUE_DEPTH);
+    while (more)
+    {
+        size_t count = 0;
+        double start = getSeconds(CLOCK_MONOTONIC);
+        
+        while (count < queue.size() && (more = tg->readNextInto(queue[count].task)))
+        {
+            count++;
+        }
+        
+        double now = getSeconds(CLOCK_MONOTONIC);
+        readSeconds += now - start;
+        for (BackendEntry& be : backends)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                be.backend->updateBackend(&queue[i].task);
+            }
+            start = getSeconds(CLOCK_MONOTONIC);
+            be.seconds += start - now;
+            now = start;
+        }
+    }
+}
+
+//
+// The reader fills the queue in order, waiting for a slot that every backend is done with
+//
+void MultiBackendRunner::runThreaded()
+{
+    vector<pthread_t> threads(backends.size());
+    vector<WorkerArg> args(backends.size());
+    size_t depth = queue.size();
+
+    produced = 0;
+    readDone = false;
+    for (size_t i = 0; i < backends.size(); i++)
+    {
+        args[i].runner = this;
+        args[i].index = i;
+        int r = pthread_create(&threads[i], NULL, backendWorker, &args[i]);
+        assert(r == 0);
+    }
+
+    double start = getSeconds(CLOCK_THREAD_CPUTIME_ID);
+    while (true)
+    {
+        QueueSlot& slot = queue[produced % depth];
+
+        pthread_mutex_lock(&queueLock);
+        while (slot.pending > 0)
+        {
+            pthread_cond_wait(&slotFree, &queueLock);
+        }
+        pthread_mutex_unlock(&queueLock);
+
+        // No backend reads a slot until it is produced
+        if (!tg->readNextInto(slot.task)) break;
+
+        pthread_mutex_lock(&queueLock);
+        slot.pending = backends.size();
+        produced++;
+        pthread_cond_broadcast(&taskReady);
+        pthread_mutex_unlock(&queueLock);
+    }
+    readSeconds += getSeconds(CLOCK_THREAD_CPUTIME_ID) - start;
+
+    pthread_mutex_lock(&queueLock);
+    readDone = true;
+    pthread_cond_broadcast(&taskReady);
+    pthread_mutex_unlock(&queueLock);
+
+    for (pthread_t& t : threads)
+    {
+        pthread_join(t, NULL);
+    }
+}
+
+//
+// Each backend walks the queue behind the reader, releasing its slots in batches
+//
+void* MultiBackendRunner::backendWorker(void* v)
+{
+    WorkerArg* arg = (WorkerArg*)v;
+    MultiBackendRunner* r = arg->runner;
+    BackendEntry& be = r->backends[arg->index];
+    size_t depth = r->queue.size();
+    uint64 pos = 0;
+    double start = getSeconds(CLOCK_THREAD_CPUTIME_ID);
+
+    pthread_mutex_lock(&r->queueLock);
+    while (true)
+    {
+        while (pos == r->produced && !r->readDone)
+        {
+            pthread_cond_wait(&r->taskReady, &r->queueLock);
+        }
+        if (pos == r->produced) break;
+
+        uint64 end = min(r->produced, pos + MULTI_BACKEND_QUEUE_BATCH);
+        pthread_mutex_unlock(&r->queueLock);
+
+        for (uint64 p = pos; p < end; p++)
+        {
+            be.backend->updateBackend(&r->queue[p % depth].task);
+        }
+
+        pthread_mutex_lock(&r->queueLock);
+        bool freed = false;
+        for (; pos < end; pos++)
+        {
+            if (--r->queue[pos % depth].pending == 0) freed = true;
+        }
+        if (freed) pthread_cond_signal(&r->slotFree);
+    }
+    pthread_mutex_unlock(&r->queueLock);
+
+    be.seconds += getSeconds(CLOCK_THREAD_CPUTIME_ID) - start;
+    return NULL;
+}
+
+void MultiBackendRunner::completeRun(FILE* f)
+{
+    for (BackendEntry& be : backends)
+    {
+        be.backend->completeBackend(f, tg->getTaskGraphInfo());
+    }
+    fflush(f);
+}
+
+size_t MultiBackendRunner::getBackendCount() const
+{
+    return backends.size();
+}
+
+double MultiBackendRunner::getBackendSeconds(size_t i) const
+{
+    return backends[i].seconds;
+}
+
+double MultiBackendRunner::getReadSeconds() const
+{
+    return readSeconds;
+}
+
+void MultiBackendRunner::printTimes(FILE* f)
+{
+    fprintf(f, "Reading tasks: %.3lf s\n", readSeconds);
+    for (BackendEntry& be : backends)
+    {
+        fprintf(f, "%s: %.3lf s\n", be.name.c_str(), be.seconds);
+    }
+    fflush(f);
+}
+
+TaskGraph* MultiBackendRunner::getTaskGraph()
+{
+    return tg;
+}
@@ -0,0 +1,94 @@
+#ifndef CONTECH_MULTI_BACKEND_RUNNER_HPP
+#define CONTECH_MULTI_BACKEND_RUNNER_HPP
+
+#include "Backend.hpp"
+#include "TaskGraph.hpp"
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+// Tasks read ahead of the backends, and the tasks a thread hands back to the reader together
+//   Without threads, each backend runs over the whole queue at once
+#define MULTI_BACKEND_QUEUE_DEPTH 8192
+#define MULTI_BACKEND_QUEUE_BATCH 64
+
+namespace contech
+{
+
+//
+// Runs any number of backends over a single pass of a task graph
+//
+//   Each task is read once and given to every backend, in the order they were
+//   added.  With threads, each backend runs on its own thread and the reader
+//   fills a bounded queue of tasks that all of the backends share, so backends
+//   must not modify their tasks.  A task is only valid during updateBackend.
+//
+//   The time in each backend's updateBackend is recorded, as elapsed time when
+//   they run on the reader's thread, or as the CPU time of their thread.
+//
+class MultiBackendRunner
+{
+private:
+    struct BackendEntry
+    {
+        Backend* backend;
+        string name;
+        double seconds;
+    };
+
+    // A shared task, pending is the number of backends yet to finish with it
+    struct QueueSlot
+    {
+        Task task;
+        size_t pending;
+        QueueSlot() : pending(0) {}
+    };
+
+    struct WorkerArg
+    {
+        MultiBackendRunner* runner;
+        size_t index;
+    };
+
+    TaskGraph* tg;
+    vector<BackendEntry> backends;
+    double readSeconds;
+
+    bool threaded;
+    vector<QueueSlot> queue;
+    uint64 produced;    // tasks placed in the queue
+    bool readDone;
+    pthread_mutex_t queueLock;
+    pthread_cond_t taskReady;
+    pthread_cond_t slotFree;
+
+    void runSerial();
+    void runThreaded();
+    static void* backendWorker(void*);
+
+public:
+    MultiBackendRunner(const char*);
+    ~MultiBackendRunner();
+
+    // The runner does not own the backends, name defaults to its position
+    void addBackend(Backend* b, const char* name = NULL);
+    // Run each backend on its own thread, with a queue of depth tasks
+    void setThreaded(bool t, size_t depth = MULTI_BACKEND_QUEUE_DEPTH);
+
+    void initBackends();
+    void runBackends();
+    // Completes each backend in the order they were added
+    void completeRun(FILE*);
+
+    size_t getBackendCount() const;
+    // Seconds in updateBackend of the ith backend, and spent reading tasks
+    double getBackendSeconds(size_t i) const;
+    double getReadSeconds() const;
+    void printTimes(FILE*);
+
+    TaskGraph* getTaskGraph();
+};
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CT_SPAN_HPP
+#define CT_SPAN_HPP
+
+#include <stddef.h>
+#include <vector>
+
+namespace contech {
+
+//
+// A non-owning view of a contiguous range, such as a column of a decoded TaskBlock
+//
+//   Supports the read side of the vector interface, so loops over the vectors
+//   returned by a Task also work over the spans returned by a TaskView.
+//
+template <typename T>
+class Span
+{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    Span() : first(NULL), count(0) {}
+    Span(T* f, size_t n) : first(f), count(n) {}
+    Span(std::vector<T>& v) : first(v.data()), count(v.size()) {}
+
+    iterator begin() const { return first; }
+    iterator end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* data() const { return first; }
+    T& operator[](size_t i) const { return first[i]; }
+    T& front() const { return first[0]; }
+    T& back() const { return first[count - 1]; }
+
+private:
+    T* first;
+    size_t count;
+};
+
+}
+
+#endif
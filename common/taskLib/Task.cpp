@@ -22,12 +22,78 @@ Task::Task(TaskId taskId, task_type type)
     p.clear();
 }
 
+// Copies of a task own their actions as a flat list
+Task::Task(const Task& rhs)
+{
+    *this = rhs;
+}
+
+Task& Task::operator=(const Task& rhs)
+{
+    if (this == &rhs) return *this;
+    
+    releaseSegments();
+    taskId = rhs.taskId;
+    startTime = rhs.startTime;
+    endTime = rhs.endTime;
+    a = rhs.a;
+    for (const ActionSegment& seg : rhs.segs)
+    {
+        a.insert(a.end(), seg.actions, seg.actions + seg.used);
+    }
+    arena = NULL;
+    s = rhs.s;
+    p = rhs.p;
+    type = rhs.type;
+    syncType = rhs.syncType;
+    bbCount = rhs.bbCount;
+    actionsDropped = rhs.actionsDropped;
+    droppedMemOps = rhs.droppedMemOps;
+    sequenceId = rhs.sequenceId;
+    
+    return *this;
+}
+
+Task::~Task()
+{
+    releaseSegments();
+}
+
+void Task::swap(Task& rhs)
+{
+    std::swap(taskId, rhs.taskId);
+    std::swap(startTime, rhs.startTime);
+    std::swap(endTime, rhs.endTime);
+    a.swap(rhs.a);
+    std::swap(arena, rhs.arena);
+    segs.swap(rhs.segs);
+    s.swap(rhs.s);
+    p.swap(rhs.p);
+    std::swap(type, rhs.type);
+    std::swap(syncType, rhs.syncType);
+    std::swap(bbCount, rhs.bbCount);
+    std::swap(actionsDropped, rhs.actionsDropped);
+    std::swap(droppedMemOps, rhs.droppedMemOps);
+    std::swap(sequenceId, rhs.sequenceId);
+}
+
 bool Task::operator==(const Task& rhs) const
 {
+    bool sameActions;
+    
+    if (segs.empty() && rhs.segs.empty())
+    {
+        sameActions = (a == rhs.a);
+    }
+    else
+    {
+        sameActions = (Task(*this).a == Task(rhs).a);
+    }
+    
     return  taskId == rhs.taskId &&
             startTime == rhs.startTime &&
             endTime == rhs.endTime &&
-            a == rhs.a &&
+            sameActions &&
             s == rhs.s &&
             p == rhs.p &&
             type == rhs.type;
@@ -54,8 +120,13 @@ void Task::appendTask(Task* app, vector<Task*>* app_t)
     // Tasks are the same type and this is pred to app
     assert(type == app->type &&
            (find(app->p.begin(), app->p.end(), taskId) != app->p.end()));
+    flattenActions();
+    app->flattenActions();
     a.insert(a.end(), app->a.begin(), app->a.end());
+    sequenceId = 0;
     bbCount += app->bbCount;
+    actionsDropped |= app->actionsDropped;
+    droppedMemOps += app->droppedMemOps;
     s = app->s;
     
     // Now s.p = this
@@ -70,6 +141,28 @@ void Task::appendTask(Task* app, vector<Task*>* app_t)
     }
 }
 
+void Task::mergeTask(const Task& next)
+{
+    assert(getContextId() == next.getContextId() && next.startTime >= startTime);
+    assert(type == task_type_basic_blocks && next.type == task_type_basic_blocks);
+    flattenActions();
+    a.insert(a.end(), next.a.begin(), next.a.end());
+    for (const ActionSegment& seg : next.segs)
+    {
+        a.insert(a.end(), seg.actions, seg.actions + seg.used);
+    }
+    sequenceId = 0;
+    bbCount += next.bbCount;
+    actionsDropped |= next.actionsDropped;
+    droppedMemOps += next.droppedMemOps;
+    endTime = next.endTime;
+    s.erase(std::remove(s.begin(), s.end(), next.taskId), s.end());
+    for (TaskId succ : next.s)
+    {
+        if (find(s.begin(), s.end(), succ) == s.end()) s.push_back(succ);
+    }
+}
+
 // Remove rem from the task graph
 //   p must contain the Task for all of rem->p
 //   s must contain the Task for all of rem->s
@@ -138,6 +231,154 @@ bool Task::removeTask(Task* rem, vector<Task*>* p, vector<Task*>* s)
     return true;
 }
 
+//
+// Action storage
+//
+//   Actions are appended to a until, with an arena, a task would exceed a
+//   standard segment.  Further actions are appended to segments from the arena.
+//   Readers of the action list flatten the segments first.
+//
+void Task::setActionArena(ActionArena* ar)
+{
+    // Segments must come from the current arena
+    if (ar != arena) flattenActions();
+    arena = ar;
+}
+
+// Ensure the next n actions are contiguous
+void Task::reserveActions(uint n)
+{
+    if (arena == NULL || (segs.empty() && a.size() + n <= ACTION_SEGMENT_SIZE)) return;
+    
+    if (segs.empty() || segs.back().capacity - segs.back().used < n)
+    {
+        segs.push_back(arena->allocSegment(n));
+    }
+}
+
+// Returns space for n actions, which are contiguous
+Action* Task::appendActions(uint n)
+{
+    sequenceId = 0;
+    reserveActions(n);
+    if (segs.empty())
+    {
+        a.resize(a.size() + n);
+        return a.data() + a.size() - n;
+    }
+    
+    ActionSegment& seg = segs.back();
+    Action* r = seg.actions + seg.used;
+    seg.used += n;
+    
+    return r;
+}
+
+uint Task::getActionCount() const
+{
+    uint count = a.size();
+    
+    for (const ActionSegment& seg : segs)
+    {
+        count += seg.used;
+    }
+    
+    return count;
+}
+
+void Task::flattenActions()
+{
+    if (segs.empty()) return;
+    
+    a.reserve(getActionCount());
+    for (ActionSegment& seg : segs)
+    {
+        a.insert(a.end(), seg.actions, seg.actions + seg.used);
+    }
+    releaseSegments();
+}
+
+void Task::releaseSegments()
+{
+    for (ActionSegment& seg : segs)
+    {
+        arena->freeSegment(seg);
+    }
+    segs.clear();
+}
+
+void Task::recordDroppedMemOps(uint n)
+{
+    actionsDropped = true;
+    droppedMemOps += n;
+}
+
+void Task::dropMemoryActions()
+{
+    flattenActions();
+    
+    auto keep = a.begin();
+    for (Action act : a)
+    {
+        if (act.isMemOp()) droppedMemOps++;
+        if (!act.isMemoryAction()) *keep++ = act;
+    }
+    a.erase(keep, a.end());
+    actionsDropped = true;
+    sequenceId = 0;
+}
+
+void Task::dropAllActions()
+{
+    droppedMemOps = getMemOpCount();
+    a.clear();
+    a.shrink_to_fit();
+    releaseSegments();
+    actionsDropped = true;
+    sequenceId = 0;
+}
+
+bool Task::hasDroppedActions() const { return actionsDropped; }
+
+uint64 Task::getMemOpCount()
+{
+    // Count in place, so the actions of a large task are not flattened
+    uint64 count = droppedMemOps;
+    
+    for (Action act : a)
+    {
+        if (act.isMemOp()) count++;
+    }
+    for (const ActionSegment& seg : segs)
+    {
+        for (uint32_t i = 0; i < seg.used; i++)
+        {
+            if (seg.actions[i].isMemOp()) count++;
+        }
+    }
+    
+    return count;
+}
+
+TaskAddressSummary Task::getAddressSummary() const
+{
+    TaskAddressSummary tas;
+    
+    tas.clear();
+    if (actionsDropped)
+    {
+        tas.setUnknown();
+        return tas;
+    }
+    tas.addActions(a.data(), a.data() + a.size());
+    for (const ActionSegment& seg : segs)
+    {
+        tas.addActions(seg.actions, seg.actions + seg.used);
+    }
+    
+    return tas;
+}
+
 // Record that a memop occurred in this task
 void Task::recordMemOpAction(bool is_write, short pow_size, uint64 addr)
 {
@@ -145,19 +386,20 @@ void Task::recordMemOpAction(bool is_write, short pow_size, uint64 addr)
     mem.type = is_write ? action_type_mem_write : action_type_mem_read;
     mem.pow_size = pow_size;
     mem.addr = addr;
-    this->a.push_back(mem);
+    *appendActions(1) = mem;
 }
 
 // Record that a malloc occurred in this task
 void Task::recordMallocAction(uint64 addr, uint64 size)
 {
     MemoryAction mem;
+    Action* act = appendActions(2);
     mem.type = action_type_malloc;
     mem.addr = addr;
-    this->a.push_back(mem);
+    act[0] = mem;
     mem.type = action_type_size;
     mem.addr = size;
-    this->a.push_back(mem);
+    act[1] = mem;
 }
 
 // Record that a free occurred in this task
@@ -166,20 +408,21 @@ void Task::recordFreeAction(uint64 addr)
     MemoryAction mem;
     mem.type = action_type_free;
     mem.addr = addr;
-    this->a.push_back(mem);
+    *appendActions(1) = mem;
 }
 
 void Task::recordMemCpyAction(uint64 size, uint64 dst, uint64 src)
 {
     MemoryAction mem;
+    Action* act = appendActions(3);
     mem.type = action_type_memcpy;
     mem.addr = dst;
-    this->a.push_back(mem);
+    act[0] = mem;
     mem.addr = src;
-    this->a.push_back(mem);
+    act[1] = mem;
     mem.type = action_type_size;
     mem.addr = size;
-    this->a.push_back(mem);
+    act[2] = mem;
 }
 
 // Record that a basic block occurred in this task
@@ -188,18 +431,18 @@ void Task::recordBasicBlockAction(uint id)
     BasicBlockAction bb;
     bb.type = action_type_basicBlock;
     bb.basic_block_id = id;
-    this->a.push_back(bb);
+    *appendActions(1) = bb;
     bbCount++;
 }
 
 // Get all the actions that occurred in this task
-vector<Action>& Task::getActions() { return a; }
+vector<Action>& Task::getActions() { flattenActions(); return a; }
 
 // Get all the memOps (reads/writes) that occurred in this task
-Task::memOpCollection Task::getMemOps() { return memOpCollection(a.begin(), a.end()); }
+Task::memOpCollection Task::getMemOps() { flattenActions(); return memOpCollection(a.data(), a.data() + a.size()); }
 
 Task::memOpCollection::memOpCollection(){}
-Task::memOpCollection::memOpCollection(vector<Action>::iterator f, vector<Action>::iterator e) : first(f), last(e)
+Task::memOpCollection::memOpCollection(Action* f, Action* e) : first(f), last(e)
 {
     // Skip until the first memOp
     while (first != last && !first->isMemOp()) first++;
@@ -214,10 +457,10 @@ uint Task::memOpCollection::size()
 }
 
 // Get all the memory actions that occurred in this task
-Task::memoryActionCollection Task::getMemoryActions() { return memoryActionCollection(a.begin(), a.end()); }
+Task::memoryActionCollection Task::getMemoryActions() { flattenActions(); return memoryActionCollection(a.data(), a.data() + a.size()); }
 
 Task::memoryActionCollection::memoryActionCollection(){}
-Task::memoryActionCollection::memoryActionCollection(vector<Action>::iterator f, vector<Action>::iterator e) : first(f), last(e)
+Task::memoryActionCollection::memoryActionCollection(Action* f, Action* e) : first(f), last(e)
 {
     // Skip until the first memory action
     while (first != last && !first->isMemoryAction()) first++;
@@ -232,10 +475,10 @@ uint Task::memoryActionCollection::size()
 }
 
 // Get all the basic block actions that occurred in this task
-Task::basicBlockActionCollection Task::getBasicBlockActions() { return basicBlockActionCollection(a.begin(), a.end()); }
+Task::basicBlockActionCollection Task::getBasicBlockActions() { flattenActions(); return basicBlockActionCollection(a.data(), a.data() + a.size()); }
 
 Task::basicBlockActionCollection::basicBlockActionCollection(){}
-Task::basicBlockActionCollection::basicBlockActionCollection(vector<Action>::iterator f, vector<Action>::iterator e) : first(f), last(e)
+Task::basicBlockActionCollection::basicBlockActionCollection(Action* f, Action* e) : first(f), last(e)
 {
     // Skip until the first basic block action
     while (first != last && !first->isBasicBlockAction() ) first++;
@@ -284,24 +527,31 @@ void Task::setSyncType(sync_type e) { syncType = e; }
 // Deserialize a Task from a file
 Task* Task::readContechTaskUnlock(FILE* in)
 {
-    Task* task = new Task();
-        
     // Read in record length
     uint64 recordLength;
     ct_read(&recordLength, sizeof(uint64), in);
     uint64 compLength;
     ct_read(&compLength, sizeof(uint64), in);
 
-    if (feof(in) != 0) { delete task; return NULL;}
+    if (feof(in) != 0) { return NULL;}
     
     unsigned char* comp = (unsigned char*) malloc(compLength);
-    
-    uint64 uncompPos = 0;
-    
     assert(comp != NULL);
     
     ct_read(comp, compLength, in);
     
+    Task* task = decompressContechTask(comp, recordLength, compLength);
+    free(comp);
+    
+    return task;
+}
+
+// Deserialize a Task from a compressed record, such as one mapped from a file
+Task* Task::decompressContechTask(const unsigned char* comp, uint64 recordLength, uint64 compLength)
+{
+    Task* task = new Task();
+    uint64 uncompPos = 0;
+    
     unsigned char* uncomp = (unsigned char*) malloc(recordLength);
     assert(uncomp != NULL);
     uncompress(uncomp, (uLongf*)&recordLength, comp, compLength);
@@ -378,6 +628,18 @@ Task* Task::readContechTaskUnlock(FILE* in)
     uncompPos += sizeof(sync_type);
     task->syncType = (sync_type)typeIntSync;
     
+    // Tasks with dropped actions have their counts appended
+    if (uncompPos < recordLength)
+    {
+        uint32_t bbCountAll;
+        memcpy(&task->droppedMemOps, uncomp + uncompPos, sizeof(uint64));
+        uncompPos += sizeof(uint64);
+        memcpy(&bbCountAll, uncomp + uncompPos, sizeof(uint32_t));
+        uncompPos += sizeof(uint32_t);
+        task->bbCount = bbCountAll;
+        task->actionsDropped = true;
+    }
+    
     // uint64 fileOffset;
     //ct_read(&fileOffset,sizeof(uint64),in);
     // memcpy(&typeIntSync, uncomp + uncompPos, sizeof(sync_type));
@@ -388,20 +650,42 @@ Task* Task::readContechTaskUnlock(FILE* in)
     //assert(task->bbCount > 0 || task->type != task_type_basic_blocks);
     
     free(uncomp);
-    free(comp);
     
     return task;
 }
 
 // Serialize a Task to a file
 size_t Task::writeContechTask(Task& task, FILE* out)
+{
+    uint64 recordLength = 0, compLength = 0;
+    unsigned char* comp = compressContechTask(task, recordLength, compLength);
+    size_t r = writeCompressedContechTask(comp, recordLength, compLength, out);
+    
+    free(comp);
+    
+    return r;
+}
+
+size_t Task::writeCompressedContechTask(unsigned char* comp, uint64 recordLength, uint64 compLength, FILE* out)
+{
+    ct_write(&recordLength, sizeof(recordLength), out);
+    ct_write(&compLength, sizeof(compLength), out);
+    ct_write(comp, compLength, out);
+    
+    //account for the recordLength itself with the addition
+    return recordLength + sizeof(recordLength) + sizeof(compLength);
+}
+
+// Serialize a Task into a compressed buffer
+//   Only reads the task, so separate tasks can be compressed concurrently
+unsigned char* Task::compressContechTask(Task& task, uint64& recordLength, uint64& compLength)
 {
     // Calculate record length
-    uint asize = task.a.size();
+    uint asize = task.getActionCount();
     uint ssize = task.s.size();
     uint psize = task.p.size();
 
-    uint64 recordLength =
+    recordLength =
         // Unique ID
         sizeof(TaskId) +
         // Start Time
@@ -423,7 +707,9 @@ size_t Task::writeContechTask(Task& task, FILE* out)
         // Type
         sizeof(task_type) +
         // Sync Type
-        sizeof(sync_type);
+        sizeof(sync_type) +
+        // Dropped memop count and basic block count, only if actions were dropped
+        ((task.actionsDropped) ? sizeof(uint64) + sizeof(uint32_t) : 0);
 
     // No task larger than 2GB
     assert(recordLength < ((unsigned long long)2 * 1024 * 1024 * 1024));
@@ -465,11 +751,14 @@ size_t Task::writeContechTask(Task& task, FILE* out)
     memcpy(src + srcPos, &asize, sizeof(uint));
     srcPos += sizeof(uint);
     // action list
-    for (Action a : task.a)
+    //   Stream from any segments after the flat actions
+    static_assert(sizeof(Action) == sizeof(uint64), "Actions are serialized as 64 bit values");
+    memcpy(src + srcPos, task.a.data(), task.a.size() * sizeof(uint64));
+    srcPos += task.a.size() * sizeof(uint64);
+    for (const ActionSegment& seg : task.segs)
     {
-        //ct_write(&a.data, sizeof(uint64), out);
-        memcpy(src + srcPos, &a.data, sizeof(uint64));
-        srcPos += sizeof(uint64);
+        memcpy(src + srcPos, seg.actions, seg.used * sizeof(uint64));
+        srcPos += seg.used * sizeof(uint64);
     }
 
     // Size of s list
@@ -504,6 +793,15 @@ size_t Task::writeContechTask(Task& task, FILE* out)
     memcpy(src + srcPos, &task.syncType, sizeof(sync_type));
     srcPos += sizeof(sync_type);
     
+    if (task.actionsDropped)
+    {
+        uint32_t bbCountAll = task.bbCount;
+        memcpy(src + srcPos, &task.droppedMemOps, sizeof(uint64));
+        srcPos += sizeof(uint64);
+        memcpy(src + srcPos, &bbCountAll, sizeof(uint32_t));
+        srcPos += sizeof(uint32_t);
+    }
+    
     //File offset
     //ct_write(&task.fileOffset,sizeof(uint64),out);
     //memcpy(src + srcPos, &task.fileOffset, sizeof(uint64));
@@ -511,16 +809,12 @@ size_t Task::writeContechTask(Task& task, FILE* out)
     
     uint64 dstLen = recordLength + 12;
     compress(dst, (uLongf*)&dstLen, src, recordLength);
-    ct_write(&recordLength, sizeof(recordLength), out);
-    ct_write(&dstLen, sizeof(dstLen), out);
-    ct_write(dst, dstLen, out);
     //printf("%u, %lu, %f\n", recordLength, dstLen, ((float)dstLen )/ ((float)recordLength));
     
-    free(dst);
     free(src);
     
-    //account for the recordLength itself with the addition
-    return recordLength + sizeof(recordLength) + sizeof(dstLen);
+    compLength = dstLen;
+    return dst;
 }
 
 /*
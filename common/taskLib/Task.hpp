@@ -3,6 +3,8 @@
 
 #include "TaskId.hpp"
 #include "Action.hpp"
+#include "ActionArena.hpp"
+#include "TaskAddressSummary.hpp"
 #include "ct_file.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,12 +33,15 @@ enum sync_type {
     sync_type_task_dependency};
 
 class TaskGraph;
+class TaskBlock;
 
 class Task
 {
 friend class TaskGraph;
+friend class TaskBlock;
 protected:
     static Task* readContechTaskUnlock(FILE* in);
+    static Task* decompressContechTask(const unsigned char* comp, uint64 recordLength, uint64 compLength);
 
 private:
 
@@ -46,6 +51,9 @@ private:
 
     // Internal list of actions (memOp's, mallocs, frees, and basic blocks)
     vector<Action> a;
+    // Actions recorded into segments from an arena once a task outgrows a, these follow a
+    ActionArena* arena = NULL;
+    vector<ActionSegment> segs;
     // Internal list of successor tasks
     vector<TaskId> s;
     // Internal list of predecessor tasks
@@ -60,12 +68,29 @@ private:
 
     int bbCount;
     
+    // Set when some actions were not recorded, e.g., basic block only task graphs
+    //   droppedMemOps counts the memops that are not in the action list
+    bool actionsDropped = false;
+    uint64 droppedMemOps = 0;
+    
+    // Id of the task's basic block sequence in its graph, see BasicBlockSequences
+    uint32_t sequenceId = 0;
+    
+    Action* appendActions(uint n);
+    void flattenActions();
+    void releaseSegments();
+    
 public:
 
     // Default constructor
     Task();
     // Constructs a task with the given taskId and start time
     Task(TaskId taskId, task_type type);
+    Task(const Task& rhs);
+    Task& operator=(const Task& rhs);
+    ~Task();
+    // Exchange the contents of two tasks without copying their actions
+    void swap(Task& rhs);
 
     // Compares the contents of two tasks
     bool operator==(const Task& rhs) const;
@@ -87,6 +112,25 @@ public:
     void recordFreeAction(uint64 addr);
     void recordMemCpyAction(uint64 size, uint64 dst, uint64 src);
     void recordBasicBlockAction(uint id);
+    
+    // Record subsequent actions into segments from the arena, which must outlive the task
+    void setActionArena(ActionArena* arena);
+    // Ensure the next n actions are recorded contiguously
+    void reserveActions(uint n);
+    uint getActionCount() const;
+    
+    // Count memops without recording them, for tasks that only keep basic blocks
+    void recordDroppedMemOps(uint n);
+    // Remove the memory actions (memops, mallocs, frees, memcpys), keeping the memop count
+    void dropMemoryActions();
+    // Remove every action, keeping the basic block and memop counts
+    void dropAllActions();
+    // Is the action list missing actions that this task performed?
+    bool hasDroppedActions() const;
+    // Number of memops performed, including any that were dropped
+    uint64 getMemOpCount();
+    // The addresses of the memops and memcpys, every address if actions were dropped
+    TaskAddressSummary getAddressSummary() const;
 
     // List of all successors to this task.
     vector<TaskId>& getSuccessorTasks();
@@ -97,6 +141,11 @@ public:
 
     int getBBCount() const {return bbCount;}
     
+    // Tasks read from a graph with the same nonzero id run the same basic blocks,
+    //   with the same number of memory actions after each.  0 when the task has no
+    //   sequence, or once its actions are changed.
+    uint32_t getSequenceId() const {return sequenceId;}
+    
     task_type getType() const;
     void setType(task_type e);
     
@@ -110,10 +159,20 @@ public:
     string toSummaryString() const;
 
     void appendTask(Task*, vector<Task*>*);
+    // Merge a later basic block task of this context into this one
+    //   Its actions follow this task's, and this task takes its end time.  The
+    //   successors are this task's, other than next, then those of next.
+    void mergeTask(const Task& next);
     static bool removeTask(Task* rem, vector<Task*>* p, vector<Task*>* s);
     
     //returns the record size written
     static size_t writeContechTask(Task& task, FILE* out);
+    
+    // Serialize and compress a task without writing it, so that the compression can
+    //   be done by any thread.  Returns a malloc'd buffer of compLength bytes.
+    static unsigned char* compressContechTask(Task& task, uint64& recordLength, uint64& compLength);
+    //returns the record size written, does not free the buffer
+    static size_t writeCompressedContechTask(unsigned char* comp, uint64 recordLength, uint64 compLength, FILE* out);
 
     // Wraps the internal list of actions, presenting it as an iterable collection of only memory reads and writes
     // Internally, we skip past actions that we don't care about on increment
@@ -128,7 +187,7 @@ public:
                     typedef iterator self_type;
                     typedef Action value_type;
                     typedef Action& reference;
-                    typedef vector<Action>::iterator pointer;
+                    typedef Action* pointer;
                     typedef std::forward_iterator_tag iterator_category;
                     typedef int difference_type;
 
@@ -158,11 +217,11 @@ public:
             uint size();
 
             memOpCollection();
-            memOpCollection(vector<Action>::iterator f, vector<Action>::iterator e);
+            memOpCollection(Action* f, Action* e);
 
         private:
-            vector<Action>::iterator first;
-            vector<Action>::iterator last;
+            Action* first;
+            Action* last;
 
     };
 
@@ -179,7 +238,7 @@ public:
                     typedef iterator self_type;
                     typedef Action value_type;
                     typedef Action& reference;
-                    typedef vector<Action>::iterator pointer;
+                    typedef Action* pointer;
                     typedef std::forward_iterator_tag iterator_category;
                     typedef int difference_type;
 
@@ -209,11 +268,11 @@ public:
             uint size();
 
             memoryActionCollection();
-            memoryActionCollection(vector<Action>::iterator f, vector<Action>::iterator e);
+            memoryActionCollection(Action* f, Action* e);
 
         private:
-            vector<Action>::iterator first;
-            vector<Action>::iterator last;
+            Action* first;
+            Action* last;
 
     };
 
@@ -231,7 +290,7 @@ public:
                     typedef iterator self_type;
                     typedef Action value_type;
                     typedef Action& reference;
-                    typedef vector<Action>::iterator pointer;
+                    typedef Action* pointer;
                     typedef std::forward_iterator_tag iterator_category;
                     typedef int difference_type;
 
@@ -271,12 +330,12 @@ public:
             uint size();
 
             basicBlockActionCollection();
-            basicBlockActionCollection(vector<Action>::iterator f, vector<Action>::iterator e);
+            basicBlockActionCollection(Action* f, Action* e);
 
 
         private:
-            vector<Action>::iterator first;
-            vector<Action>::iterator last;
+            Action* first;
+            Action* last;
 
     };
 
@@ -0,0 +1,127 @@
+#include "TaskAddressSummary.hpp"
+#include <string.h>
+
+using namespace contech;
+
+// Each line sets 2 bits of a filter
+#define FILTER_BITS (TASK_ADDRESS_FILTER_WORDS * 64)
+
+static inline void setLine(uint64_t* filter, uint64_t line)
+{
+    uint64_t h = line * 0x9E3779B97F4A7C15ULL;
+    uint32_t a = (h >> 32) % FILTER_BITS;
+    uint32_t b = (h >> 48) % FILTER_BITS;
+
+    filter[a / 64] |= 1ULL << (a % 64);
+    filter[b / 64] |= 1ULL << (b % 64);
+}
+
+static inline bool filtersIntersect(const uint64_t* a, const uint64_t* b)
+{
+    for (int i = 0; i < TASK_ADDRESS_FILTER_WORDS; i++)
+    {
+        if ((a[i] & b[i]) != 0) return true;
+    }
+    return false;
+}
+
+void TaskAddressSummary::clear()
+{
+    memset(this, 0, sizeof(*this));
+    minAddress = ~0ULL;
+    maxAddress = 0;
+}
+
+void TaskAddressSummary::setUnknown()
+{
+    minAddress = 0;
+    maxAddress = ~0ULL;
+    memset(accessFilter, 0xff, sizeof(accessFilter));
+    memset(writeFilter, 0xff, sizeof(writeFilter));
+}
+
+void TaskAddressSummary::addAccess(uint64_t addr, uint64_t size, bool write)
+{
+    if (size == 0) return;
+
+    uint64_t last = addr + size - 1;
+    if (last < addr) last = ~0ULL;
+    if (addr < minAddress) minAddress = addr;
+    if (last > maxAddress) maxAddress = last;
+
+    // Large accesses set every bit, rather than every line
+    uint64_t first = addr >> TASK_ADDRESS_LINE_BITS;
+    uint64_t end = last >> TASK_ADDRESS_LINE_BITS;
+    if (end - first >= FILTER_BITS)
+    {
+        memset(accessFilter, 0xff, sizeof(accessFilter));
+        if (write) memset(writeFilter, 0xff, sizeof(writeFilter));
+        return;
+    }
+    for (uint64_t line = first; ; line++)
+    {
+        setLine(accessFilter, line);
+        if (write) setLine(writeFilter, line);
+        if (line == end) break;
+    }
+}
+
+void TaskAddressSummary::addActions(const Action* first, const Action* last)
+{
+    for (const Action* act = first; act != last; ++act)
+    {
+        MemoryAction mem = *act;
+
+        switch (act->getType())
+        {
+            case action_type_mem_read:
+            case action_type_mem_write:
+                addAccess(mem.addr, 1ULL << mem.pow_size, act->getType() == action_type_mem_write);
+                break;
+
+            case action_type_memcpy:
+            {
+                // The destination, then the source and the size
+                if (last - act < 3)
+                {
+                    setUnknown();
+                    return;
+                }
+                MemoryAction src = act[1];
+                MemoryAction size = act[2];
+                addAccess(mem.addr, size.addr, true);
+                addAccess(src.addr, size.addr, false);
+                act += 2;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+bool TaskAddressSummary::isEmpty() const
+{
+    return minAddress > maxAddress;
+}
+
+bool TaskAddressSummary::mayShare(const TaskAddressSummary& other) const
+{
+    if (isEmpty() || other.isEmpty()) return false;
+    if ((maxAddress >> TASK_ADDRESS_LINE_BITS) < (other.minAddress >> TASK_ADDRESS_LINE_BITS) ||
+        (other.maxAddress >> TASK_ADDRESS_LINE_BITS) < (minAddress >> TASK_ADDRESS_LINE_BITS))
+    {
+        return false;
+    }
+
+    return filtersIntersect(accessFilter, other.accessFilter);
+}
+
+bool TaskAddressSummary::mayConflict(const TaskAddressSummary& other) const
+{
+    if (!mayShare(other)) return false;
+
+    return filtersIntersect(writeFilter, other.accessFilter) ||
+           filtersIntersect(accessFilter, other.writeFilter);
+}
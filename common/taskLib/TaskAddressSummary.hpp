@@ -0,0 +1,50 @@
+#ifndef CONTECH_TASK_ADDRESS_SUMMARY_HPP
+#define CONTECH_TASK_ADDRESS_SUMMARY_HPP
+
+#include "Action.hpp"
+#include <stdint.h>
+
+// Cache lines of 2^6 bytes, and the 64 bit words of each filter
+#define TASK_ADDRESS_LINE_BITS 6
+#define TASK_ADDRESS_FILTER_WORDS 2
+
+namespace contech
+{
+
+//
+// A conservative summary of the addresses that a task reads and writes
+//
+//   The range covers every byte of the task's memops and memcpys, and the filters
+//   are bloom filters of the cache lines that are accessed, and the lines that are
+//   written.  If two summaries cannot share a line, then neither can the tasks,
+//   so analyses can skip the pair without reading their actions.  Mallocs and
+//   frees are not accesses.  A task whose memory actions were dropped could
+//   access any address.
+//
+//   The summary is fixed size, so graphs store one for each task in task order.
+//
+struct TaskAddressSummary
+{
+    uint64_t minAddress;    // first and last byte accessed, min > max when empty
+    uint64_t maxAddress;
+    uint64_t accessFilter[TASK_ADDRESS_FILTER_WORDS];
+    uint64_t writeFilter[TASK_ADDRESS_FILTER_WORDS];
+
+    // No addresses, or every address
+    void clear();
+    void setUnknown();
+
+    void addAccess(uint64_t addr, uint64_t size, bool write);
+    // The memops and memcpys of a run of a task's actions, each memcpy is contiguous
+    void addActions(const Action* first, const Action* last);
+
+    bool isEmpty() const;
+    // Could the tasks access a common cache line
+    bool mayShare(const TaskAddressSummary& other) const;
+    // Could they access a common line that either one writes
+    bool mayConflict(const TaskAddressSummary& other) const;
+};
+
+}
+
+#endif
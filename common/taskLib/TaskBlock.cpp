@@ -0,0 +1,617 @@
+#include "TaskBlock.hpp"
+#include <string.h>
+#include <zlib.h>
+#include <unordered_map>
+
+using namespace std;
+using namespace contech;
+
+static_assert(sizeof(TaskBlockEntry) == 64, "TaskBlockEntry is stored directly in task graphs");
+static_assert(sizeof(Action) == sizeof(uint64), "Actions are stored as their raw bits");
+
+// Task count, flags, then the action, successor and predecessor counts
+#define TASK_BLOCK_HEADER_SIZE (2 * sizeof(uint32_t) + 3 * sizeof(uint64))
+
+TaskBlock::TaskBlock()
+{
+}
+
+uint32_t TaskBlock::addTask(Task& t, BasicBlockSequences* sequences)
+{
+    TaskBlockEntry e;
+    uint32_t slot = entries.size();
+
+    e.taskId = (uint64)t.taskId;
+    e.startTime = t.startTime;
+    e.endTime = t.endTime;
+    e.droppedMemOps = t.droppedMemOps;
+    e.asize = t.getActionCount();
+    e.ssize = t.s.size();
+    e.psize = t.p.size();
+    e.bbCount = t.bbCount;
+    e.type = t.type;
+    e.syncType = t.syncType;
+    e.flags = (t.actionsDropped) ? TASK_BLOCK_ACTIONS_DROPPED : 0;
+    e.sequenceId = 0;
+    entries.push_back(e);
+    actionStart.push_back(actions.size());
+    succStart.push_back(succ.size());
+    predStart.push_back(pred.size());
+
+    // Stream the actions from any segments after the flat actions
+    for (Action act : t.a)
+    {
+        actions.push_back(act);
+    }
+    for (const ActionSegment& seg : t.segs)
+    {
+        for (uint32_t i = 0; i < seg.used; i++)
+        {
+            actions.push_back(seg.actions[i]);
+        }
+    }
+    succ.insert(succ.end(), t.s.begin(), t.s.end());
+    pred.insert(pred.end(), t.p.begin(), t.p.end());
+
+    if (sequences != NULL)
+    {
+        t.sequenceId = sequences->addSequence(actions.data() + actionStart[slot], e.asize);
+        entries[slot].sequenceId = t.sequenceId;
+    }
+
+    return slot;
+}
+
+uint32_t TaskBlock::getTaskCount() const
+{
+    return entries.size();
+}
+
+size_t TaskBlock::getByteSize() const
+{
+    return TASK_BLOCK_HEADER_SIZE +
+           entries.size() * sizeof(TaskBlockEntry) +
+           actions.size() * sizeof(Action) +
+           (succ.size() + pred.size()) * sizeof(TaskId);
+}
+
+bool TaskBlock::isFull() const
+{
+    return getByteSize() >= TASK_BLOCK_TARGET_SIZE;
+}
+
+void TaskBlock::clear()
+{
+    entries.clear();
+    actions.clear();
+    succ.clear();
+    pred.clear();
+    actionStart.clear();
+    succStart.clear();
+    predStart.clear();
+}
+
+//
+// Encoding of the action column
+//
+//   Each action starts with a tag byte, with the action type in the low 3 bits.
+//   A basic block is followed by a varint of its id, then a varint of its reserved
+//   bits if the tag has TASK_ACTION_EXTRA, as they differ from the context's
+//   previous basic block.  Every other action is delta coded
+//   against the previous action in the same op slot, which is its position after
+//   the latest basic block action with that id in the task's context.  In loops,
+//   the op at a slot usually moves by a small stride.  If its upper 16 bits differ
+//   from that action, the tag has TASK_ACTION_EXTRA and they follow in 2 bytes.
+//   Then comes a zigzag varint of the difference in the low 48 bits.
+//
+#define TASK_ACTION_EXTRA 0x8
+#define TASK_ACTION_ADDR_MASK ((1ULL << 48) - 1)
+// Blocks whose encoded actions are larger than this percent of the raw actions keep them raw
+#define TASK_ACTION_ENCODE_PERCENT 70
+// Basic block ids beyond this share one set of op slots
+#define TASK_ACTION_MAX_SLOT_BB (1 << 20)
+
+namespace {
+
+class ActionSlots
+{
+public:
+    ActionSlots() : cur(&loose), slot(0), basicBlockRest(0) {}
+
+    void startBasicBlock(uint32_t id)
+    {
+        cur = (id < TASK_ACTION_MAX_SLOT_BB) ? &perBasicBlock[id] : &loose;
+        slot = 0;
+    }
+
+    // The previous action at the next slot
+    uint64& nextSlot()
+    {
+        if (slot >= cur->size()) cur->resize(slot + 1, 0);
+        return (*cur)[slot++];
+    }
+
+private:
+    // Only the basic blocks the context runs in the block have slots
+    std::unordered_map<uint32_t, std::vector<uint64> > perBasicBlock;
+    std::vector<uint64> loose;
+    std::vector<uint64>* cur;
+    uint32_t slot;
+
+public:
+    // Reserved bits of the previous basic block action
+    uint64 basicBlockRest;
+};
+
+// The op slots of each context in a block
+//   Context ids carry the rank in their high bits, so only the contexts that the
+//   block has are kept, and a map keeps their slots in place as it grows
+class ContextSlots
+{
+public:
+    ActionSlots& get(uint32_t ctx)
+    {
+        return slots[ctx];
+    }
+
+private:
+    std::unordered_map<uint32_t, ActionSlots> slots;
+};
+
+inline void putVarint(std::vector<unsigned char>& out, uint64 v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+}
+
+// Returns false if the varint runs past end, or is longer than 64 bits
+inline bool getVarint(const unsigned char*& p, const unsigned char* end, uint64& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p >= end) return false;
+        unsigned char b = *p++;
+        v |= (uint64)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+inline uint64 getBasicBlockRest(uint64 w)
+{
+    return (w >> 32) & ((1ULL << 29) - 1);
+}
+
+// Decode a memory action after its tag, against the previous action in its slot
+//   Returns false if the action runs past end
+inline bool getMemoryAction(unsigned char tag, const unsigned char*& p, const unsigned char* end,
+                            ActionSlots& slots, uint64& w)
+{
+    uint64& prev = slots.nextSlot();
+    uint64 upper = prev >> 48;
+    if (tag & TASK_ACTION_EXTRA)
+    {
+        if (end - p < 2) return false;
+        upper = (uint64)p[0] | ((uint64)p[1] << 8);
+        p += 2;
+    }
+    uint64 z;
+    if (!getVarint(p, end, z)) return false;
+    uint64 delta = (z >> 1) ^ (0 - (z & 1));
+
+    prev = (upper << 48) | ((prev + delta) & TASK_ACTION_ADDR_MASK);
+    w = prev;
+    return true;
+}
+
+}
+
+void TaskBlock::encodeActions(std::vector<unsigned char>& out) const
+{
+    ContextSlots contextSlots;
+
+    out.reserve(actions.size() * 3);
+    for (uint32_t slot = 0; slot < entries.size(); slot++)
+    {
+        // Each task uses the slots of its context, from no basic block
+        const TaskBlockEntry& e = entries[slot];
+        ActionSlots& slots = contextSlots.get((uint32_t)TaskId(e.taskId).getContextId());
+        slots.startBasicBlock(TASK_ACTION_MAX_SLOT_BB);
+
+        const Action* act = actions.data() + actionStart[slot];
+        for (const Action* actEnd = act + e.asize; act != actEnd; ++act)
+        {
+            uint64 w = act->data;
+            unsigned char tag = (unsigned char)act->type;
+
+            if (act->type == action_type_basicBlock)
+            {
+                uint32_t id = (uint32_t)w;
+                uint64 rest = getBasicBlockRest(w);
+                bool extra = (rest != slots.basicBlockRest);
+                slots.startBasicBlock(id);
+                slots.basicBlockRest = rest;
+
+                // The basic blocks of a task with a sequence are in the dictionary
+                if (e.sequenceId != 0) continue;
+                out.push_back(extra ? (tag | TASK_ACTION_EXTRA) : tag);
+                putVarint(out, id);
+                if (extra) putVarint(out, rest);
+                continue;
+            }
+
+            uint64& prev = slots.nextSlot();
+            uint16_t upper = (uint16_t)(w >> 48);
+            int64_t delta = (int64_t)((w & TASK_ACTION_ADDR_MASK) - (prev & TASK_ACTION_ADDR_MASK));
+            bool extra = (upper != (uint16_t)(prev >> 48));
+
+            out.push_back(extra ? (tag | TASK_ACTION_EXTRA) : tag);
+            if (extra)
+            {
+                out.push_back((unsigned char)upper);
+                out.push_back((unsigned char)(upper >> 8));
+            }
+            putVarint(out, ((uint64)delta << 1) ^ (uint64)(delta >> 63));
+            prev = w;
+        }
+    }
+}
+
+//
+// Decode the whole action column in one pass
+//   Tasks with a sequence take their basic blocks from the dictionary
+//
+bool TaskBlock::decodeActions(const unsigned char* p, const unsigned char* end, uint64 actionCount,
+                              const BasicBlockSequences* sequences)
+{
+    ContextSlots contextSlots;
+
+    actions.resize(actionCount);
+    Action* dst = actions.data();
+    Action* dstEnd = dst + actionCount;
+    for (const TaskBlockEntry& e : entries)
+    {
+        ActionSlots& slots = contextSlots.get((uint32_t)TaskId(e.taskId).getContextId());
+        slots.startBasicBlock(TASK_ACTION_MAX_SLOT_BB);
+
+        if ((uint64)(dstEnd - dst) < e.asize) return false;
+        Action* taskEnd = dst + e.asize;
+
+        if (e.sequenceId != 0)
+        {
+            Span<const uint64> seq;
+            if (sequences != NULL) seq = sequences->getSequence(e.sequenceId);
+            if (seq.empty()) return false;
+
+            for (uint64 w : seq)
+            {
+                if ((w >> 61) == action_type_basicBlock)
+                {
+                    if (dst == taskEnd) return false;
+                    (dst++)->data = w;
+                    slots.startBasicBlock((uint32_t)w);
+                    slots.basicBlockRest = getBasicBlockRest(w);
+                    continue;
+                }
+
+                // A run of memory actions
+                if ((uint64)(taskEnd - dst) < w) return false;
+                for (uint64 n = 0; n < w; n++)
+                {
+                    if (p >= end) return false;
+                    unsigned char tag = *p++;
+                    if ((tag & 0x7) == action_type_basicBlock) return false;
+                    if (!getMemoryAction(tag, p, end, slots, (dst++)->data)) return false;
+                }
+            }
+            if (dst != taskEnd) return false;
+            continue;
+        }
+
+        while (dst != taskEnd)
+        {
+            if (p >= end) return false;
+            unsigned char tag = *p++;
+
+            if ((tag & 0x7) == action_type_basicBlock)
+            {
+                uint64 id, rest = slots.basicBlockRest;
+                if (!getVarint(p, end, id) || id > UINT32_MAX) return false;
+                if ((tag & TASK_ACTION_EXTRA) && (!getVarint(p, end, rest) || rest >= (1ULL << 29))) return false;
+                slots.basicBlockRest = rest;
+                (dst++)->data = ((uint64)action_type_basicBlock << 61) | (rest << 32) | (uint32_t)id;
+                slots.startBasicBlock((uint32_t)id);
+                continue;
+            }
+
+            if (!getMemoryAction(tag, p, end, slots, (dst++)->data)) return false;
+        }
+    }
+
+    return dst == dstEnd && p == end;
+}
+
+//
+// Expand raw actions, where tasks with a sequence only store their memory actions
+//
+bool TaskBlock::expandActions(const unsigned char* p, uint64 storedCount, uint64 actionCount,
+                              const BasicBlockSequences* sequences)
+{
+    const unsigned char* end = p + storedCount * sizeof(Action);
+
+    actions.resize(actionCount);
+    Action* dst = actions.data();
+    Action* dstEnd = dst + actionCount;
+    for (const TaskBlockEntry& e : entries)
+    {
+        if ((uint64)(dstEnd - dst) < e.asize) return false;
+        Action* taskEnd = dst + e.asize;
+
+        if (e.sequenceId == 0)
+        {
+            if ((uint64)(end - p) < e.asize * sizeof(Action)) return false;
+            memcpy((void*)dst, p, e.asize * sizeof(Action));
+            p += e.asize * sizeof(Action);
+            dst = taskEnd;
+            continue;
+        }
+
+        Span<const uint64> seq;
+        if (sequences != NULL) seq = sequences->getSequence(e.sequenceId);
+        if (seq.empty()) return false;
+
+        for (uint64 w : seq)
+        {
+            if ((w >> 61) == action_type_basicBlock)
+            {
+                if (dst == taskEnd) return false;
+                (dst++)->data = w;
+                continue;
+            }
+            if ((uint64)(taskEnd - dst) < w || (uint64)(end - p) < w * sizeof(Action)) return false;
+            memcpy((void*)dst, p, w * sizeof(Action));
+            p += w * sizeof(Action);
+            dst += w;
+        }
+        if (dst != taskEnd) return false;
+    }
+
+    return dst == dstEnd && p == end;
+}
+
+unsigned char* TaskBlock::compress(uint64& uncompLength, uint64& compLength) const
+{
+    uint32_t taskCount = entries.size(), flags = TASK_BLOCK_FLAG_ENCODED_ACTIONS;
+    uint64 actionCount = actions.size(), succCount = succ.size(), predCount = pred.size();
+    uint64 pos = 0;
+    std::vector<unsigned char> encoded;
+
+    // Without strided addresses, the encoding is left for zlib to undo and only
+    //   slows down reading, so store the raw actions instead
+    encodeActions(encoded);
+    uint64 storedCount = actionCount;
+    for (uint32_t slot = 0; slot < taskCount; slot++)
+    {
+        if (entries[slot].sequenceId == 0) continue;
+        const Action* act = actions.data() + actionStart[slot];
+        storedCount -= count_if(act, act + entries[slot].asize, [](Action a) { return a.isBasicBlockAction(); });
+    }
+    if (encoded.size() * 100 > storedCount * sizeof(Action) * TASK_ACTION_ENCODE_PERCENT)
+    {
+        flags = 0;
+        encoded.resize(storedCount * sizeof(Action));
+        Action* raw = (Action*)encoded.data();
+        for (uint32_t slot = 0; slot < taskCount; slot++)
+        {
+            const Action* act = actions.data() + actionStart[slot];
+            for (const Action* actEnd = act + entries[slot].asize; act != actEnd; ++act)
+            {
+                if (entries[slot].sequenceId != 0 && act->isBasicBlockAction()) continue;
+                *raw++ = *act;
+            }
+        }
+        assert(raw == (Action*)(encoded.data() + encoded.size()));
+    }
+    uncompLength = TASK_BLOCK_HEADER_SIZE +
+                   taskCount * sizeof(TaskBlockEntry) +
+                   encoded.size() +
+                   (succCount + predCount) * sizeof(TaskId);
+    unsigned char* src = (unsigned char*) malloc(uncompLength);
+    assert(src != NULL);
+
+    memcpy(src + pos, &taskCount, sizeof(uint32_t)); pos += sizeof(uint32_t);
+    memcpy(src + pos, &flags, sizeof(uint32_t)); pos += sizeof(uint32_t);
+    memcpy(src + pos, &actionCount, sizeof(uint64)); pos += sizeof(uint64);
+    memcpy(src + pos, &succCount, sizeof(uint64)); pos += sizeof(uint64);
+    memcpy(src + pos, &predCount, sizeof(uint64)); pos += sizeof(uint64);
+
+    // Columns
+    memcpy(src + pos, entries.data(), taskCount * sizeof(TaskBlockEntry));
+    pos += taskCount * sizeof(TaskBlockEntry);
+    memcpy(src + pos, encoded.data(), encoded.size());
+    pos += encoded.size();
+    memcpy(src + pos, succ.data(), succCount * sizeof(TaskId));
+    pos += succCount * sizeof(TaskId);
+    memcpy(src + pos, pred.data(), predCount * sizeof(TaskId));
+    pos += predCount * sizeof(TaskId);
+    assert(pos == uncompLength);
+
+    uLongf dstLen = compressBound(uncompLength);
+    unsigned char* dst = (unsigned char*) malloc(dstLen);
+    assert(dst != NULL);
+    int r = ::compress(dst, &dstLen, src, uncompLength);
+    assert(r == Z_OK);
+
+    free(src);
+
+    compLength = dstLen;
+    return dst;
+}
+
+size_t TaskBlock::writeCompressed(unsigned char* comp, uint64 uncompLength, uint64 compLength, FILE* out)
+{
+    ct_write(&uncompLength, sizeof(uncompLength), out);
+    ct_write(&compLength, sizeof(compLength), out);
+    ct_write(comp, compLength, out);
+
+    return compLength + sizeof(uncompLength) + sizeof(compLength);
+}
+
+bool TaskBlock::read(FILE* in, const BasicBlockSequences* sequences)
+{
+    uint64 uncompLength = 0, compLength = 0;
+
+    if (sizeof(uint64) != ct_read(&uncompLength, sizeof(uint64), in)) return false;
+    if (sizeof(uint64) != ct_read(&compLength, sizeof(uint64), in)) return false;
+
+    unsigned char* comp = (unsigned char*) malloc(compLength);
+    assert(comp != NULL);
+    if (compLength != ct_read(comp, compLength, in))
+    {
+        free(comp);
+        return false;
+    }
+
+    bool r = decode(comp, uncompLength, compLength, sequences);
+    free(comp);
+
+    return r;
+}
+
+bool TaskBlock::decode(const unsigned char* comp, uint64 uncompLength, uint64 compLength,
+                       const BasicBlockSequences* sequences)
+{
+    uint32_t taskCount = 0;
+    uint64 actionCount = 0, succCount = 0, predCount = 0;
+    uint64 pos = 0;
+
+    clear();
+
+    // The buffer is kept with the block, so a reused block does not allocate it again
+    decodeBuffer.resize(uncompLength);
+    unsigned char* src = decodeBuffer.data();
+    uLongf srcLen = uncompLength;
+    if (Z_OK != uncompress(src, &srcLen, comp, compLength) || srcLen != uncompLength)
+    {
+        return false;
+    }
+
+    // Each column is checked against the length before it is copied
+    uint32_t flags = 0;
+    if (uncompLength < TASK_BLOCK_HEADER_SIZE) return false;
+    memcpy(&taskCount, src + pos, sizeof(uint32_t)); pos += sizeof(uint32_t);
+    memcpy(&flags, src + pos, sizeof(uint32_t)); pos += sizeof(uint32_t);
+    memcpy(&actionCount, src + pos, sizeof(uint64)); pos += sizeof(uint64);
+    memcpy(&succCount, src + pos, sizeof(uint64)); pos += sizeof(uint64);
+    memcpy(&predCount, src + pos, sizeof(uint64)); pos += sizeof(uint64);
+
+    if ((uncompLength - pos) / sizeof(TaskBlockEntry) < taskCount) return false;
+    entries.resize(taskCount);
+    memcpy(entries.data(), src + pos, taskCount * sizeof(TaskBlockEntry));
+    pos += taskCount * sizeof(TaskBlockEntry);
+
+    // The stored actions fill the space before the successors and predecessors
+    uint64 edgeLength = (succCount + predCount) * sizeof(TaskId);
+    if (succCount > uncompLength || predCount > uncompLength ||
+        edgeLength > uncompLength - pos) return false;
+    uint64 actionLength = uncompLength - edgeLength - pos;
+
+    // Find where each task starts in the columns
+    //   Actions not in a sequence take at least a byte each, which bounds the
+    //   actions a corrupt block can claim.
+    uint64 aPos = 0, sPos = 0, pPos = 0, actionLimit = actionLength;
+    actionStart.resize(taskCount);
+    succStart.resize(taskCount);
+    predStart.resize(taskCount);
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+        actionStart[i] = aPos;
+        succStart[i] = sPos;
+        predStart[i] = pPos;
+        aPos += entries[i].asize;
+        sPos += entries[i].ssize;
+        pPos += entries[i].psize;
+        if (entries[i].sequenceId != 0 && sequences != NULL)
+        {
+            actionLimit += sequences->getSequence(entries[i].sequenceId).size();
+        }
+    }
+    if (aPos != actionCount || sPos != succCount || pPos != predCount || aPos > actionLimit) return false;
+
+    bool r;
+    if (flags & TASK_BLOCK_FLAG_ENCODED_ACTIONS)
+    {
+        r = decodeActions(src + pos, src + pos + actionLength, actionCount, sequences);
+    }
+    else
+    {
+        r = (actionLength % sizeof(Action)) == 0 &&
+            expandActions(src + pos, actionLength / sizeof(Action), actionCount, sequences);
+    }
+    if (!r) return false;
+    pos += actionLength;
+    succ.resize(succCount);
+    memcpy(succ.data(), src + pos, succCount * sizeof(TaskId));
+    pos += succCount * sizeof(TaskId);
+    pred.resize(predCount);
+    memcpy(pred.data(), src + pos, predCount * sizeof(TaskId));
+
+    return true;
+}
+
+Task* TaskBlock::getTask(uint32_t slot) const
+{
+    if (slot >= entries.size()) return NULL;
+
+    Task* task = new Task();
+    getTaskInto(slot, *task);
+
+    return task;
+}
+
+//
+// Replace the contents of a task, its vectors keep their capacity
+//
+bool TaskBlock::getTaskInto(uint32_t slot, Task& task) const
+{
+    if (slot >= entries.size()) return false;
+
+    const TaskBlockEntry& e = entries[slot];
+
+    task.releaseSegments();
+    task.arena = NULL;
+    task.taskId = TaskId(e.taskId);
+    task.type = (task_type)e.type;
+    task.startTime = e.startTime;
+    task.endTime = e.endTime;
+    task.syncType = (sync_type)e.syncType;
+    task.sequenceId = e.sequenceId;
+
+    task.a.assign(actions.begin() + actionStart[slot], actions.begin() + actionStart[slot] + e.asize);
+    task.s.assign(succ.begin() + succStart[slot], succ.begin() + succStart[slot] + e.ssize);
+    task.p.assign(pred.begin() + predStart[slot], pred.begin() + predStart[slot] + e.psize);
+
+    task.bbCount = 0;
+    task.actionsDropped = false;
+    task.droppedMemOps = 0;
+    if (e.flags & TASK_BLOCK_ACTIONS_DROPPED)
+    {
+        task.actionsDropped = true;
+        task.droppedMemOps = e.droppedMemOps;
+        task.bbCount = e.bbCount;
+    }
+    else
+    {
+        for (Action act : task.a)
+        {
+            if (act.isBasicBlockAction()) task.bbCount++;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,113 @@
+#ifndef TASK_BLOCK_HPP
+#define TASK_BLOCK_HPP
+
+#include "Task.hpp"
+#include "BasicBlockSequences.hpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+namespace contech {
+
+// Uncompressed size at which a block is full
+#define TASK_BLOCK_TARGET_SIZE (1024 * 1024)
+
+// In version 2 graphs, the index locates a task by block number and slot within the block
+#define TASK_BLOCK_LOCATION(b, s) (((uint64)(b) << 32) | (uint32_t)(s))
+#define TASK_BLOCK_NUMBER(l) ((uint32_t)((l) >> 32))
+#define TASK_BLOCK_SLOT(l) ((uint32_t)(l))
+
+// Task entry flags, the task's actions were dropped and only its counts are kept
+#define TASK_BLOCK_ACTIONS_DROPPED 0x1
+
+// Block header flags, the action column is delta encoded rather than raw action words
+#define TASK_BLOCK_FLAG_ENCODED_ACTIONS 0x1
+
+// Fixed size header of each task in a block
+struct TaskBlockEntry
+{
+    uint64 taskId;
+    uint64 startTime;
+    uint64 endTime;
+    uint64 droppedMemOps;
+    uint32_t asize;
+    uint32_t ssize;
+    uint32_t psize;
+    uint32_t bbCount;
+    int32_t type;
+    int32_t syncType;
+    uint32_t flags;
+    uint32_t sequenceId;    // in the graph's BasicBlockSequences, 0 for none
+};
+
+//
+// A block of tasks in a version 2 task graph
+//
+//   Tasks are stored as columns: the fixed size entries, then every action,
+//   then every successor and every predecessor.  Each block is compressed as
+//   one unit, with the same length header as a version 1 task:
+//
+//   uint64 uncompressed length, uint64 compressed length, zlib data of
+//     uint32 task count, uint32 flags, uint64 action count,
+//     uint64 successor count, uint64 predecessor count,
+//     TaskBlockEntry[task count], actions, successors, predecessors
+//
+//   The actions are raw words, or with TASK_BLOCK_FLAG_ENCODED_ACTIONS a byte stream
+//   of delta coded actions (see encodeActions), which is decoded in bulk when
+//   the block is read.  Tasks with a basic block sequence only store their
+//   memory actions, the basic blocks come from the graph's dictionary.
+//
+class TaskBlock
+{
+friend class TaskView;
+
+public:
+    TaskBlock();
+
+    // Append a task, returns its slot
+    //   With sequences, the task's sequence is found or added and its id is set
+    uint32_t addTask(Task& t, BasicBlockSequences* sequences = NULL);
+    uint32_t getTaskCount() const;
+    // Size of the uncompressed block
+    size_t getByteSize() const;
+    bool isFull() const;
+    void clear();
+
+    // Serialize and compress the block, returns a malloc'd buffer of compLength bytes
+    unsigned char* compress(uint64& uncompLength, uint64& compLength) const;
+    // Returns the bytes written, does not free the buffer
+    static size_t writeCompressed(unsigned char* comp, uint64 uncompLength, uint64 compLength, FILE* out);
+
+    // Read a compressed block from the current position of the file
+    bool read(FILE* in, const BasicBlockSequences* sequences = NULL);
+    // Decode a block from a compressed buffer, with the sequences of its graph
+    bool decode(const unsigned char* comp, uint64 uncompLength, uint64 compLength,
+                const BasicBlockSequences* sequences = NULL);
+    Task* getTask(uint32_t slot) const;
+    // Read a task into an existing one, reusing its vectors
+    bool getTaskInto(uint32_t slot, Task& task) const;
+
+private:
+    void encodeActions(std::vector<unsigned char>& out) const;
+    bool decodeActions(const unsigned char* p, const unsigned char* end, uint64 actionCount,
+                       const BasicBlockSequences* sequences);
+    bool expandActions(const unsigned char* p, uint64 storedCount, uint64 actionCount,
+                       const BasicBlockSequences* sequences);
+
+    std::vector<TaskBlockEntry> entries;
+    std::vector<Action> actions;
+    std::vector<TaskId> succ;
+    std::vector<TaskId> pred;
+
+    // Start of each task in the action, successor and predecessor columns
+    std::vector<uint64> actionStart;
+    std::vector<uint64> succStart;
+    std::vector<uint64> predStart;
+
+    // Uncompressed block, kept for the next decode
+    std::vector<unsigned char> decodeBuffer;
+};
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "TaskBlock.hpp"
+#include <zlib.h>
+#include <string.h>
+#include <random>
+
+using namespace std;
+using namespace contech;
+
+//
+// Round trip blocks of tasks through compress and decode
+//
+//   Each block is compressed, decoded, and every task compared to the task that
+//   was added.  Truncated blocks must fail to decode rather than read past them.
+//
+
+static int failures = 0;
+
+#define CHECK(c, name) do { if (!(c)) { printf("FAIL %s: %s\n", name, #c); failures++; } } while (0)
+
+// The flags of a compressed block
+static uint32_t blockFlags(const unsigned char* comp, uint64 uncompLength, uint64 compLength)
+{
+    vector<unsigned char> src(uncompLength);
+    uLongf srcLen = uncompLength;
+    uint32_t flags = 0;
+
+    if (Z_OK == uncompress(src.data(), &srcLen, comp, compLength) && srcLen >= 2 * sizeof(uint32_t))
+    {
+        memcpy(&flags, src.data() + sizeof(uint32_t), sizeof(uint32_t));
+    }
+    return flags;
+}
+
+static void roundTrip(const char* name, vector<Task>& tasks, BasicBlockSequences& sequences, bool expectEncoded)
+{
+    TaskBlock block;
+    for (Task& t : tasks)
+    {
+        block.addTask(t, &sequences);
+    }
+
+    uint64 uncompLength, compLength;
+    unsigned char* comp = block.compress(uncompLength, compLength);
+    bool encoded = (blockFlags(comp, uncompLength, compLength) & TASK_BLOCK_FLAG_ENCODED_ACTIONS) != 0;
+    CHECK(encoded == expectEncoded, name);
+
+    TaskBlock decoded;
+    CHECK(decoded.decode(comp, uncompLength, compLength, &sequences), name);
+    CHECK(decoded.getTaskCount() == tasks.size(), name);
+
+    Task t;
+    for (uint32_t i = 0; i < tasks.size() && i < decoded.getTaskCount(); i++)
+    {
+        CHECK(decoded.getTaskInto(i, t), name);
+        CHECK(t == tasks[i], name);
+        CHECK(t.getSequenceId() == tasks[i].getSequenceId(), name);
+        CHECK(t.getBBCount() == tasks[i].getBBCount(), name);
+    }
+
+    // A block cut short anywhere is rejected
+    vector<unsigned char> src(uncompLength);
+    uLongf srcLen = uncompLength;
+    CHECK(Z_OK == uncompress(src.data(), &srcLen, comp, compLength), name);
+    for (uint64 cut = 0; cut < uncompLength; cut += 1 + uncompLength / 64)
+    {
+        uLongf cutLen = compressBound(cut);
+        vector<unsigned char> cutComp(cutLen);
+        ::compress(cutComp.data(), &cutLen, src.data(), cut);
+        TaskBlock truncated;
+        CHECK(!truncated.decode(cutComp.data(), cut, cutLen, &sequences), name);
+    }
+    free(comp);
+
+    printf("%s: %u tasks, %lu bytes, %s\n", name, (unsigned)tasks.size(), uncompLength,
+           encoded ? "encoded" : "raw");
+}
+
+// Tasks of several ranks, with basic block ids past the op slot limit
+static void testLargeIds()
+{
+    static const uint32_t bbIds[] = {0, 5, 4095, (1 << 20) - 1, 1 << 20, 500000, 0xffffff};
+    BasicBlockSequences sequences;
+    vector<Task> tasks;
+
+    for (uint32_t rank = 0; rank < 3; rank++)
+    {
+        for (uint32_t ctx = 0; ctx < 4; ctx++)
+        {
+            ContextId cid((rank << 24) | ctx);
+            for (uint32_t seq = 0; seq < 6; seq++)
+            {
+                Task t(TaskId(cid, SeqId(seq)), task_type_basic_blocks);
+                t.setStartTime(1000 * seq);
+                t.setEndTime(1000 * seq + 999);
+                if (seq > 0) t.addPredecessor(TaskId(cid, SeqId(seq - 1)));
+                if (seq < 5) t.addSuccessor(TaskId(cid, SeqId(seq + 1)));
+                for (uint32_t b = 0; b < 20; b++)
+                {
+                    uint32_t id = bbIds[(b + seq) % 7];
+                    t.recordBasicBlockAction(id);
+                    for (uint32_t m = 0; m < 3; m++)
+                    {
+                        // Sizes change the upper bits, so some ops need the extra bytes
+                        t.recordMemOpAction(m == 1, (b % 4 == 0) ? 2 : 3,
+                                            0x100000000ULL * rank + 0x10000 * ctx + 64 * b + 8 * m);
+                    }
+                }
+                tasks.push_back(t);
+            }
+        }
+    }
+
+    roundTrip("large ids", tasks, sequences, true);
+}
+
+// Repeated task shapes take their basic blocks from the sequences
+static void testSequences()
+{
+    BasicBlockSequences sequences;
+    vector<Task> tasks;
+
+    for (uint32_t seq = 0; seq < 40; seq++)
+    {
+        Task t(TaskId(ContextId(seq % 2), SeqId(seq / 2)), task_type_basic_blocks);
+        t.setStartTime(seq);
+        t.setEndTime(seq + 1);
+        for (uint32_t b = 0; b < 8; b++)
+        {
+            t.recordBasicBlockAction(100 + b + (seq % 3) * 8);
+            for (uint32_t m = 0; m < b % 3; m++)
+            {
+                t.recordMemOpAction(false, 3, 0x7000000 + 4096 * seq + 8 * b + m);
+            }
+        }
+        tasks.push_back(t);
+    }
+
+    roundTrip("sequences", tasks, sequences, true);
+
+    uint32_t withSequence = 0;
+    for (Task& t : tasks)
+    {
+        if (t.getSequenceId() != 0) withSequence++;
+    }
+    CHECK(withSequence > 0, "sequences");
+}
+
+// Addresses without any stride do not encode well, so the block keeps raw actions
+static void testRaw()
+{
+    BasicBlockSequences sequences;
+    vector<Task> tasks;
+    mt19937_64 rng(1);
+
+    for (uint32_t seq = 0; seq < 10; seq++)
+    {
+        Task t(TaskId(ContextId(0), SeqId(seq)), task_type_basic_blocks);
+        t.recordBasicBlockAction(seq);
+        for (uint32_t m = 0; m < 200; m++)
+        {
+            t.recordMemOpAction(rng() & 1, 2 + rng() % 2, rng() & ((1ULL << 48) - 1));
+        }
+        tasks.push_back(t);
+    }
+
+    roundTrip("raw", tasks, sequences, false);
+}
+
+int main(int argc, char const *argv[])
+{
+    testLargeIds();
+    testSequences();
+    testRaw();
+
+    if (failures != 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
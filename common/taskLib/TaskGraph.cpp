@@ -1,7 +1,15 @@
 #include "TaskGraph.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+#include <atomic>
 
 using namespace contech;
 
+static_assert(sizeof(TaskSummary) == 64, "TaskSummary is stored directly in task graphs");
+
 //
 // Cannot call constructor directly, but wrap with "factory"
 //
@@ -32,9 +40,39 @@ TaskGraph* TaskGraph::initFromFile(FILE* f)
 //
 TaskGraph::TaskGraph(FILE* f)
 {
-    uint version = 0;
     uint64 taskIndexOffset = 0;
     inputFile = f;
+    inputFd = fileno(f);
+    version = 0;
+    mapBase = NULL;
+    mapLength = 0;
+    taskOrder = NULL;
+    taskLookup = NULL;
+    taskCount = 0;
+    ROIStartPos = ROIEndPos = 0;
+    nextTask = 0;
+    blockOffsets = NULL;
+    blockCount = 0;
+    taskSummaries = NULL;
+    summaryEdges = NULL;
+    addressSummaries = NULL;
+    pthread_mutex_init(&summaryLock, NULL);
+    numOfContexts = 0;
+    pthread_mutex_init(&blockLock, NULL);
+    pthread_cond_init(&blockReady, NULL);
+    pthread_mutex_init(&prefetchLock, NULL);
+    pthread_cond_init(&prefetchCond, NULL);
+    prefetchClaim = prefetchConsume = 0;
+    prefetchStop = false;
+    
+    // By default, read ahead with the spare processors
+    //   CONTECH_PREFETCH_THREADS overrides this for backends that are not changed
+    prefetchThreadCount = min(get_nprocs() - 1, TASK_GRAPH_MAX_PREFETCH_THREADS);
+    if (char* pt = getenv("CONTECH_PREFETCH_THREADS"))
+    {
+        prefetchThreadCount = atoi(pt);
+    }
+    prefetchThreadCount = max(0, prefetchThreadCount);
     
     // This is to ensure the file is at the start
     fseek(f, 0, SEEK_SET);
@@ -46,9 +84,9 @@ TaskGraph::TaskGraph(FILE* f)
         return;
     }
     
-    if (version != TASK_GRAPH_VERSION)
+    if (version < TASK_GRAPH_VERSION_V1 || version > TASK_GRAPH_VERSION_V6)
     {
-        fprintf(stderr, "TASK GRAPH - Warning version number is %u, expected %u\n", version, TASK_GRAPH_VERSION);
+        fprintf(stderr, "TASK GRAPH - Warning version number is %u, expected %u to %u\n", version, TASK_GRAPH_VERSION_V1, TASK_GRAPH_VERSION_V6);
     }
     
     // Next is the location of the taskIndex in the file
@@ -56,6 +94,8 @@ TaskGraph::TaskGraph(FILE* f)
     ct_read(&ROIStart, sizeof(TaskId), f);
     ct_read(&ROIEnd, sizeof(TaskId), f);
     
+    mapInputFile();
+    
     // Then comes the taskGraphInfo structure
     tgi = readTaskGraphInfo();
     
@@ -65,7 +105,164 @@ TaskGraph::TaskGraph(FILE* f)
 
 TaskGraph::~TaskGraph()
 {
+    stopPrefetch();
     delete tgi;
+    if (mapBase != NULL) munmap(mapBase, mapLength);
+}
+
+//
+// Map the input file, so tasks and blocks are decompressed directly from the mapping
+//   Files that cannot be mapped are read with pread
+//
+void TaskGraph::mapInputFile()
+{
+    struct stat st;
+    
+    if (0 != fstat(inputFd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+    
+    void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, inputFd, 0);
+    if (m == MAP_FAILED) return;
+    
+    mapBase = (unsigned char*)m;
+    mapLength = st.st_size;
+}
+
+//
+// Find the compressed record at a position, either a version 1 task or a block
+//   Both start with the uncompressed and compressed lengths.  The record is
+//   in the mapping, or is read with pread into buffer, which the caller frees.
+//   Returns NULL if the record is not in the file.
+//
+const unsigned char* TaskGraph::getRecord(uint64 pos, uint64& uncompLength, uint64& compLength, unsigned char*& buffer)
+{
+    buffer = NULL;
+    
+    if (mapBase != NULL)
+    {
+        if (pos + 2 * sizeof(uint64) > mapLength) return NULL;
+        memcpy(&uncompLength, mapBase + pos, sizeof(uint64));
+        memcpy(&compLength, mapBase + pos + sizeof(uint64), sizeof(uint64));
+        if (pos + 2 * sizeof(uint64) + compLength > mapLength) return NULL;
+        
+        return mapBase + pos + 2 * sizeof(uint64);
+    }
+    
+    // pread does not move the file position, so readers do not need a lock
+    uint64 lengths[2];
+    if (sizeof(lengths) != pread(inputFd, lengths, sizeof(lengths), pos)) return NULL;
+    uncompLength = lengths[0];
+    compLength = lengths[1];
+    
+    buffer = (unsigned char*) malloc(compLength);
+    assert(buffer != NULL);
+    if ((ssize_t)compLength != pread(inputFd, buffer, compLength, pos + sizeof(lengths)))
+    {
+        free(buffer);
+        buffer = NULL;
+        return NULL;
+    }
+    
+    return buffer;
+}
+
+//
+// Read the task at a position from the index
+//
+Task* TaskGraph::readTaskAt(uint64 pos)
+{
+    if (hasBlocks())
+    {
+        shared_ptr<TaskBlock> b = getBlock(TASK_BLOCK_NUMBER(pos));
+        if (b == NULL) return NULL;
+        return b->getTask(TASK_BLOCK_SLOT(pos));
+    }
+    
+    uint64 recordLength, compLength;
+    unsigned char* buffer;
+    const unsigned char* comp = getRecord(pos, recordLength, compLength, buffer);
+    if (comp == NULL) return NULL;
+    
+    Task* t = Task::decompressContechTask(comp, recordLength, compLength);
+    free(buffer);
+    
+    return t;
+}
+
+//
+// Decode a block from the file
+//
+bool TaskGraph::readBlock(uint32_t blockId, TaskBlock* b)
+{
+    uint64 uncompLength, compLength;
+    unsigned char* buffer;
+    const unsigned char* comp = getRecord(blockOffsets[blockId], uncompLength, compLength, buffer);
+    if (comp == NULL) return false;
+    
+    bool r = b->decode(comp, uncompLength, compLength, &sequences);
+    free(buffer);
+    
+    return r;
+}
+
+//
+// Get a decoded block, tasks are mostly in block order so only a few are kept
+//
+//   Safe to call from any thread.  A block is decoded outside of the
+//   lock, and any other thread that needs the same block waits for it.
+//
+shared_ptr<TaskBlock> TaskGraph::getBlock(uint32_t blockId)
+{
+    if (blockId >= blockCount) return NULL;
+    
+    pthread_mutex_lock(&blockLock);
+    while (true)
+    {
+        auto it = blockCache.find(blockId);
+        if (it != blockCache.end())
+        {
+            shared_ptr<TaskBlock> b = it->second;
+            pthread_mutex_unlock(&blockLock);
+            return b;
+        }
+        if (blocksLoading.find(blockId) == blocksLoading.end()) break;
+        pthread_cond_wait(&blockReady, &blockLock);
+    }
+    blocksLoading.insert(blockId);
+    
+    shared_ptr<TaskBlock> b;
+    if (blockCacheOrder.size() >= TASK_GRAPH_BLOCK_CACHE)
+    {
+        // Reuse the oldest block, unless a view still refers to it
+        auto old = blockCache.find(blockCacheOrder.front());
+        if (old->second.use_count() == 1) b = old->second;
+        blockCache.erase(old);
+        blockCacheOrder.pop_front();
+    }
+    pthread_mutex_unlock(&blockLock);
+    
+    if (b == NULL)
+    {
+        b = make_shared<TaskBlock>();
+    }
+    
+    bool r = readBlock(blockId, b.get());
+    if (!r)
+    {
+        fprintf(stderr, "TASK GRAPH - Failed to read block %u at %lu\n", blockId, blockOffsets[blockId]);
+        b = NULL;
+    }
+    
+    pthread_mutex_lock(&blockLock);
+    blocksLoading.erase(blockId);
+    if (b != NULL)
+    {
+        blockCache[blockId] = b;
+        blockCacheOrder.push_back(blockId);
+    }
+    pthread_cond_broadcast(&blockReady);
+    pthread_mutex_unlock(&blockLock);
+    
+    return b;
 }
 
 //
@@ -73,19 +270,296 @@ TaskGraph::~TaskGraph()
 //
 Task* TaskGraph::getNextTask()
 {
-    if (nextTask == taskOrder.end()) return NULL;
+    if (prefetchThreadCount > 0) return getNextPrefetchedTask();
+    
+    if (nextTask >= taskCount) return NULL;
+    
+    return readTaskAt(taskOrder[nextTask++].pos);
+}
+
+//
+// Prefetching
+//
+//   The prefetch threads claim batches of the positions after nextTask in order
+//   and decode each task into a ring of TASK_GRAPH_PREFETCH_DEPTH slots.  A thread
+//   waits when its batch would be a full ring ahead of the consumer, and getNextTask waits
+//   until the task at nextTask is in its slot.  The threads are started on the
+//   first getNextTask and stopped whenever the order is moved.
+//
+void* TaskGraph::prefetchWorker(void* v)
+{
+    TaskGraph* tg = (TaskGraph*)v;
+    Task* batch[TASK_GRAPH_PREFETCH_BATCH];
+    
+    pthread_mutex_lock(&tg->prefetchLock);
+    while (true)
+    {
+        while (!tg->prefetchStop &&
+               tg->prefetchClaim < tg->taskCount &&
+               tg->prefetchClaim + TASK_GRAPH_PREFETCH_BATCH > tg->prefetchConsume + TASK_GRAPH_PREFETCH_DEPTH)
+        {
+            pthread_cond_wait(&tg->prefetchCond, &tg->prefetchLock);
+        }
+        if (tg->prefetchStop || tg->prefetchClaim >= tg->taskCount) break;
+        
+        // Claim a batch of positions, to limit the hand offs through the lock
+        //   and any tasks returned by readNextInto to read them into
+        size_t claim = tg->prefetchClaim;
+        size_t count = min((size_t)TASK_GRAPH_PREFETCH_BATCH, (size_t)(tg->taskCount - claim));
+        tg->prefetchClaim += count;
+        for (size_t i = 0; i < count; i++)
+        {
+            batch[i] = NULL;
+            if (tg->prefetchSpare.empty()) continue;
+            batch[i] = tg->prefetchSpare.back();
+            tg->prefetchSpare.pop_back();
+        }
+        pthread_mutex_unlock(&tg->prefetchLock);
+        
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64 pos = tg->taskOrder[claim + i].pos;
+            if (batch[i] == NULL)
+            {
+                batch[i] = tg->readTaskAt(pos);
+            }
+            else if (!tg->readTaskIntoAt(pos, *batch[i]))
+            {
+                delete batch[i];
+                batch[i] = NULL;
+            }
+        }
+        
+        pthread_mutex_lock(&tg->prefetchLock);
+        for (size_t i = 0; i < count; i++)
+        {
+            PrefetchSlot& ps = tg->prefetchRing[(claim + i) % TASK_GRAPH_PREFETCH_DEPTH];
+            assert(!ps.ready);
+            ps.task = batch[i];
+            ps.ready = true;
+        }
+        pthread_cond_broadcast(&tg->prefetchCond);
+    }
+    pthread_mutex_unlock(&tg->prefetchLock);
+    
+    return NULL;
+}
+
+void TaskGraph::startPrefetch()
+{
+    prefetchConsume = nextTask;
+    prefetchClaim = prefetchConsume;
+    prefetchStop = false;
+    prefetchRing.assign(TASK_GRAPH_PREFETCH_DEPTH, PrefetchSlot());
+    
+    prefetchThreads.resize(prefetchThreadCount);
+    for (pthread_t& t : prefetchThreads)
+    {
+        int r = pthread_create(&t, NULL, prefetchWorker, this);
+        assert(r == 0);
+    }
+}
+
+void TaskGraph::stopPrefetch()
+{
+    if (prefetchThreads.empty()) return;
+    
+    pthread_mutex_lock(&prefetchLock);
+    prefetchStop = true;
+    pthread_cond_broadcast(&prefetchCond);
+    pthread_mutex_unlock(&prefetchLock);
+    
+    for (pthread_t& t : prefetchThreads)
+    {
+        pthread_join(t, NULL);
+    }
+    prefetchThreads.clear();
+    
+    // Discard the tasks that were read ahead
+    for (PrefetchSlot& ps : prefetchRing)
+    {
+        if (ps.ready) delete ps.task;
+    }
+    prefetchRing.clear();
+    for (Task* t : prefetchSpare)
+    {
+        delete t;
+    }
+    prefetchSpare.clear();
+}
+
+Task* TaskGraph::getNextPrefetchedTask()
+{
+    if (nextTask >= taskCount) return NULL;
+    if (prefetchThreads.empty()) startPrefetch();
+    
+    pthread_mutex_lock(&prefetchLock);
+    PrefetchSlot& ps = prefetchRing[prefetchConsume % TASK_GRAPH_PREFETCH_DEPTH];
+    while (!ps.ready)
+    {
+        pthread_cond_wait(&prefetchCond, &prefetchLock);
+    }
+    Task* t = ps.task;
+    ps.task = NULL;
+    ps.ready = false;
+    prefetchConsume++;
+    // Only wake the threads once a batch of slots is free
+    if (prefetchConsume % TASK_GRAPH_PREFETCH_BATCH == 0) pthread_cond_broadcast(&prefetchCond);
+    pthread_mutex_unlock(&prefetchLock);
+    
+    nextTask++;
+    
+    return t;
+}
+
+//
+// Read the task at a position from the index into an existing task
+//
+bool TaskGraph::readTaskIntoAt(uint64 pos, Task& task)
+{
+    if (hasBlocks())
+    {
+        shared_ptr<TaskBlock> b = getBlock(TASK_BLOCK_NUMBER(pos));
+        return b != NULL && b->getTaskInto(TASK_BLOCK_SLOT(pos), task);
+    }
+    
+    // Version 1 tasks are each decoded into a new task
+    Task* t = readTaskAt(pos);
+    if (t == NULL) return false;
+    task.swap(*t);
+    delete t;
+    
+    return true;
+}
+
+//
+// Read the next task in the order into task, reusing its vectors
+//   With prefetching, task is swapped with the task read ahead, and the
+//   prefetch threads read a later task into the vectors it had
+//
+bool TaskGraph::readNextInto(Task& task)
+{
+    if (prefetchThreadCount > 0)
+    {
+        Task* t = getNextPrefetchedTask();
+        if (t == NULL) return false;
+        
+        task.swap(*t);
+        pthread_mutex_lock(&prefetchLock);
+        bool spare = prefetchSpare.size() < TASK_GRAPH_PREFETCH_DEPTH;
+        if (spare) prefetchSpare.push_back(t);
+        pthread_mutex_unlock(&prefetchLock);
+        if (!spare) delete t;
+        
+        return true;
+    }
+    
+    if (nextTask >= taskCount) return false;
+    
+    return readTaskIntoAt(taskOrder[nextTask++].pos, task);
+}
+
+bool TaskGraph::readByIdInto(TaskId id, Task& task)
+{
+    uint64 order;
+    
+    if (!findTaskOrder(id, order)) return false;
+    
+    return readTaskIntoAt(taskOrder[order].pos, task);
+}
+
+//
+// Set the number of prefetch threads, 0 reads each task in getNextTask
+//
+void TaskGraph::setPrefetchThreads(int n)
+{
+    stopPrefetch();
+    prefetchThreadCount = max(0, n);
+}
+
+//
+// Read the task at a position from the index as a view
+//   Version 1 tasks are decoded into a block of their own
+//
+bool TaskGraph::readTaskViewAt(uint64 pos, TaskView& view)
+{
+    if (hasBlocks())
+    {
+        shared_ptr<TaskBlock> b = getBlock(TASK_BLOCK_NUMBER(pos));
+        if (b == NULL || TASK_BLOCK_SLOT(pos) >= b->getTaskCount())
+        {
+            view.clear();
+            return false;
+        }
+        view = TaskView(b, TASK_BLOCK_SLOT(pos));
+        return true;
+    }
+    
+    Task* t = readTaskAt(pos);
+    if (t == NULL)
+    {
+        view.clear();
+        return false;
+    }
+    
+    shared_ptr<TaskBlock> b = make_shared<TaskBlock>();
+    b->addTask(*t);
+    delete t;
+    view = TaskView(b, 0);
+    
+    return true;
+}
+
+bool TaskGraph::getNextTaskView(TaskView& view)
+{
+    // Views are not prefetched, as they are not copied out of the block
+    stopPrefetch();
+    
+    if (nextTask >= taskCount)
+    {
+        view.clear();
+        return false;
+    }
+    
+    return readTaskViewAt(taskOrder[nextTask++].pos, view);
+}
+
+bool TaskGraph::getTaskViewById(TaskId id, TaskView& view)
+{
+    uint64 order;
+    
+    if (!findTaskOrder(id, order))
+    {
+        view.clear();
+        return false;
+    }
     
-    //if ((e = ct_lock(inputFile))) return NULL;
+    return readTaskViewAt(taskOrder[order].pos, view);
+}
+
+//
+// Binary search the lookup for the position of a task in the order
+//
+bool TaskGraph::findTaskOrder(TaskId id, uint64& order)
+{
+    const TaskIndexLookup* it = lower_bound(taskLookup, taskLookup + taskCount, id,
+                                            [](const TaskIndexLookup& a, TaskId b) { return a.tid < b; });
     
-    fseek(inputFile, *nextTask, SEEK_SET);
-    ++nextTask;
+    if (it == taskLookup + taskCount || it->tid != id) return false;
     
-    return Task::readContechTaskUnlock(inputFile);
+    order = it->order;
+    return true;
+}
+
+bool TaskGraph::hasBlocks()
+{
+    return version >= TASK_GRAPH_VERSION_V2 && version <= TASK_GRAPH_VERSION_V6;
 }
 
 void TaskGraph::resetTaskOrder()
 {
-    nextTask = taskOrder.begin();
+    stopPrefetch();
+    nextTask = 0;
 }
 
 //
@@ -94,9 +568,47 @@ void TaskGraph::resetTaskOrder()
 //
 void TaskGraph::setTaskOrderCurrent(TaskId tid)
 {
-    uint64_t tidPos = taskIdx[tid];
-    while (nextTask != taskOrder.end() &&
-           *nextTask != tidPos) {++nextTask;}
+    stopPrefetch();
+    uint64 order;
+    if (!findTaskOrder(tid, order) || order < nextTask)
+    {
+        // As with a scan forward from the current task, earlier tasks are not found
+        nextTask = taskCount;
+        return;
+    }
+    nextTask = order;
+}
+
+bool TaskGraph::getOrderPosition(TaskId tid, uint64& pos)
+{
+    return findTaskOrder(tid, pos);
+}
+
+void TaskGraph::seekToOrderPosition(uint64 pos)
+{
+    stopPrefetch();
+    nextTask = min(pos, taskCount);
+}
+
+bool TaskGraph::getTaskLocation(uint64 pos, uint32_t& block, uint32_t& slot)
+{
+    if (!hasBlocks() || pos >= taskCount) return false;
+    block = TASK_BLOCK_NUMBER(taskOrder[pos].pos);
+    slot = TASK_BLOCK_SLOT(taskOrder[pos].pos);
+    return true;
+}
+
+uint64 TaskGraph::getBlockCount()
+{
+    return hasBlocks() ? blockCount : 0;
+}
+
+const unsigned char* TaskGraph::getCompressedBlock(uint32_t block, uint64& uncompLength, uint64& compLength,
+                                                   unsigned char*& buffer)
+{
+    buffer = NULL;
+    if (!hasBlocks() || block >= blockCount) return NULL;
+    return getRecord(blockOffsets[block], uncompLength, compLength, buffer);
 }
 
 //
@@ -104,14 +616,11 @@ void TaskGraph::setTaskOrderCurrent(TaskId tid)
 //
 Task* TaskGraph::getTaskById(TaskId id)
 {
-    auto it = taskIdx.find(id);
+    uint64 order;
     
-    if (it == taskIdx.end()) return NULL;
+    if (!findTaskOrder(id, order)) return NULL;
     
-    //if (ct_lock(inputFile)) return NULL;
-    fseek(inputFile, it->second, SEEK_SET);
-    
-    return Task::readContechTaskUnlock(inputFile);
+    return readTaskAt(taskOrder[order].pos);
 }
 
 Task* TaskGraph::readContechTask()
@@ -131,70 +640,899 @@ TaskGraphInfo* TaskGraph::getTaskGraphInfo()
     return tgi;
 }
 
+//
+// Get an array of the index, in place in the mapping when it is aligned
+//   Otherwise it is read into store
+//
+template <typename T>
+const T* TaskGraph::getIndexArray(uint64 off, uint64 count, vector<T>& store)
+{
+    size_t len = count * sizeof(T);
+    
+    if (mapBase != NULL && (off % alignof(T)) == 0 && off + len <= mapLength)
+    {
+        return (const T*)(mapBase + off);
+    }
+    
+    store.resize(count);
+    if (len > 0 && (ssize_t)len != pread(inputFd, (void*)store.data(), len, off))
+    {
+        fprintf(stderr, "TASK GRAPH - Failed to read the index at %lu\n", off);
+        store.clear();
+        return NULL;
+    }
+    
+    return store.data();
+}
+
 void TaskGraph::initTaskIndex(uint64 off)
 {
-    if (0 != fseek(inputFile, off, SEEK_SET))
+    uint64 counts[2] = {0, 0};
+    
+    // Version 3 has the task and context counts, older versions only the task count
+    size_t countSize = (version >= TASK_GRAPH_VERSION_V3) ? 2 * sizeof(uint64) : sizeof(uint64);
+    if ((ssize_t)countSize != pread(inputFd, counts, countSize, off))
     {
         fprintf(stderr, "Failed to seek to specified offset for Task Graph Index - %lu\n", off);
         return;
     }
-    //printf("At %lld, ready to read index\n", off);
+    off += countSize;
     
-    uint64 taskCount;
-    ct_read(&taskCount, sizeof(uint64), inputFile);
-    //printf("Tasks in index - %llu\n", taskCount);
+    taskOrder = getIndexArray(off, counts[0], taskOrderStore);
+    if (taskOrder == NULL) return;
+    off += counts[0] * sizeof(TaskIndexEntry);
     
-    set<ContextId> uniqContexts;
-    
-    for (uint i = 0; i < taskCount; i++)
+    if (version >= TASK_GRAPH_VERSION_V3)
     {
-        TaskId tid;
-        uint64 pos;
-        
-        ct_read(&tid, sizeof(TaskId), inputFile);
-        ct_read(&pos, sizeof(uint64), inputFile);
+        taskLookup = getIndexArray(off, counts[0], taskLookupStore);
+        if (taskLookup == NULL) return;
+        off += counts[0] * sizeof(TaskIndexLookup);
+        numOfContexts = counts[1];
+    }
+    else
+    {
+        // Older versions are sorted now, and their contexts counted from the sorted ids
+        taskLookupStore.resize(counts[0]);
+        for (uint64 i = 0; i < counts[0]; i++)
+        {
+            // We expect that the index comes after every task in the file
+            assert(version != TASK_GRAPH_VERSION_V1 || taskOrder[i].pos < off);
+            taskLookupStore[i].tid = taskOrder[i].tid;
+            taskLookupStore[i].order = i;
+        }
+        sort(taskLookupStore.begin(), taskLookupStore.end(),
+             [](const TaskIndexLookup& a, const TaskIndexLookup& b) { return a.tid < b.tid; });
         
-        //printf("%s at %llu\n", tid.toString().c_str(), pos);
+        numOfContexts = 0;
+        for (uint64 i = 0; i < counts[0]; i++)
+        {
+            // Every tid should only exist once in the index
+            assert(i == 0 || taskLookupStore[i - 1].tid != taskLookupStore[i].tid);
+            if (i == 0 || taskLookupStore[i - 1].tid.getContextId() != taskLookupStore[i].tid.getContextId())
+            {
+                numOfContexts++;
+            }
+        }
+        taskLookup = taskLookupStore.data();
+    }
+    taskCount = counts[0];
+    initContextTasks();
+    
+    // A graph without a ROI has the whole order as its ROI
+    ROIStartPos = 0;
+    ROIEndPos = (taskCount > 0) ? taskCount - 1 : 0;
+    uint64 roiPos;
+    if (findTaskOrder(ROIStart, roiPos)) ROIStartPos = roiPos;
+    if (findTaskOrder(ROIEnd, roiPos)) ROIEndPos = roiPos;
+    
+    // Version 2 and later have the block offsets after the index
+    if (hasBlocks())
+    {
+        if (sizeof(uint64) != pread(inputFd, &blockCount, sizeof(uint64), off))
+        {
+            blockCount = 0;
+            return;
+        }
+        blockOffsets = getIndexArray(off + sizeof(uint64), blockCount, blockOffsetStore);
+        if (blockOffsets == NULL) blockCount = 0;
+        off += sizeof(uint64) + blockCount * sizeof(uint64);
+    }
+    
+    if (version >= TASK_GRAPH_VERSION_V3) initTaskSummaries(off);
+}
+
+//
+// Find each context's range of the lookup
+//   Every task of a context shares the upper 32 bits of its id, so the lookup
+//   holds them together, and a binary search finds the end of each
+//
+void TaskGraph::initContextTasks()
+{
+    uint64 i = 0;
+    
+    contextTasks.clear();
+    while (i < taskCount)
+    {
+        ContextTasks ct;
+        ct.ctx = taskLookup[i].tid.getContextId();
+        ct.first = i;
         
-        // We expect that the index comes after every task in the file
-        assert(pos < off);
-        // Every tid should only exist once in the index
-        assert(taskIdx.find(tid) == taskIdx.end());
-        taskIdx[tid] = pos;
-        taskOrder.push_back(pos);
-        uniqContexts.insert(tid.getContextId());
+        const TaskIndexLookup* end = upper_bound(taskLookup + i, taskLookup + taskCount, ct.ctx,
+                                                 [](ContextId a, const TaskIndexLookup& b) { return a < b.tid.getContextId(); });
+        i = end - taskLookup;
+        ct.count = i - ct.first;
+        contextTasks.push_back(ct);
     }
-    nextTask = taskOrder.begin();
-    numOfContexts = uniqContexts.size();
 }
 
-TaskGraphInfo* TaskGraph::readTaskGraphInfo()
+//
+// Find the summaries that follow the index
+//
+void TaskGraph::initTaskSummaries(uint64 off)
 {
-    // Task Graph Info follows the version number + task index offset
-    //   assert(inputFile is at offset 4 + 8)
+    uint64 count = 0, edgeCount = 0;
     
-    TaskGraphInfo* tTgi = new TaskGraphInfo();
-    tTgi->initTaskGraphInfo(inputFile);
+    if (sizeof(uint64) != pread(inputFd, &count, sizeof(uint64), off) || count != taskCount) return;
+    off += sizeof(uint64);
+    uint64 edgeOff = off + count * sizeof(TaskSummary);
+    if (sizeof(uint64) != pread(inputFd, &edgeCount, sizeof(uint64), edgeOff)) return;
+    
+    const TaskSummary* ts = getIndexArray(off, count, taskSummaryStore);
+    const TaskId* te = getIndexArray(edgeOff + sizeof(uint64), edgeCount, summaryEdgeStore);
+    if (ts == NULL || te == NULL) return;
+    
+    taskSummaries = ts;
+    summaryEdges = te;
+    
+    if (version >= TASK_GRAPH_VERSION_V4) initSequences(edgeOff + sizeof(uint64) + edgeCount * sizeof(TaskId));
+}
 
-    return tTgi;
+//
+// Find the basic block sequences that follow the summaries
+//
+void TaskGraph::initSequences(uint64 off)
+{
+    uint64 uncompLength, compLength;
+    unsigned char* buffer;
+    const unsigned char* comp = getRecord(off, uncompLength, compLength, buffer);
+    
+    if (comp == NULL || !sequences.decode(comp, uncompLength, compLength))
+    {
+        fprintf(stderr, "TASK GRAPH - Failed to read the basic block sequences at %lu\n", off);
+        free(buffer);
+        return;
+    }
+    free(buffer);
+    
+    // The address summaries follow the record, aligned
+    off += 2 * sizeof(uint64) + compLength;
+    if (version >= TASK_GRAPH_VERSION_V6) initAddressSummaries((off + sizeof(uint64) - 1) & ~(sizeof(uint64) - 1));
 }
 
-unsigned int TaskGraph::getNumberOfTasks()
+void TaskGraph::initAddressSummaries(uint64 off)
 {
-    return taskOrder.size();
+    uint64 count = 0;
+    
+    if (sizeof(uint64) != pread(inputFd, &count, sizeof(uint64), off) || count != taskCount) return;
+    addressSummaries = getIndexArray(off + sizeof(uint64), count, addressSummaryStore);
 }
 
-unsigned int TaskGraph::getNumberOfContexts()
+const BasicBlockSequences& TaskGraph::getBasicBlockSequences()
 {
-    return numOfContexts;
+    return sequences;
 }
 
-TaskId TaskGraph::getROIStart()
+//
+// Graphs without summaries have them built from a scan of their tasks
+//
+void TaskGraph::buildTaskSummaries()
 {
-    return ROIStart;
+    TaskCursor c = getCursor();
+    TaskView v;
+    
+    taskSummaryStore.reserve(taskCount);
+    while (c.getNextTaskView(v))
+    {
+        TaskSummary ts;
+        Span<TaskId> succ = v.getSuccessorTasks(), pred = v.getPredecessorTasks();
+        
+        memset((void*)&ts, 0, sizeof(ts));
+        ts.taskId = v.getTaskId();
+        ts.startTime = v.getStartTime();
+        ts.endTime = v.getEndTime();
+        ts.memOpCount = v.getMemOpCount();
+        ts.edgeStart = summaryEdgeStore.size();
+        ts.bbCount = v.getBBCount();
+        ts.succCount = succ.size();
+        ts.predCount = pred.size();
+        ts.type = v.getType();
+        ts.syncType = v.getSyncType();
+        ts.sequenceId = v.getSequenceId();
+        
+        taskSummaryStore.push_back(ts);
+        summaryEdgeStore.insert(summaryEdgeStore.end(), succ.begin(), succ.end());
+        summaryEdgeStore.insert(summaryEdgeStore.end(), pred.begin(), pred.end());
+    }
+    
+    summaryEdges = summaryEdgeStore.data();
+    taskSummaries = taskSummaryStore.data();
 }
 
-TaskId TaskGraph::getROIEnd()
+Span<const TaskSummary> TaskGraph::getTaskSummaries()
 {
-    return ROIEnd;
+    pthread_mutex_lock(&summaryLock);
+    if (taskSummaries == NULL) buildTaskSummaries();
+    pthread_mutex_unlock(&summaryLock);
+    
+    return Span<const TaskSummary>(taskSummaries, taskCount);
+}
+
+void TaskGraph::buildAddressSummaries()
+{
+    TaskCursor c = getCursor();
+    TaskView v;
+    
+    addressSummaryStore.reserve(taskCount);
+    while (c.getNextTaskView(v))
+    {
+        addressSummaryStore.push_back(v.getAddressSummary());
+    }
+    
+    // Tasks that cannot be read could access any address
+    TaskAddressSummary unknown;
+    unknown.setUnknown();
+    addressSummaryStore.resize(taskCount, unknown);
+    addressSummaries = addressSummaryStore.data();
+}
+
+Span<const TaskAddressSummary> TaskGraph::getAddressSummaries()
+{
+    pthread_mutex_lock(&summaryLock);
+    if (addressSummaries == NULL) buildAddressSummaries();
+    pthread_mutex_unlock(&summaryLock);
+    
+    return Span<const TaskAddressSummary>(addressSummaries, taskCount);
+}
+
+const TaskAddressSummary* TaskGraph::getAddressSummaryById(TaskId id)
+{
+    uint64 order;
+    
+    Span<const TaskAddressSummary> tas = getAddressSummaries();
+    if (!findTaskOrder(id, order)) return NULL;
+    
+    return &tas[order];
+}
+
+const TaskSummary* TaskGraph::getTaskSummaryById(TaskId id)
+{
+    uint64 order;
+    
+    Span<const TaskSummary> ts = getTaskSummaries();
+    if (!findTaskOrder(id, order)) return NULL;
+    
+    return &ts[order];
+}
+
+Span<const TaskId> TaskGraph::getSummarySuccessors(const TaskSummary& ts)
+{
+    return Span<const TaskId>(summaryEdges + ts.edgeStart, ts.succCount);
+}
+
+Span<const TaskId> TaskGraph::getSummaryPredecessors(const TaskSummary& ts)
+{
+    return Span<const TaskId>(summaryEdges + ts.edgeStart + ts.succCount, ts.predCount);
+}
+
+//
+// The edges come from the successors in the summaries, ignoring any task not in the graph
+//
+void TaskGraph::buildOrderEdges(vector<uint64>& succStart, vector<uint64>& succ, vector<uint32_t>& predCount)
+{
+    Span<const TaskSummary> ts = getTaskSummaries();
+    
+    succStart.clear();
+    succStart.reserve(taskCount + 1);
+    succStart.push_back(0);
+    succ.clear();
+    predCount.assign(taskCount, 0);
+    for (uint64 i = 0; i < taskCount; i++)
+    {
+        for (TaskId sid : getSummarySuccessors(ts[i]))
+        {
+            uint64 order;
+            if (!findTaskOrder(sid, order)) continue;
+            succ.push_back(order);
+            predCount[order]++;
+        }
+        succStart.push_back(succ.size());
+    }
+}
+
+bool TaskGraph::getTopologicalLevels(vector<TaskId>& tasks, vector<uint64>& levelStarts)
+{
+    vector<uint64> succStart, succ;
+    vector<uint32_t> predCount;
+    
+    buildOrderEdges(succStart, succ, predCount);
+    
+    vector<uint64> level, next;
+    for (uint64 i = 0; i < taskCount; i++)
+    {
+        if (predCount[i] == 0) level.push_back(i);
+    }
+    
+    tasks.clear();
+    tasks.reserve(taskCount);
+    levelStarts.assign(1, 0);
+    while (!level.empty())
+    {
+        next.clear();
+        for (uint64 i : level)
+        {
+            tasks.push_back(taskOrder[i].tid);
+            for (uint64 j = succStart[i]; j < succStart[i + 1]; j++)
+            {
+                if (--predCount[succ[j]] == 0) next.push_back(succ[j]);
+            }
+        }
+        levelStarts.push_back(tasks.size());
+        
+        sort(next.begin(), next.end());
+        swap(level, next);
+    }
+    
+    return tasks.size() == taskCount;
+}
+
+//
+// Each thread has a queue of ready tasks, it takes the oldest of its own and
+//   otherwise steals the oldest from another thread.  Taking the oldest stays
+//   close to the task order, so the decoded blocks are reused.  Threads without
+//   a task sleep until one is queued or every task is done.
+//
+struct TaskGraph::TopologicalRun
+{
+    struct ReadyQueue
+    {
+        pthread_mutex_t lock;
+        deque<uint64> tasks;
+    };
+    
+    TaskGraph* tg;
+    function<void(Task&)>* f;
+    vector<uint64> succStart;
+    vector<uint64> succ;
+    unique_ptr<atomic<uint32_t>[]> predRemaining;
+    vector<ReadyQueue> queues;
+    atomic<uint64> remaining;   // tasks not yet done
+    atomic<uint64> queued;      // tasks in the queues
+    atomic<int> sleepers;
+    pthread_mutex_t idleLock;
+    pthread_cond_t idleCond;
+    atomic<int> nextThread;
+    
+    void push(int t, uint64 order)
+    {
+        pthread_mutex_lock(&queues[t].lock);
+        queues[t].tasks.push_back(order);
+        pthread_mutex_unlock(&queues[t].lock);
+        queued++;
+        
+        if (sleepers > 0)
+        {
+            pthread_mutex_lock(&idleLock);
+            pthread_cond_signal(&idleCond);
+            pthread_mutex_unlock(&idleLock);
+        }
+    }
+    
+    bool take(int t, uint64& order)
+    {
+        int n = queues.size();
+        for (int k = 0; k < n; k++)
+        {
+            ReadyQueue& q = queues[(t + k) % n];
+            bool found = false;
+            
+            pthread_mutex_lock(&q.lock);
+            if (!q.tasks.empty())
+            {
+                order = q.tasks.front();
+                q.tasks.pop_front();
+                found = true;
+            }
+            pthread_mutex_unlock(&q.lock);
+            
+            if (found)
+            {
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+void* TaskGraph::topologicalWorker(void* v)
+{
+    TopologicalRun* run = (TopologicalRun*)v;
+    TaskGraph* tg = run->tg;
+    int self = run->nextThread++;
+    Task task;
+    
+    while (true)
+    {
+        uint64 order;
+        
+        if (!run->take(self, order))
+        {
+            pthread_mutex_lock(&run->idleLock);
+            run->sleepers++;
+            while (run->queued == 0 && run->remaining > 0)
+            {
+                pthread_cond_wait(&run->idleCond, &run->idleLock);
+            }
+            run->sleepers--;
+            bool done = (run->remaining == 0);
+            pthread_mutex_unlock(&run->idleLock);
+            
+            if (done) break;
+            continue;
+        }
+        
+        if (tg->readTaskIntoAt(tg->taskOrder[order].pos, task))
+        {
+            (*run->f)(task);
+        }
+        
+        for (uint64 j = run->succStart[order]; j < run->succStart[order + 1]; j++)
+        {
+            uint64 s = run->succ[j];
+            if (--run->predRemaining[s] == 0) run->push(self, s);
+        }
+        
+        if (--run->remaining == 0)
+        {
+            pthread_mutex_lock(&run->idleLock);
+            pthread_cond_broadcast(&run->idleCond);
+            pthread_mutex_unlock(&run->idleLock);
+        }
+    }
+    
+    return NULL;
+}
+
+bool TaskGraph::parallelForEachTopological(function<void(Task&)> f, int threads)
+{
+    TopologicalRun run;
+    vector<uint32_t> predCount;
+    
+    if (threads <= 0) threads = get_nprocs();
+    threads = max(1, threads);
+    
+    run.tg = this;
+    run.f = &f;
+    buildOrderEdges(run.succStart, run.succ, predCount);
+    
+    // Check for a cycle first, as its tasks would never be ready
+    {
+        vector<uint32_t> pc = predCount;
+        vector<uint64> ready;
+        uint64 reached = 0;
+        for (uint64 i = 0; i < taskCount; i++)
+        {
+            if (pc[i] == 0) ready.push_back(i);
+        }
+        while (!ready.empty())
+        {
+            uint64 i = ready.back();
+            ready.pop_back();
+            reached++;
+            for (uint64 j = run.succStart[i]; j < run.succStart[i + 1]; j++)
+            {
+                if (--pc[run.succ[j]] == 0) ready.push_back(run.succ[j]);
+            }
+        }
+        if (reached != taskCount)
+        {
+            fprintf(stderr, "TASK GRAPH - %lu tasks are on or after a cycle\n", taskCount - reached);
+            return false;
+        }
+    }
+    
+    run.predRemaining.reset(new atomic<uint32_t>[taskCount]);
+    for (uint64 i = 0; i < taskCount; i++)
+    {
+        run.predRemaining[i] = predCount[i];
+    }
+    run.queues = vector<TopologicalRun::ReadyQueue>(threads);
+    for (TopologicalRun::ReadyQueue& q : run.queues)
+    {
+        pthread_mutex_init(&q.lock, NULL);
+    }
+    run.remaining = taskCount;
+    run.queued = 0;
+    run.sleepers = 0;
+    run.nextThread = 0;
+    pthread_mutex_init(&run.idleLock, NULL);
+    pthread_cond_init(&run.idleCond, NULL);
+    
+    // The tasks without predecessors start spread across the threads, in task order
+    uint64 ready = 0;
+    for (uint64 i = 0; i < taskCount; i++)
+    {
+        if (predCount[i] == 0) run.push(ready++ % threads, i);
+    }
+    
+    vector<pthread_t> pool(threads - 1);
+    for (pthread_t& t : pool)
+    {
+        int r = pthread_create(&t, NULL, topologicalWorker, &run);
+        assert(r == 0);
+    }
+    topologicalWorker(&run);
+    for (pthread_t& t : pool)
+    {
+        pthread_join(t, NULL);
+    }
+    
+    for (TopologicalRun::ReadyQueue& q : run.queues)
+    {
+        pthread_mutex_destroy(&q.lock);
+    }
+    pthread_mutex_destroy(&run.idleLock);
+    pthread_cond_destroy(&run.idleCond);
+    
+    return true;
+}
+
+TaskGraphInfo* TaskGraph::readTaskGraphInfo()
+{
+    // Task Graph Info follows the version number + task index offset + ROI
+    //   assert(inputFile is at offset 4 + 8 + 8 + 8)
+    
+    TaskGraphInfo* tTgi = new TaskGraphInfo();
+    if (version < TASK_GRAPH_VERSION_V5)
+    {
+        tTgi->initTaskGraphInfo(inputFile);
+        return tTgi;
+    }
+    
+    // The section is used in place when the file is mapped
+    uint64 off = ftell(inputFile);
+    bool valid = (mapBase != NULL && off < mapLength) ? tTgi->mapTaskGraphInfo(mapBase + off, mapLength - off)
+                                                      : tTgi->readTaskGraphInfo(inputFile);
+    if (!valid)
+    {
+        fprintf(stderr, "TASK GRAPH - Failed to read the basic block info at %lu\n", off);
+        delete tTgi;
+        tTgi = new TaskGraphInfo();
+    }
+
+    return tTgi;
+}
+
+unsigned int TaskGraph::getNumberOfTasks()
+{
+    return taskCount;
+}
+
+unsigned int TaskGraph::getNumberOfContexts()
+{
+    return numOfContexts;
+}
+
+uint TaskGraph::getVersion()
+{
+    return version;
+}
+
+TaskId TaskGraph::getROIStart()
+{
+    return ROIStart;
+}
+
+TaskId TaskGraph::getROIEnd()
+{
+    return ROIEnd;
+}
+
+uint64 TaskGraph::getROIStartPosition()
+{
+    return ROIStartPos;
+}
+
+uint64 TaskGraph::getROIEndPosition()
+{
+    return ROIEndPos;
+}
+
+TaskCursor TaskGraph::getCursor()
+{
+    return TaskCursor(this, 0, taskCount);
+}
+
+TaskCursor TaskGraph::rangeCursor(TaskId from, TaskId to)
+{
+    uint64 b, e;
+    
+    if (!findTaskOrder(from, b) || !findTaskOrder(to, e) || e < b) return TaskCursor(this, 0, 0);
+    
+    return TaskCursor(this, b, e + 1);
+}
+
+TaskCursor TaskGraph::getROICursor()
+{
+    if (taskCount == 0 || ROIEndPos < ROIStartPos) return TaskCursor(this, 0, 0);
+    
+    return TaskCursor(this, ROIStartPos, ROIEndPos + 1);
+}
+
+ReverseTaskCursor TaskGraph::getReverseCursor()
+{
+    return ReverseTaskCursor(this, 0, taskCount);
+}
+
+ReverseTaskCursor TaskGraph::reverseRangeCursor(TaskId from, TaskId to)
+{
+    uint64 b, e;
+    
+    if (!findTaskOrder(from, b) || !findTaskOrder(to, e) || e < b) return ReverseTaskCursor(this, 0, 0);
+    
+    return ReverseTaskCursor(this, b, e + 1);
+}
+
+ReverseTaskCursor TaskGraph::getReverseROICursor()
+{
+    if (taskCount == 0 || ROIEndPos < ROIStartPos) return ReverseTaskCursor(this, 0, 0);
+    
+    return ReverseTaskCursor(this, ROIStartPos, ROIEndPos + 1);
+}
+
+ContextCursor TaskGraph::contextCursor(ContextId ctx)
+{
+    auto it = lower_bound(contextTasks.begin(), contextTasks.end(), ctx,
+                          [](const ContextTasks& a, ContextId b) { return a.ctx < b; });
+    
+    if (it == contextTasks.end() || it->ctx != ctx) return ContextCursor(this, ctx, 0, 0);
+    
+    return ContextCursor(this, ctx, it->first, it->count);
+}
+
+vector<ContextId> TaskGraph::getContextIds()
+{
+    vector<ContextId> ids;
+    
+    ids.reserve(contextTasks.size());
+    for (const ContextTasks& ct : contextTasks)
+    {
+        ids.push_back(ct.ctx);
+    }
+    return ids;
+}
+
+//
+// Cursors only read the index and use the thread safe readers, so any number
+//   of them can walk the graph concurrently
+//
+TaskCursor::TaskCursor(TaskGraph* g, uint64 b, uint64 e) : tg(g), begin(b), end(e), next(b)
+{
+}
+
+Task* TaskCursor::getNextTask()
+{
+    if (next >= end) return NULL;
+    
+    return tg->readTaskAt(tg->taskOrder[next++].pos);
+}
+
+bool TaskCursor::readNextInto(Task& task)
+{
+    if (next >= end) return false;
+    
+    return tg->readTaskIntoAt(tg->taskOrder[next++].pos, task);
+}
+
+bool TaskCursor::getNextTaskView(TaskView& view)
+{
+    if (next >= end)
+    {
+        view.clear();
+        return false;
+    }
+    
+    return tg->readTaskViewAt(tg->taskOrder[next++].pos, view);
+}
+
+void TaskCursor::setTaskOrderCurrent(TaskId tid)
+{
+    uint64 order;
+    if (!tg->findTaskOrder(tid, order) || order < next)
+    {
+        next = end;
+        return;
+    }
+    seekToOrderPosition(order);
+}
+
+void TaskCursor::seekToOrderPosition(uint64 pos)
+{
+    next = (pos < begin || pos > end) ? end : pos;
+}
+
+void TaskCursor::resetTaskOrder()
+{
+    next = begin;
+}
+
+bool TaskCursor::atEnd() const
+{
+    return next >= end;
+}
+
+ReverseTaskCursor::ReverseTaskCursor(TaskGraph* g, uint64 b, uint64 e) : tg(g), begin(b), end(e), next(e)
+{
+}
+
+Task* ReverseTaskCursor::getNextTask()
+{
+    if (next <= begin) return NULL;
+    
+    return tg->readTaskAt(tg->taskOrder[--next].pos);
+}
+
+bool ReverseTaskCursor::readNextInto(Task& task)
+{
+    if (next <= begin) return false;
+    
+    return tg->readTaskIntoAt(tg->taskOrder[--next].pos, task);
+}
+
+bool ReverseTaskCursor::getNextTaskView(TaskView& view)
+{
+    if (next <= begin)
+    {
+        view.clear();
+        return false;
+    }
+    
+    return tg->readTaskViewAt(tg->taskOrder[--next].pos, view);
+}
+
+void ReverseTaskCursor::setTaskOrderCurrent(TaskId tid)
+{
+    uint64 order;
+    if (!tg->findTaskOrder(tid, order) || order >= next)
+    {
+        next = begin;
+        return;
+    }
+    seekToOrderPosition(order);
+}
+
+void ReverseTaskCursor::seekToOrderPosition(uint64 pos)
+{
+    next = (pos < begin || pos >= end) ? begin : pos + 1;
+}
+
+void ReverseTaskCursor::resetTaskOrder()
+{
+    next = end;
+}
+
+bool ReverseTaskCursor::atEnd() const
+{
+    return next <= begin;
+}
+
+//
+// Context cursors walk the context's part of the lookup, each entry giving the
+//   task's position in the order and so its location
+//
+ContextCursor::ContextCursor(TaskGraph* g, ContextId c, uint64 f, uint64 n) : tg(g), ctx(c), first(f), count(n), next(0),
+                                                                             blockId(0), block(NULL)
+{
+}
+
+uint64 ContextCursor::nextPosition()
+{
+    uint64 order = tg->taskLookup[first + next++].order;
+    return tg->taskOrder[order].pos;
+}
+
+shared_ptr<TaskBlock> ContextCursor::getBlock(uint64 pos)
+{
+    if (block == NULL || blockId != TASK_BLOCK_NUMBER(pos))
+    {
+        blockId = TASK_BLOCK_NUMBER(pos);
+        block = tg->getBlock(blockId);
+    }
+    
+    return block;
+}
+
+Task* ContextCursor::getNextTask()
+{
+    if (next >= count) return NULL;
+    
+    uint64 pos = nextPosition();
+    if (!tg->hasBlocks()) return tg->readTaskAt(pos);
+    
+    shared_ptr<TaskBlock> b = getBlock(pos);
+    return (b == NULL) ? NULL : b->getTask(TASK_BLOCK_SLOT(pos));
+}
+
+bool ContextCursor::readNextInto(Task& task)
+{
+    if (next >= count) return false;
+    
+    uint64 pos = nextPosition();
+    if (!tg->hasBlocks()) return tg->readTaskIntoAt(pos, task);
+    
+    shared_ptr<TaskBlock> b = getBlock(pos);
+    return b != NULL && b->getTaskInto(TASK_BLOCK_SLOT(pos), task);
+}
+
+bool ContextCursor::getNextTaskView(TaskView& view)
+{
+    if (next >= count)
+    {
+        view.clear();
+        return false;
+    }
+    
+    uint64 pos = nextPosition();
+    if (!tg->hasBlocks()) return tg->readTaskViewAt(pos, view);
+    
+    shared_ptr<TaskBlock> b = getBlock(pos);
+    if (b == NULL || TASK_BLOCK_SLOT(pos) >= b->getTaskCount())
+    {
+        view.clear();
+        return false;
+    }
+    view = TaskView(b, TASK_BLOCK_SLOT(pos));
+    return true;
+}
+
+bool ContextCursor::peekNextTaskId(TaskId& tid) const
+{
+    if (next >= count) return false;
+    
+    tid = tg->taskLookup[first + next].tid;
+    return true;
+}
+
+void ContextCursor::setTaskOrderCurrent(TaskId tid)
+{
+    const TaskIndexLookup* b = tg->taskLookup + first;
+    const TaskIndexLookup* it = lower_bound(b, b + count, tid,
+                                            [](const TaskIndexLookup& a, TaskId t) { return a.tid < t; });
+    
+    if (it == b + count || it->tid != tid || (uint64)(it - b) < next)
+    {
+        next = count;
+        return;
+    }
+    next = it - b;
+}
+
+void ContextCursor::resetTaskOrder()
+{
+    next = 0;
+}
+
+bool ContextCursor::atEnd() const
+{
+    return next >= count;
+}
+
+ContextId ContextCursor::getContextId() const
+{
+    return ctx;
+}
+
+uint64 ContextCursor::getTaskCount() const
+{
+    return count;
 }
@@ -2,6 +2,8 @@
 #define TASK_GRAPH_HPP
 
 #include "Task.hpp"
+#include "TaskBlock.hpp"
+#include "TaskView.hpp"
 #include "TaskGraphInfo.hpp"
 #include "TaskId.hpp"
 #include "Action.hpp"
@@ -17,34 +19,303 @@
 #include <deque>
 #include <algorithm>
 #include <inttypes.h>
+#include <memory>
+#include <functional>
+#include <pthread.h>
 
-#define TASK_GRAPH_VERSION 4315
+// Version 1 compresses each task separately, version 2 groups tasks into TaskBlocks,
+//   version 3 adds the context count and a TaskId sorted lookup to the index,
+//   version 4 adds the dictionary of basic block sequences,
+//   version 5 stores the TaskGraphInfo as a section that is used where it is mapped,
+//   version 6 adds the address summary of each task
+#define TASK_GRAPH_VERSION_V1 4315
+#define TASK_GRAPH_VERSION_V2 4316
+#define TASK_GRAPH_VERSION_V3 4317
+#define TASK_GRAPH_VERSION_V4 4318
+#define TASK_GRAPH_VERSION_V5 4319
+#define TASK_GRAPH_VERSION_V6 4320
+#define TASK_GRAPH_VERSION TASK_GRAPH_VERSION_V6
+
+// Number of decoded blocks kept by the reader
+#define TASK_GRAPH_BLOCK_CACHE 4
+
+// Tasks read ahead of getNextTask, and the default limit on threads reading them
+#define TASK_GRAPH_PREFETCH_DEPTH 64
+#define TASK_GRAPH_PREFETCH_BATCH 8
+#define TASK_GRAPH_MAX_PREFETCH_THREADS 4
 
 using namespace std;
 namespace contech {
 
+class TaskGraph;
+
+//
+// The index of a task graph
+//
+//   Version 3 and later index, which starts 8 byte aligned:
+//     uint64 task count, uint64 context count,
+//     TaskIndexEntry[task count] in task order,
+//     TaskIndexLookup[task count] sorted by TaskId,
+//     uint64 block count, uint64 block offsets[block count],
+//     then the task summaries: uint64 task count, TaskSummary[task count]
+//     in task order, uint64 edge count, TaskId edges[edge count]
+//
+//   Version 4 is followed by the BasicBlockSequences of its tasks.
+//
+//   Version 6 is then 8 byte aligned again, and has the address summaries:
+//     uint64 task count, TaskAddressSummary[task count] in task order
+//
+//   Versions 1 and 2 only have the task count and the entries in task order,
+//     followed by the block offsets in version 2.
+//
+struct TaskIndexEntry
+{
+    TaskId tid;
+    uint64 pos;     // file offset, or block location for version 2 and later
+};
+
+struct TaskIndexLookup
+{
+    TaskId tid;
+    uint64 order;   // position of the task in the task order
+};
+
+// Fixed size summary of a task, for scans that do not need its actions
+struct TaskSummary
+{
+    TaskId taskId;
+    uint64 startTime;
+    uint64 endTime;
+    uint64 memOpCount;
+    uint64 edgeStart;   // first successor in the edges, the predecessors follow
+    uint32_t bbCount;
+    uint32_t succCount;
+    uint32_t predCount;
+    int32_t type;
+    int32_t syncType;
+    uint32_t sequenceId;
+};
+
+//
+// An independent position in the task order of a TaskGraph
+//   Each thread can walk the same graph with its own cursor
+//
+class TaskCursor
+{
+    friend class TaskGraph;
+    
+private:
+    TaskGraph* tg;
+    uint64 begin;   // the range of the order the cursor walks
+    uint64 end;
+    uint64 next;
+    
+    TaskCursor(TaskGraph*, uint64, uint64);
+    
+public:
+    Task* getNextTask();
+    bool readNextInto(Task& task);
+    bool getNextTaskView(TaskView& view);
+    void setTaskOrderCurrent(TaskId tid);
+    // Continue from a position in the task order, positions outside the range go to its end
+    void seekToOrderPosition(uint64 pos);
+    // Returns to the start of the range
+    void resetTaskOrder();
+    bool atEnd() const;
+};
+
+//
+// A position in the task order of a TaskGraph that walks it from the end
+//
+//   Every successor of a task is read before it, as the task order has every
+//   predecessor first, so backward analyses can stream the graph.  Tasks are
+//   decoded through the graph's shared block cache, as with the other cursors.
+//
+class ReverseTaskCursor
+{
+    friend class TaskGraph;
+    
+private:
+    TaskGraph* tg;
+    uint64 begin;   // the range of the order the cursor walks
+    uint64 end;
+    uint64 next;    // one past the position of the next task read
+    
+    ReverseTaskCursor(TaskGraph*, uint64, uint64);
+    
+public:
+    Task* getNextTask();
+    bool readNextInto(Task& task);
+    bool getNextTaskView(TaskView& view);
+    // Continue back from a task, tasks after the current position are not found
+    //   and go to the end, which is the start of the range
+    void setTaskOrderCurrent(TaskId tid);
+    // The next read returns the task at pos, positions outside the range go to the end
+    void seekToOrderPosition(uint64 pos);
+    // Returns to the last task of the range
+    void resetTaskOrder();
+    bool atEnd() const;
+};
+
+//
+// An independent position in the tasks of one context, in sequence order
+//   Reads only that context's tasks, rather than skipping the others in the task order
+//
+//   Blocks hold the tasks of every context in task order, so a cursor only reads
+//   the blocks that have its tasks, but each of those is decoded whole.  Reading
+//   n contexts can decode a block up to n times.  The cursor keeps its current
+//   block, so cursors read in turn do not evict each other's from the graph's
+//   few cached blocks.
+//
+class ContextCursor
+{
+    friend class TaskGraph;
+    
+private:
+    TaskGraph* tg;
+    ContextId ctx;
+    uint64 first;   // the context's tasks in the lookup
+    uint64 count;
+    uint64 next;
+    uint32_t blockId;
+    shared_ptr<TaskBlock> block;
+    
+    ContextCursor(TaskGraph*, ContextId, uint64, uint64);
+    // Position of the next task in the index, and its block for version 2 and later
+    uint64 nextPosition();
+    shared_ptr<TaskBlock> getBlock(uint64 pos);
+    
+public:
+    Task* getNextTask();
+    bool readNextInto(Task& task);
+    bool getNextTaskView(TaskView& view);
+    // The id of the task the next read returns, false at the end
+    bool peekNextTaskId(TaskId& tid) const;
+    // As with TaskCursor, earlier tasks are not found and go to the end
+    void setTaskOrderCurrent(TaskId tid);
+    void resetTaskOrder();
+    bool atEnd() const;
+    ContextId getContextId() const;
+    uint64 getTaskCount() const;
+};
+
 class TaskGraph
 {
+    friend class TaskCursor;
+    friend class ReverseTaskCursor;
+    friend class ContextCursor;
+    
 private:
     FILE* inputFile;
+    int inputFd;
     TaskGraphInfo* tgi;
+    uint version;
+    
+    // The input file is mapped when possible, otherwise it is read with pread
+    unsigned char* mapBase;
+    size_t mapLength;
+    
+    // The index, as the task order and a TaskId sorted lookup into the order
+    //   Version 3 stores both, so they are used in place when the file is mapped.
+    //   Older versions are read into the stores and the lookup is sorted on open.
+    const TaskIndexEntry* taskOrder;
+    const TaskIndexLookup* taskLookup;
+    uint64 taskCount;
+    vector<TaskIndexEntry> taskOrderStore;
+    vector<TaskIndexLookup> taskLookupStore;
+    uint64 nextTask;
+    
+    // Each context's tasks, which are contiguous and in sequence order in the lookup
+    struct ContextTasks
+    {
+        ContextId ctx;
+        uint64 first;
+        uint64 count;
+    };
+    vector<ContextTasks> contextTasks;
     
-    // Use an index to find each task in the graph
-    //   TaskId -> position in file
-    map<TaskId, uint64> taskIdx;
+    // Version 2 and later, file offset of each block and the recently decoded blocks
+    //   Blocks are shared with any TaskView that still refers to them
+    const uint64* blockOffsets;
+    uint64 blockCount;
+    vector<uint64> blockOffsetStore;
     
-    // Store the positions of each task
-    vector<uint64> taskOrder;
-    vector<uint64>::iterator nextTask;
+    // Task summaries in task order, with their successors and predecessors
+    //   Read from version 3 graphs, otherwise built by reading every task once
+    const TaskSummary* taskSummaries;
+    const TaskId* summaryEdges;
+    vector<TaskSummary> taskSummaryStore;
+    vector<TaskId> summaryEdgeStore;
+    pthread_mutex_t summaryLock;
+    
+    // Address summaries in task order, read from version 6 graphs, otherwise built
+    //   by reading every task once
+    const TaskAddressSummary* addressSummaries;
+    vector<TaskAddressSummary> addressSummaryStore;
+    
+    // Version 4, the basic block sequences that blocks are decoded with
+    BasicBlockSequences sequences;
+    map<uint32_t, shared_ptr<TaskBlock> > blockCache;
+    deque<uint32_t> blockCacheOrder;
+    set<uint32_t> blocksLoading;
+    pthread_mutex_t blockLock;
+    pthread_cond_t blockReady;
+    
+    // Prefetching, threads decode the tasks after nextTask into a ring
+    struct PrefetchSlot
+    {
+        Task* task;
+        bool ready;
+        PrefetchSlot() : task(NULL), ready(false) {}
+    };
+    int prefetchThreadCount;
+    vector<pthread_t> prefetchThreads;
+    vector<PrefetchSlot> prefetchRing;
+    vector<Task*> prefetchSpare;    // tasks from readNextInto, to read ahead into
+    size_t prefetchClaim;    // next position in taskOrder to be read ahead
+    size_t prefetchConsume;  // position of nextTask
+    bool prefetchStop;
+    pthread_mutex_t prefetchLock;
+    pthread_cond_t prefetchCond;
     
     TaskId ROIStart;
     TaskId ROIEnd;
+    // Positions of the ROI tasks in the order, found when the index is read
+    uint64 ROIStartPos;
+    uint64 ROIEndPos;
     
     unsigned int numOfContexts;
     
     // Privately, attempt to read a task graph info struct
     TaskGraphInfo* readTaskGraphInfo();
     void initTaskIndex(uint64);
+    template <typename T>
+    const T* getIndexArray(uint64, uint64, vector<T>&);
+    bool findTaskOrder(TaskId, uint64&);
+    void initContextTasks();
+    bool hasBlocks();
+    void initTaskSummaries(uint64);
+    void buildTaskSummaries();
+    void initSequences(uint64);
+    void initAddressSummaries(uint64);
+    void buildAddressSummaries();
+    void mapInputFile();
+    const unsigned char* getRecord(uint64, uint64&, uint64&, unsigned char*&);
+    Task* readTaskAt(uint64);
+    bool readTaskIntoAt(uint64, Task&);
+    bool readTaskViewAt(uint64, TaskView&);
+    bool readBlock(uint32_t, TaskBlock*);
+    shared_ptr<TaskBlock> getBlock(uint32_t);
+    
+    // Successors as positions in the task order, and the number of edges into each task
+    void buildOrderEdges(vector<uint64>&, vector<uint64>&, vector<uint32_t>&);
+    struct TopologicalRun;
+    static void* topologicalWorker(void*);
+    
+    static void* prefetchWorker(void*);
+    void startPrefetch();
+    void stopPrefetch();
+    Task* getNextPrefetchedTask();
     
     TaskGraph(FILE*);
 
@@ -55,9 +326,78 @@ public:
     
     Task* getNextTask();
     Task* getTaskById(TaskId id);
+    
+    // Read into an existing task, reusing its vectors rather than allocating a new one,
+    //   so a loop can read each task into the same Task
+    //   Return false at the end of the order or if the task is not found
+    bool readNextInto(Task& task);
+    bool readByIdInto(TaskId id, Task& task);
+    
+    // Zero-copy variants, the view refers to the decoded block
+    //   Return false at the end of the order or if the task is not found
+    bool getNextTaskView(TaskView& view);
+    bool getTaskViewById(TaskId id, TaskView& view);
+    
+    // Tasks can be read from any thread, each with its own cursor
+    TaskCursor getCursor();
+    // A cursor over the tasks from one task through another in the task order,
+    //   empty if either is not found or to is before from
+    TaskCursor rangeCursor(TaskId from, TaskId to);
+    // From the ROI start through the ROI end, or every task when the graph has no ROI
+    TaskCursor getROICursor();
+    // The same ranges in reverse task order, from the last task back to the first
+    ReverseTaskCursor getReverseCursor();
+    ReverseTaskCursor reverseRangeCursor(TaskId from, TaskId to);
+    ReverseTaskCursor getReverseROICursor();
+    
+    // Position of a task in the task order, false if it is not found
+    bool getOrderPosition(TaskId tid, uint64& pos);
+    // getNextTask continues from a position in the task order
+    void seekToOrderPosition(uint64 pos);
+    
+    // Version 2 and later, where the task at a position of the order is stored,
+    //   for tools that copy whole blocks.  False for earlier versions or positions.
+    bool getTaskLocation(uint64 pos, uint32_t& block, uint32_t& slot);
+    uint64 getBlockCount();
+    // A block as stored, returns NULL if it cannot be read.  Free buffer afterward.
+    const unsigned char* getCompressedBlock(uint32_t block, uint64& uncompLength, uint64& compLength,
+                                            unsigned char*& buffer);
+    
+    // Only the tasks of ctx, a context without tasks is immediately at its end
+    ContextCursor contextCursor(ContextId ctx);
+    // The contexts with tasks in the graph, in increasing order
+    vector<ContextId> getContextIds();
+    
+    // Summaries of every task in task order, without decoding any actions
+    Span<const TaskSummary> getTaskSummaries();
+    const TaskSummary* getTaskSummaryById(TaskId id);
+    Span<const TaskId> getSummarySuccessors(const TaskSummary& ts);
+    Span<const TaskId> getSummaryPredecessors(const TaskSummary& ts);
+    
+    // The addresses each task accesses in task order, see TaskAddressSummary
+    Span<const TaskAddressSummary> getAddressSummaries();
+    const TaskAddressSummary* getAddressSummaryById(TaskId id);
+    
+    // Group the tasks so that every predecessor of a task is in an earlier level
+    //   The tasks of level i are tasks[levelStarts[i]] up to tasks[levelStarts[i + 1]],
+    //   each level in task order.  Returns false if the edges have a cycle, and the
+    //   tasks on or after it are left out.
+    bool getTopologicalLevels(vector<TaskId>& tasks, vector<uint64>& levelStarts);
+    // Call f on every task from a pool of threads, each task once the calls on all
+    //   of its predecessors have returned.  f is called concurrently, with a task
+    //   that is only valid during the call.  Threads default to the processors.
+    //   Returns false without calling f if the edges have a cycle.
+    bool parallelForEachTopological(function<void(Task&)> f, int threads = 0);
+    
+    // The sequences of Task::getSequenceId, empty for graphs before version 4
+    const BasicBlockSequences& getBasicBlockSequences();
     void setTaskOrderCurrent(TaskId tid);
     void resetTaskOrder();
     
+    // Threads reading ahead of getNextTask, 0 to read each task on demand
+    //   Defaults to the spare processors, or CONTECH_PREFETCH_THREADS
+    void setPrefetchThreads(int n);
+    
     unsigned int getNumberOfTasks();
     unsigned int getNumberOfContexts();
     
@@ -67,8 +407,13 @@ public:
     
     TaskId getROIStart();
     TaskId getROIEnd();
+    // Positions of the ROI start and end in the task order
+    //   The start is 0 and the end is the last task when they are not found
+    uint64 getROIStartPosition();
+    uint64 getROIEndPosition();
     
     TaskGraphInfo* getTaskGraphInfo();
+    uint getVersion();
     ~TaskGraph();
 };
 
@@ -1,27 +1,88 @@
 #include "TaskGraphInfo.hpp"
+#include <string.h>
 
 using namespace contech;
 
+// The section is used in place, so the info must be its record
+static_assert(sizeof(BasicBlockInfo) == 8 * sizeof(uint), "BasicBlockInfo is not packed");
+
+TaskGraphInfo::TaskGraphInfo()
+{
+    // Id 0 is the empty string
+    stringOffsetStore.push_back(0);
+    stringStore.push_back('\0');
+    stringIds[string()] = 0;
+    useStores();
+}
+
+void TaskGraphInfo::useStores()
+{
+    bbInfo = bbInfoStore.data();
+    bbCount = bbInfoStore.size();
+    stringOffsets = stringOffsetStore.data();
+    stringCount = stringOffsetStore.size();
+    strings = stringStore.data();
+    stringBytes = stringStore.size();
+}
+
+//
+// Copy a mapped section into the stores, before info is added to it
+//
+void TaskGraphInfo::ownStorage()
+{
+    if (bbInfo != bbInfoStore.data())
+    {
+        bbInfoStore.assign(bbInfo, bbInfo + bbCount);
+    }
+    if (stringOffsets != stringOffsetStore.data())
+    {
+        stringOffsetStore.assign(stringOffsets, stringOffsets + stringCount);
+        stringStore.assign(strings, strings + stringBytes);
+    }
+    useStores();
+
+    if (stringIds.empty())
+    {
+        for (uint i = 0; i < stringCount; i++)
+        {
+            stringIds.insert(make_pair(string(strings + stringOffsets[i]), i));
+        }
+    }
+}
+
+uint TaskGraphInfo::internString(const string& s)
+{
+    auto it = stringIds.find(s);
+    if (it != stringIds.end()) return it->second;
+
+    uint id = stringOffsetStore.size();
+    stringOffsetStore.push_back(stringStore.size());
+    stringStore.insert(stringStore.end(), s.c_str(), s.c_str() + s.length() + 1);
+    stringIds[s] = id;
+
+    return id;
+}
+
 void TaskGraphInfo::initTaskGraphInfo(FILE* in)
 {
     int numBasicBlock = 0;
-    
+
     ct_read(&numBasicBlock, sizeof(int), in);
     for (int i = 0; i < numBasicBlock; i++)
-    {  
+    {
         uint strLen;
         uint bbid = 0, flags = 0;
         uint lineNumber, numOfMemOps, numOps, critPathLen;
         char* f;
         string function, file, callsFunction;
-        
+
         ct_read(&bbid, sizeof(uint), in);
         ct_read(&flags, sizeof(uint), in);
         ct_read(&lineNumber, sizeof(uint), in);
         ct_read(&numOfMemOps, sizeof(uint), in);
         ct_read(&numOps, sizeof(uint), in);
         ct_read(&critPathLen, sizeof(uint), in);
-        
+
         ct_read(&strLen, sizeof(uint), in);
         if (strLen > 0)
         {
@@ -31,7 +92,7 @@ void TaskGraphInfo::initTaskGraphInfo(FILE* in)
             function.assign(f);
             free(f);
         }
-        
+
         ct_read(&strLen, sizeof(uint), in);
         if (strLen > 0)
         {
@@ -41,7 +102,7 @@ void TaskGraphInfo::initTaskGraphInfo(FILE* in)
             file.assign(f);
             free(f);
         }
-        
+
         ct_read(&strLen, sizeof(uint), in);
         if (strLen > 0)
         {
@@ -51,74 +112,159 @@ void TaskGraphInfo::initTaskGraphInfo(FILE* in)
             callsFunction.assign(f);
             free(f);
         }
-        
+
         addRawBasicBlockInfo(bbid, flags, lineNumber, numOfMemOps, numOps, critPathLen, function, file, callsFunction);
     }
 }
 
-TaskGraphInfo::TaskGraphInfo()
+//
+// Every name is 0 terminated in the table, in order, and every id is in it
+//
+bool TaskGraphInfo::checkSection()
 {
+    if (stringCount == 0 || stringBytes == 0 || stringOffsets[0] != 0) return false;
+    if (strings[stringBytes - 1] != '\0') return false;
+    for (uint i = 0; i < stringCount; i++)
+    {
+        if (stringOffsets[i] >= stringBytes) return false;
+        if (i > 0 && stringOffsets[i] <= stringOffsets[i - 1]) return false;
+    }
+    for (uint i = 0; i < bbCount; i++)
+    {
+        const BasicBlockInfo& bbi = bbInfo[i];
+        if (bbi.functionId >= stringCount || bbi.fileId >= stringCount || bbi.callsFunctionId >= stringCount) return false;
+    }
 
+    return true;
 }
 
-void TaskGraphInfo::addRawBasicBlockInfo(uint bbid, 
-                                         uint flags, 
-                                         uint lineNum, 
-                                         uint numMemOps, 
-                                         uint numOps, 
-                                         uint critPathLen, 
-                                         string function, 
+bool TaskGraphInfo::readTaskGraphInfo(FILE* in)
+{
+    uint counts[3] = {0, 0, 0};
+
+    if (sizeof(counts) != ct_read(counts, sizeof(counts), in)) return false;
+
+    bbInfoStore.resize(counts[0]);
+    stringOffsetStore.resize(counts[1]);
+    stringStore.resize(counts[2]);
+    size_t pad = (4 - counts[2] % 4) % 4;
+    char padding[4];
+
+    if (counts[0] * sizeof(BasicBlockInfo) != ct_read(bbInfoStore.data(), counts[0] * sizeof(BasicBlockInfo), in) ||
+        counts[1] * sizeof(uint) != ct_read(stringOffsetStore.data(), counts[1] * sizeof(uint), in) ||
+        counts[2] != ct_read(stringStore.data(), counts[2], in) ||
+        pad != ct_read(padding, pad, in))
+    {
+        return false;
+    }
+
+    stringIds.clear();
+    useStores();
+
+    return checkSection();
+}
+
+bool TaskGraphInfo::mapTaskGraphInfo(const unsigned char* section, uint64_t length)
+{
+    uint counts[3];
+
+    if (length < sizeof(counts) || ((uintptr_t)section % sizeof(uint)) != 0) return false;
+    memcpy(counts, section, sizeof(counts));
+
+    uint64_t bbOff = sizeof(counts);
+    uint64_t offsetOff = bbOff + (uint64_t)counts[0] * sizeof(BasicBlockInfo);
+    uint64_t stringOff = offsetOff + (uint64_t)counts[1] * sizeof(uint);
+    if (stringOff + counts[2] > length) return false;
+
+    bbInfo = (const BasicBlockInfo*)(section + bbOff);
+    bbCount = counts[0];
+    stringOffsets = (const uint*)(section + offsetOff);
+    stringCount = counts[1];
+    strings = (const char*)(section + stringOff);
+    stringBytes = counts[2];
+
+    bbInfoStore.clear();
+    stringOffsetStore.clear();
+    stringStore.clear();
+    stringIds.clear();
+
+    return checkSection();
+}
+
+void TaskGraphInfo::addRawBasicBlockInfo(uint bbid,
+                                         uint flags,
+                                         uint lineNum,
+                                         uint numMemOps,
+                                         uint numOps,
+                                         uint critPathLen,
+                                         string function,
                                          string file,
                                          string inokFun)
 {
     BasicBlockInfo bbi;
-    
+
+    ownStorage();
+
     bbi.flags = flags;
     bbi.lineNumber = lineNum;
     bbi.numOfMemOps = numMemOps;
     bbi.numOfOps = numOps;
     bbi.critPathLen = critPathLen;
-    bbi.functionName = function;
-    bbi.fileName = file;
-    bbi.callsFunction = inokFun;
-    
-    bbInfo[bbid] = bbi;
+    bbi.functionId = internString(function);
+    bbi.fileId = internString(file);
+    bbi.callsFunctionId = internString(inokFun);
+
+    if (bbid >= bbInfoStore.size())
+    {
+        BasicBlockInfo none;
+        memset(&none, 0, sizeof(none));
+        none.lineNumber = ~0x0;
+        bbInfoStore.resize(bbid + 1, none);
+    }
+    bbInfoStore[bbid] = bbi;
+
+    useStores();
 }
 
 void TaskGraphInfo::writeTaskGraphInfo(FILE* out)
 {
-    int numBasicBlock = bbInfo.size();
-    ct_write(&numBasicBlock, sizeof(int), out);
-    for (auto it = bbInfo.begin(), et = bbInfo.end(); it != et; ++it)
-    {
-        uint strLen;
-        uint bbid = it->first;
-        ct_write(&bbid, sizeof(uint), out);
-        ct_write(&it->second.flags, sizeof(uint), out);
-        ct_write(&it->second.lineNumber, sizeof(uint), out);
-        ct_write(&it->second.numOfMemOps, sizeof(uint), out);
-        ct_write(&it->second.numOfOps, sizeof(uint), out);
-        ct_write(&it->second.critPathLen, sizeof(uint), out);
-        
-        strLen = it->second.functionName.length();
-        ct_write(&strLen, sizeof(uint), out);
-        ct_write(it->second.functionName.c_str(), sizeof(char) * strLen, out);
-        
-        strLen = it->second.fileName.length();
-        ct_write(&strLen, sizeof(uint), out);
-        ct_write(it->second.fileName.c_str(), sizeof(char) * strLen, out);
-        
-        strLen = it->second.callsFunction.length();
-        ct_write(&strLen, sizeof(uint), out);
-        ct_write(it->second.callsFunction.c_str(), sizeof(char) * strLen, out);
-    }
+    uint counts[3] = {bbCount, stringCount, stringBytes};
+    size_t pad = (4 - stringBytes % 4) % 4;
+    char padding[4] = {0, 0, 0, 0};
+
+    ct_write(counts, sizeof(counts), out);
+    ct_write(bbInfo, bbCount * sizeof(BasicBlockInfo), out);
+    ct_write(stringOffsets, stringCount * sizeof(uint), out);
+    ct_write(strings, stringBytes, out);
+    ct_write(padding, pad, out);
+}
+
+const BasicBlockInfo& TaskGraphInfo::getBasicBlockInfo(uint bbid)
+{
+    static BasicBlockInfo bbi = {(uint)~0x0, 0, 0, 0, 0, 0, 0, 0};
+    if (bbid >= bbCount) return bbi;
+    return bbInfo[bbid];
+}
+
+uint TaskGraphInfo::getBasicBlockCount()
+{
+    return bbCount;
+}
+
+const char* TaskGraphInfo::getString(uint id)
+{
+    if (id >= stringCount) return "";
+    return strings + stringOffsets[id];
+}
+
+uint TaskGraphInfo::getStringLength(uint id)
+{
+    if (id >= stringCount) return 0;
+    uint end = (id + 1 < stringCount) ? stringOffsets[id + 1] : stringBytes;
+    return end - stringOffsets[id] - 1;
 }
 
-BasicBlockInfo& TaskGraphInfo::getBasicBlockInfo(uint bbid)
+uint TaskGraphInfo::getStringCount()
 {
-    static BasicBlockInfo bbi;
-    bbi.lineNumber = ~0x0;
-    auto it = bbInfo.find(bbid);
-    if (it == bbInfo.end()) return bbi;
-    return it->second;
+    return stringCount;
 }
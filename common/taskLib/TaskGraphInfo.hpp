@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <string>
 #include <inttypes.h>
@@ -21,6 +22,10 @@ namespace contech {
 #define BBI_FLAG_CONTAIN_CALL 0x1
 #define BBI_FLAG_CONTAIN_GLOBAL_ACCESS 0x2
 
+//
+// The names are ids in the string table of the TaskGraphInfo, where 0 is the
+//   empty string, so that the info is a fixed size and names compare by id
+//
 class BasicBlockInfo
 {
 public:
@@ -29,9 +34,9 @@ public:
     uint numOfOps;
     uint critPathLen;
     uint flags;
-    string functionName;
-    string fileName;
-    string callsFunction;
+    uint functionId;
+    uint fileId;
+    uint callsFunctionId;
     //vector <uint> typeOfMemOps;
 };
 
@@ -49,24 +54,67 @@ class TypeInfo
     size_t sizeOfType;
 };
 
+//
+// The basic block info of a task graph
+//
+//   The info is a vector indexed by bbid, and a table of the function and file
+//   names, each stored once.  Version 5 and later graphs store it as a section
+//   that can be used where it is mapped, of 4 byte words:
+//     uint bbCount, uint stringCount, uint stringBytes,
+//     BasicBlockInfo[bbCount], uint stringOffsets[stringCount],
+//     char strings[stringBytes], each 0 terminated, padded to 4 bytes
+//   Blocks without info have a lineNumber of ~0.  Older graphs have a record
+//   for each block, with the names inline.
+//
 class TaskGraphInfo
 {
 private:
-    map <uint, BasicBlockInfo> bbInfo;
+    // Either the arrays of a mapped section, or the stores
+    const BasicBlockInfo* bbInfo;
+    uint bbCount;
+    const uint* stringOffsets;
+    uint stringCount;
+    const char* strings;
+    uint stringBytes;
+
+    vector<BasicBlockInfo> bbInfoStore;
+    vector<uint> stringOffsetStore;
+    vector<char> stringStore;
+    // Interns the names as info is added
+    unordered_map<string, uint> stringIds;
+
     //map <uint, TypeInfo> tyInfo;
     //map <uint, FunctionInfo> funInfo;
-    //map <uint, string> fileName;
-    
+
+    void useStores();
+    void ownStorage();
+    uint internString(const string&);
+    bool checkSection();
+
 public:
+    // Older versions, with a record for each block
     void initTaskGraphInfo(FILE*);
+    // The section of version 5 and later, either read or used in place
+    //   The mapping must remain while the info is used.  Returns false if the
+    //   section is malformed.
+    bool readTaskGraphInfo(FILE*);
+    bool mapTaskGraphInfo(const unsigned char* section, uint64_t length);
     TaskGraphInfo();
-    
+
     void addRawBasicBlockInfo(uint bbid, uint flags, uint lineNum, uint numMemOps, uint numOps, uint critPathLen, string function, string file, string);
+    // Writes the section of the current version
     void writeTaskGraphInfo(FILE*);
-    
-    BasicBlockInfo& getBasicBlockInfo(uint bbid);
+
+    const BasicBlockInfo& getBasicBlockInfo(uint bbid);
+    // One more than the largest bbid with info
+    uint getBasicBlockCount();
+
+    // A 0 terminated name, or the empty string for an unknown id
+    const char* getString(uint id);
+    uint getStringLength(uint id);
+    uint getStringCount();
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
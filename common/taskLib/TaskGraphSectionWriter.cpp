@@ -0,0 +1,381 @@
+#include "TaskGraphSectionWriter.hpp"
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace contech;
+
+TaskGraphSectionWriter::TaskGraphSectionWriter(FILE* f) : out(f)
+{
+    block = new TaskBlock();
+    blocksSubmitted = 0;
+    summaryFile = tmpfile();
+    edgeFile = tmpfile();
+    addressFile = tmpfile();
+    assert(summaryFile != NULL && edgeFile != NULL && addressFile != NULL &&
+           "Could not create temporary summary files");
+    summaryCount = 0;
+    edgeTotal = 0;
+    compressThreadCount = 0;
+    compressExit = false;
+    pthread_mutex_init(&compressLock, NULL);
+    pthread_cond_init(&compressWorkCond, NULL);
+    pthread_cond_init(&compressDoneCond, NULL);
+}
+
+TaskGraphSectionWriter::~TaskGraphSectionWriter()
+{
+    if (block != NULL) finishBlocks();
+    // Temporary files are removed on close
+    fclose(summaryFile);
+    fclose(edgeFile);
+    fclose(addressFile);
+    pthread_mutex_destroy(&compressLock);
+    pthread_cond_destroy(&compressWorkCond);
+    pthread_cond_destroy(&compressDoneCond);
+}
+
+void TaskGraphSectionWriter::setCompressThreads(int n)
+{
+    assert(compressThreads.empty());
+    compressThreadCount = max(0, n);
+}
+
+int TaskGraphSectionWriter::getCompressThreads() const
+{
+    return compressThreadCount;
+}
+
+uint64 TaskGraphSectionWriter::addTask(Task& t)
+{
+    assert(block != NULL);
+    uint64 location = TASK_BLOCK_LOCATION(blocksSubmitted, block->addTask(t, &sequences));
+
+    if (block->isFull())
+    {
+        submitBlock();
+        writeCompressedBlocks(compressThreadCount + 1, false);
+    }
+
+    return location;
+}
+
+uint64 TaskGraphSectionWriter::addCompressedBlock(const unsigned char* comp, uint64 uncompLength, uint64 compLength)
+{
+    CompressJob* job = new CompressJob;
+
+    assert(block != NULL);
+    if (block->getTaskCount() > 0)
+    {
+        submitBlock();
+    }
+
+    // The copy is queued behind the blocks being compressed
+    job->block = NULL;
+    job->comp = (unsigned char*) malloc(compLength);
+    assert(job->comp != NULL);
+    memcpy(job->comp, comp, compLength);
+    job->uncompLength = uncompLength;
+    job->compLength = compLength;
+    job->done = true;
+    inFlight.push_back(job);
+    blocksSubmitted++;
+
+    writeCompressedBlocks(compressThreadCount + 1, false);
+
+    return blocksSubmitted - 1;
+}
+
+bool TaskGraphSectionWriter::hasPartialBlock() const
+{
+    return block != NULL && block->getTaskCount() > 0;
+}
+
+void TaskGraphSectionWriter::finishBlocks()
+{
+    if (block == NULL) return;
+
+    // Write the last, partial block
+    if (block->getTaskCount() > 0)
+    {
+        submitBlock();
+    }
+    delete block;
+    block = NULL;
+    writeCompressedBlocks(0, true);
+    stopCompressThreads();
+    assert(blockOffsets.size() == blocksSubmitted);
+}
+
+uint64 TaskGraphSectionWriter::getBlockCount() const
+{
+    return blocksSubmitted + (hasPartialBlock() ? 1 : 0);
+}
+
+BasicBlockSequences& TaskGraphSectionWriter::getSequences()
+{
+    return sequences;
+}
+
+const BasicBlockSequences& TaskGraphSectionWriter::getSequences() const
+{
+    return sequences;
+}
+
+void TaskGraphSectionWriter::startCompressThreads()
+{
+    compressThreads.resize(compressThreadCount);
+    for (pthread_t& ct : compressThreads)
+    {
+        int r = pthread_create(&ct, NULL, compressWorker, this);
+        assert(r == 0);
+    }
+}
+
+void TaskGraphSectionWriter::stopCompressThreads()
+{
+    pthread_mutex_lock(&compressLock);
+    compressExit = true;
+    pthread_cond_broadcast(&compressWorkCond);
+    pthread_mutex_unlock(&compressLock);
+    for (pthread_t& ct : compressThreads)
+    {
+        pthread_join(ct, NULL);
+    }
+    compressThreads.clear();
+}
+
+//
+// Claim and compress the oldest pending block
+//
+//   compressLock must be held, it is released while compressing.
+//   Returns false if there is no pending block.
+//
+bool TaskGraphSectionWriter::compressNextJob()
+{
+    if (compressPending.empty()) return false;
+
+    CompressJob* job = compressPending.front();
+    compressPending.pop_front();
+    pthread_mutex_unlock(&compressLock);
+    job->comp = job->block->compress(job->uncompLength, job->compLength);
+    pthread_mutex_lock(&compressLock);
+    job->done = true;
+    pthread_cond_broadcast(&compressDoneCond);
+
+    return true;
+}
+
+void* TaskGraphSectionWriter::compressWorker(void* v)
+{
+    TaskGraphSectionWriter* w = (TaskGraphSectionWriter*)v;
+
+    pthread_mutex_lock(&w->compressLock);
+    while (!w->compressExit)
+    {
+        if (!w->compressNextJob())
+        {
+            pthread_cond_wait(&w->compressWorkCond, &w->compressLock);
+        }
+    }
+    pthread_mutex_unlock(&w->compressLock);
+
+    return NULL;
+}
+
+void TaskGraphSectionWriter::submitBlock()
+{
+    CompressJob* job = new CompressJob;
+
+    if (compressThreads.empty() && compressThreadCount > 0) startCompressThreads();
+
+    job->block = block;
+    job->comp = NULL;
+    job->done = false;
+    inFlight.push_back(job);
+    blocksSubmitted++;
+    block = new TaskBlock();
+
+    pthread_mutex_lock(&compressLock);
+    compressPending.push_back(job);
+    pthread_cond_signal(&compressWorkCond);
+    pthread_mutex_unlock(&compressLock);
+}
+
+//
+// Write the compressed blocks at the front of inFlight
+//
+//   Stops at the first block that is not compressed, unless too many blocks are in
+//   flight or drain is set, then it helps compress until the block is ready.
+//
+void TaskGraphSectionWriter::writeCompressedBlocks(size_t maxInFlight, bool drain)
+{
+    pthread_mutex_lock(&compressLock);
+    while (!inFlight.empty())
+    {
+        CompressJob* job = inFlight.front();
+        if (!job->done)
+        {
+            if (!drain && inFlight.size() <= maxInFlight) break;
+            if (!compressNextJob())
+            {
+                pthread_cond_wait(&compressDoneCond, &compressLock);
+            }
+            continue;
+        }
+        pthread_mutex_unlock(&compressLock);
+
+        inFlight.pop_front();
+        blockOffsets.push_back(ftell(out));
+        TaskBlock::writeCompressed(job->comp, job->uncompLength, job->compLength, out);
+        free(job->comp);
+        delete job->block;
+        delete job;
+
+        pthread_mutex_lock(&compressLock);
+    }
+    pthread_mutex_unlock(&compressLock);
+}
+
+void TaskGraphSectionWriter::addSummary(const TaskSummary& ts, const TaskAddressSummary& tas,
+                                        Span<const TaskId> succ, Span<const TaskId> pred)
+{
+    TaskSummary copy = ts;
+
+    copy.edgeStart = edgeTotal;
+    copy.succCount = succ.size();
+    copy.predCount = pred.size();
+    ct_write(&copy, sizeof(copy), summaryFile);
+    if (!succ.empty()) ct_write(succ.data(), succ.size() * sizeof(TaskId), edgeFile);
+    if (!pred.empty()) ct_write(pred.data(), pred.size() * sizeof(TaskId), edgeFile);
+    ct_write(&tas, sizeof(tas), addressFile);
+    edgeTotal += succ.size() + pred.size();
+    summaryCount++;
+}
+
+uint64 TaskGraphSectionWriter::getSummaryCount() const
+{
+    return summaryCount;
+}
+
+bool TaskGraphSectionWriter::checkEdges(const TaskIndexLookup* lookup)
+{
+    size_t summaryLen = summaryCount * sizeof(TaskSummary), edgeLen = edgeTotal * sizeof(TaskId);
+    const TaskSummary* summaries = (const TaskSummary*) mapTempFile(summaryFile, summaryLen, false);
+    const TaskId* edges = (const TaskId*) mapTempFile(edgeFile, edgeLen, false);
+    auto findOrder = [&](TaskId tid, uint64& order) {
+        const TaskIndexLookup* it = lower_bound(lookup, lookup + summaryCount, tid,
+                                                [](const TaskIndexLookup& a, TaskId b) { return a.tid < b; });
+        if (it == lookup + summaryCount || it->tid != tid) return false;
+        order = it->order;
+        return true;
+    };
+    bool valid = true;
+
+    for (uint64 i = 0; i < summaryCount; i++)
+    {
+        const TaskSummary& ts = summaries[i];
+        for (uint32_t e = 0; e < ts.succCount + ts.predCount; e++)
+        {
+            TaskId other = edges[ts.edgeStart + e];
+            uint64 order;
+            if (!findOrder(other, order))
+            {
+                fprintf(stderr, "Task %s has an edge to %s, which is not in the graph\n",
+                        ts.taskId.toString().c_str(), other.toString().c_str());
+                valid = false;
+            }
+            else if ((e < ts.succCount) ? (order <= i) : (order >= i))
+            {
+                fprintf(stderr, "Task %s has an edge to %s, which is out of order\n",
+                        ts.taskId.toString().c_str(), other.toString().c_str());
+                valid = false;
+            }
+        }
+    }
+
+    if (summaries != NULL) munmap((void*)summaries, summaryLen);
+    if (edges != NULL) munmap((void*)edges, edgeLen);
+
+    return valid;
+}
+
+//
+// The index is aligned, so readers can use it in place from a mapping
+//
+uint64 TaskGraphSectionWriter::startIndex()
+{
+    long pos = ftell(out);
+    if (pos == -1)
+    {
+        perror("Cannot identify index position");
+        return 0;
+    }
+    if (pos % sizeof(uint64) != 0)
+    {
+        uint64 pad = 0;
+        ct_write(&pad, sizeof(uint64) - pos % sizeof(uint64), out);
+        pos += sizeof(uint64) - pos % sizeof(uint64);
+    }
+
+    return pos;
+}
+
+void TaskGraphSectionWriter::writeSections()
+{
+    assert(block == NULL);
+
+    // The block offsets follow the index
+    uint64 blockCount = blockOffsets.size();
+    ct_write(&blockCount, sizeof(uint64), out);
+    ct_write(blockOffsets.data(), blockCount * sizeof(uint64), out);
+
+    // Then the summaries, for scans that do not need the actions
+    ct_write(&summaryCount, sizeof(uint64), out);
+    copyTempFile(summaryFile, out);
+    ct_write(&edgeTotal, sizeof(uint64), out);
+    copyTempFile(edgeFile, out);
+
+    // And the basic block sequences, which the blocks are decoded with
+    sequences.write(out);
+
+    // And what each task accesses, aligned so it can be used from a mapping
+    long pos = ftell(out);
+    if (pos % sizeof(uint64) != 0)
+    {
+        uint64 pad = 0;
+        ct_write(&pad, sizeof(uint64) - pos % sizeof(uint64), out);
+    }
+    ct_write(&summaryCount, sizeof(uint64), out);
+    copyTempFile(addressFile, out);
+}
+
+void TaskGraphSectionWriter::writeHeader(uint64 indexOffset, TaskId roiStart, TaskId roiEnd)
+{
+    // After the version
+    fseek(out, sizeof(int), SEEK_SET);
+    ct_write(&indexOffset, sizeof(uint64), out);
+    ct_write(&roiStart, sizeof(TaskId), out);
+    ct_write(&roiEnd, sizeof(TaskId), out);
+}
+
+void* contech::mapTempFile(FILE* f, size_t length, bool writable)
+{
+    if (length == 0) return NULL;
+    fflush(f);
+    void* m = mmap(NULL, length, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fileno(f), 0);
+    assert(m != MAP_FAILED);
+    return m;
+}
+
+void contech::copyTempFile(FILE* in, FILE* out)
+{
+    char buf[64 * 1024];
+    size_t r;
+
+    fflush(in);
+    rewind(in);
+    while ((r = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        ct_write(buf, r, out);
+    }
+}
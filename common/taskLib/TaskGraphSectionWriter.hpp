@@ -0,0 +1,118 @@
+#ifndef CONTECH_TASK_GRAPH_SECTION_WRITER_HPP
+#define CONTECH_TASK_GRAPH_SECTION_WRITER_HPP
+
+#include "TaskGraph.hpp"
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace contech
+{
+
+//
+// Writes the blocks of a task graph, and the sections that follow its index
+//
+//   Used by the middle layer and by TaskGraphWriter, which each write the header
+//   and the index in their own task order.  Tasks are grouped into TaskBlocks with
+//   the writer's basic block sequences.  Full blocks are compressed by a pool of
+//   threads, and by the caller while it waits, and are written in order, so the
+//   file does not depend on the number of threads.
+//
+//   The summaries, edges and address summaries of the tasks are appended in task
+//   order to temporary files, and copied from there by writeSections.  The graph
+//   is then laid out as:
+//     header, info, blocks, index (from the caller),
+//     uint64 block count, uint64 block offsets[block count],
+//     uint64 task count, TaskSummary[task count], uint64 edge count, TaskId edges[edge count],
+//     basic block sequences,
+//     padding to 8 bytes, uint64 task count, TaskAddressSummary[task count]
+//
+class TaskGraphSectionWriter
+{
+private:
+    struct CompressJob
+    {
+        TaskBlock*     block;
+        unsigned char* comp;
+        uint64         uncompLength;
+        uint64         compLength;
+        bool           done;
+    };
+
+    FILE* out;
+
+    TaskBlock* block;
+    uint64 blocksSubmitted;
+    BasicBlockSequences sequences;
+    vector<uint64> blockOffsets;
+
+    FILE* summaryFile;
+    FILE* edgeFile;
+    FILE* addressFile;
+    uint64 summaryCount;
+    uint64 edgeTotal;
+
+    // The writer's blocks, oldest first, and the blocks no thread has claimed
+    int compressThreadCount;
+    vector<pthread_t> compressThreads;
+    deque<CompressJob*> inFlight;
+    deque<CompressJob*> compressPending;
+    bool compressExit;
+    pthread_mutex_t compressLock;
+    pthread_cond_t compressWorkCond;
+    pthread_cond_t compressDoneCond;
+
+    void startCompressThreads();
+    void stopCompressThreads();
+    bool compressNextJob();
+    static void* compressWorker(void*);
+    void submitBlock();
+    void writeCompressedBlocks(size_t maxInFlight, bool drain);
+
+public:
+    TaskGraphSectionWriter(FILE*);
+    // Finishes the blocks if they have not been
+    ~TaskGraphSectionWriter();
+
+    // Threads compressing blocks, set before the first block is full
+    void setCompressThreads(int n);
+    int getCompressThreads() const;
+
+    // Add a task to the current block, returns its location for the index
+    //   The task's sequence id is that of the new graph afterward.
+    uint64 addTask(Task& t);
+    // Append a block as it is stored, returns its number
+    uint64 addCompressedBlock(const unsigned char* comp, uint64 uncompLength, uint64 compLength);
+    // True if tasks have been added since the last block was submitted
+    bool hasPartialBlock() const;
+    // Write the last block and every block still being compressed
+    void finishBlocks();
+    uint64 getBlockCount() const;
+    BasicBlockSequences& getSequences();
+    const BasicBlockSequences& getSequences() const;
+
+    // Append the summary of the next task in the order
+    //   Its edge start and counts are set from the edges.
+    void addSummary(const TaskSummary& ts, const TaskAddressSummary& tas,
+                    Span<const TaskId> succ, Span<const TaskId> pred);
+    uint64 getSummaryCount() const;
+    // Each successor must be later in the task order, and each predecessor earlier
+    //   The lookup has an entry for each summary, sorted by TaskId.
+    bool checkEdges(const TaskIndexLookup* lookup);
+
+    // Pad to where the index starts, returns its offset
+    uint64 startIndex();
+    // Write the sections after the index, once the blocks are finished
+    void writeSections();
+    // Fill in the index offset and the ROI of the header
+    void writeHeader(uint64 indexOffset, TaskId roiStart, TaskId roiEnd);
+};
+
+// Map a temporary file, NULL if it is empty
+void* mapTempFile(FILE* f, size_t length, bool writable);
+// Append the whole of a temporary file to out
+void copyTempFile(FILE* in, FILE* out);
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "TaskGraphWriter.hpp"
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <sys/mman.h>
+
+using namespace contech;
+
+TaskGraphWriter::TaskGraphWriter(FILE* f, TaskGraphInfo* info) : out(f), tgi(info), sections(f)
+{
+    roiStart = 0;
+    roiEnd = 0;
+    roiSet = false;
+    closed = false;
+    copiedBlock = 0;
+    indexFile = tmpfile();
+    lookupFile = tmpfile();
+    assert(indexFile != NULL && lookupFile != NULL && "Could not create temporary task files");
+    taskCount = 0;
+
+    // By default, leave a processor for the thread adding tasks
+    int compressThreadCount = get_nprocs() - 1;
+    if (compressThreadCount > TASK_GRAPH_WRITER_MAX_THREADS) compressThreadCount = TASK_GRAPH_WRITER_MAX_THREADS;
+    if (char* wt = getenv("CONTECH_WRITER_THREADS"))
+    {
+        compressThreadCount = atoi(wt);
+    }
+    sections.setCompressThreads(compressThreadCount);
+
+    // Header, the index offset and the ROI are written by close
+    int taskGraphVersion = TASK_GRAPH_VERSION;
+    uint64 indexOffset = 0;
+    ct_write(&taskGraphVersion, sizeof(int), out);
+    ct_write(&indexOffset, sizeof(uint64), out);
+    ct_write(&roiStart, sizeof(TaskId), out);
+    ct_write(&roiEnd, sizeof(TaskId), out);
+    tgi->writeTaskGraphInfo(out);
+}
+
+TaskGraphWriter* TaskGraphWriter::initToFile(const char* fname, TaskGraphInfo* info)
+{
+    FILE* f = fopen(fname, "wb");
+    if (f == NULL) return NULL;
+    return new TaskGraphWriter(f, info);
+}
+
+TaskGraphWriter::~TaskGraphWriter()
+{
+    if (!closed) close();
+    // Temporary files are removed on close
+    fclose(indexFile);
+    fclose(lookupFile);
+}
+
+void TaskGraphWriter::setROI(TaskId start, TaskId end)
+{
+    roiStart = start;
+    roiEnd = end;
+    roiSet = true;
+}
+
+void TaskGraphWriter::setCompressThreads(int n)
+{
+    sections.setCompressThreads(n);
+}
+
+//
+// Append a task's index and lookup entries, and its summary
+//
+void TaskGraphWriter::appendTask(const TaskSummary& ts, const TaskAddressSummary& tas,
+                                 Span<const TaskId> succ, Span<const TaskId> pred, uint64 location)
+{
+    TaskIndexEntry e = {ts.taskId, location};
+    TaskIndexLookup l = {ts.taskId, taskCount};
+
+    ct_write(&e, sizeof(e), indexFile);
+    ct_write(&l, sizeof(l), lookupFile);
+    sections.addSummary(ts, tas, succ, pred);
+
+    if (taskCount == 0) firstTid = ts.taskId;
+    lastTid = ts.taskId;
+    taskCount++;
+}
+
+void TaskGraphWriter::addTask(Task& t)
+{
+    assert(!closed);
+    uint64 location = sections.addTask(t);
+
+    TaskSummary ts;
+    memset((void*)&ts, 0, sizeof(ts));
+    ts.taskId = t.getTaskId();
+    ts.startTime = t.getStartTime();
+    ts.endTime = t.getEndTime();
+    ts.memOpCount = t.getMemOpCount();
+    ts.bbCount = t.getBBCount();
+    ts.type = t.getType();
+    ts.syncType = t.getSyncType();
+    ts.sequenceId = t.getSequenceId();
+    vector<TaskId>& succ = t.getSuccessorTasks();
+    vector<TaskId>& pred = t.getPredecessorTasks();
+    appendTask(ts, t.getAddressSummary(), Span<const TaskId>(succ.data(), succ.size()),
+               Span<const TaskId>(pred.data(), pred.size()), location);
+}
+
+void TaskGraphWriter::setBasicBlockSequences(const BasicBlockSequences& seq)
+{
+    assert(taskCount == 0);
+    sections.getSequences() = seq;
+    sections.getSequences().indexSequences();
+}
+
+void TaskGraphWriter::addCompressedBlock(const unsigned char* comp, uint64 uncompLength, uint64 compLength)
+{
+    assert(!closed);
+    copiedBlock = sections.addCompressedBlock(comp, uncompLength, compLength);
+}
+
+void TaskGraphWriter::addBlockTask(const TaskSummary& ts, const TaskAddressSummary& tas,
+                                   Span<const TaskId> succ, Span<const TaskId> pred, uint32_t slot)
+{
+    assert(!closed && sections.getBlockCount() > 0 && !sections.hasPartialBlock());
+    appendTask(ts, tas, succ, pred, TASK_BLOCK_LOCATION(copiedBlock, slot));
+}
+
+bool TaskGraphWriter::close()
+{
+    if (closed) return false;
+    closed = true;
+
+    sections.finishBlocks();
+    uint64 indexOffset = sections.startIndex();
+
+    // The lookup is sorted by TaskId in place, in its mapping
+    size_t lookupLen = taskCount * sizeof(TaskIndexLookup);
+    TaskIndexLookup* lookup = (TaskIndexLookup*) mapTempFile(lookupFile, lookupLen, true);
+    sort(lookup, lookup + taskCount,
+         [](const TaskIndexLookup& a, const TaskIndexLookup& b) { return a.tid < b.tid; });
+    uint64 contextCount = 0;
+    for (uint64 i = 0; i < taskCount; i++)
+    {
+        if (i == 0 || lookup[i].tid.getContextId() != lookup[i - 1].tid.getContextId()) contextCount++;
+    }
+    bool valid = sections.checkEdges(lookup);
+
+    ct_write(&taskCount, sizeof(uint64), out);
+    ct_write(&contextCount, sizeof(uint64), out);
+    copyTempFile(indexFile, out);
+    if (lookup != NULL)
+    {
+        ct_write(lookup, lookupLen, out);
+        munmap(lookup, lookupLen);
+    }
+    sections.writeSections();
+
+    if (!roiSet && taskCount > 0)
+    {
+        roiStart = firstTid;
+        roiEnd = lastTid;
+    }
+    sections.writeHeader(indexOffset, roiStart, roiEnd);
+    fclose(out);
+    out = NULL;
+
+    return valid;
+}
+
+uint64 TaskGraphWriter::getTaskCount() const
+{
+    return taskCount;
+}
+
+uint64 TaskGraphWriter::getBlockCount() const
+{
+    return sections.getBlockCount();
+}
+
+uint32_t TaskGraphWriter::getSequenceCount() const
+{
+    return sections.getSequences().getSequenceCount();
+}
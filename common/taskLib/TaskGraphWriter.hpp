@@ -0,0 +1,89 @@
+#ifndef CONTECH_TASK_GRAPH_WRITER_HPP
+#define CONTECH_TASK_GRAPH_WRITER_HPP
+
+#include "TaskGraph.hpp"
+#include "TaskGraphSectionWriter.hpp"
+
+// Default limit on the threads compressing blocks
+#define TASK_GRAPH_WRITER_MAX_THREADS 8
+
+namespace contech
+{
+
+//
+// Writes a task graph of the current version
+//
+//   Tasks are added in task order, which must have every predecessor of a task
+//   before it.  Their blocks, summaries and the sections after the index are
+//   written by a TaskGraphSectionWriter.  The index and the lookup are written by
+//   close, and then the index offset in the header is filled in.
+//
+//   The index and lookup entries of the tasks are appended to temporary files, as
+//   the summaries are, and are mapped or copied from there by close.  So a backend
+//   can write out a graph of any size as it reads one.  Tools that keep whole
+//   blocks of a graph can copy them without compressing them again.
+//
+class TaskGraphWriter
+{
+private:
+    FILE* out;
+    TaskGraphInfo* tgi;
+    TaskId roiStart;
+    TaskId roiEnd;
+    bool roiSet;
+    bool closed;
+
+    TaskGraphSectionWriter sections;
+    uint64 copiedBlock;
+
+    // Temporary files of each task's index entry and lookup entry, in task order
+    FILE* indexFile;
+    FILE* lookupFile;
+    uint64 taskCount;
+    TaskId firstTid;
+    TaskId lastTid;
+
+    TaskGraphWriter(FILE*, TaskGraphInfo*);
+
+    void appendTask(const TaskSummary& ts, const TaskAddressSummary& tas,
+                    Span<const TaskId> succ, Span<const TaskId> pred, uint64 location);
+
+public:
+    // Writes the header and the info, returns NULL if the file cannot be created
+    //   The writer does not own the info, which must remain until close.
+    static TaskGraphWriter* initToFile(const char*, TaskGraphInfo*);
+    // Closes the graph if it has not been closed
+    ~TaskGraphWriter();
+
+    // Defaults to the first and last task added
+    void setROI(TaskId start, TaskId end);
+    // Threads compressing blocks, set before the first task is added
+    //   Defaults to the spare processors, or CONTECH_WRITER_THREADS
+    void setCompressThreads(int n);
+
+    // Append a task, which can be reused once this returns
+    //   The task's sequence id is that of the new graph afterward.
+    void addTask(Task& t);
+
+    // Start from the sequences of another graph, before the first task is added,
+    //   so that blocks of that graph can be copied with addCompressedBlock
+    void setBasicBlockSequences(const BasicBlockSequences& seq);
+    // Append a block of a version 4 or later graph as it is stored, without decoding it
+    //   Each of its tasks is then added in task order with addBlockTask.
+    void addCompressedBlock(const unsigned char* comp, uint64 uncompLength, uint64 compLength);
+    void addBlockTask(const TaskSummary& ts, const TaskAddressSummary& tas,
+                      Span<const TaskId> succ, Span<const TaskId> pred, uint32_t slot);
+
+    // Write the index, summaries and sequences, and close the file
+    //   Returns false if an edge refers to a task that is missing or not later
+    //   in the task order, as the graph would not be readable in order.
+    bool close();
+
+    uint64 getTaskCount() const;
+    uint64 getBlockCount() const;
+    uint32_t getSequenceCount() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include "TaskView.hpp"
+
+using namespace std;
+using namespace contech;
+
+TaskView::TaskView() : entry(NULL), slot(0), actions(NULL), succ(NULL), pred(NULL)
+{
+}
+
+TaskView::TaskView(shared_ptr<TaskBlock> b, uint32_t s) : block(b), slot(s)
+{
+    assert(s < b->entries.size());
+
+    entry = &b->entries[s];
+    actions = b->actions.data() + b->actionStart[s];
+    succ = b->succ.data() + b->succStart[s];
+    pred = b->pred.data() + b->predStart[s];
+}
+
+bool TaskView::isValid() const { return entry != NULL; }
+
+void TaskView::clear()
+{
+    block.reset();
+    entry = NULL;
+    actions = NULL;
+    succ = NULL;
+    pred = NULL;
+}
+
+TaskId TaskView::getTaskId() const { return TaskId(entry->taskId); }
+ct_timestamp TaskView::getStartTime() const { return entry->startTime; }
+ct_timestamp TaskView::getEndTime() const { return entry->endTime; }
+task_type TaskView::getType() const { return (task_type)entry->type; }
+sync_type TaskView::getSyncType() const { return (sync_type)entry->syncType; }
+bool TaskView::hasDroppedActions() const { return (entry->flags & TASK_BLOCK_ACTIONS_DROPPED) != 0; }
+uint32_t TaskView::getBBCount() const { return entry->bbCount; }
+uint64 TaskView::getMemOpCount() const { return entry->droppedMemOps + getMemOps().size(); }
+uint32_t TaskView::getSequenceId() const { return entry->sequenceId; }
+
+TaskAddressSummary TaskView::getAddressSummary() const
+{
+    TaskAddressSummary tas;
+    
+    tas.clear();
+    if (hasDroppedActions())
+    {
+        tas.setUnknown();
+        return tas;
+    }
+    tas.addActions(actions, actions + entry->asize);
+    
+    return tas;
+}
+
+Span<Action> TaskView::getActions() const { return Span<Action>(actions, entry->asize); }
+Span<TaskId> TaskView::getSuccessorTasks() const { return Span<TaskId>(succ, entry->ssize); }
+Span<TaskId> TaskView::getPredecessorTasks() const { return Span<TaskId>(pred, entry->psize); }
+
+Task::memOpCollection TaskView::getMemOps() const
+{
+    return Task::memOpCollection(actions, actions + entry->asize);
+}
+
+Task::memoryActionCollection TaskView::getMemoryActions() const
+{
+    return Task::memoryActionCollection(actions, actions + entry->asize);
+}
+
+Task::basicBlockActionCollection TaskView::getBasicBlockActions() const
+{
+    return Task::basicBlockActionCollection(actions, actions + entry->asize);
+}
+
+Task* TaskView::toTask() const
+{
+    if (!isValid()) return NULL;
+    return block->getTask(slot);
+}
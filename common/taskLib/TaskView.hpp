@@ -0,0 +1,63 @@
+#ifndef TASK_VIEW_HPP
+#define TASK_VIEW_HPP
+
+#include "Task.hpp"
+#include "TaskBlock.hpp"
+#include "Span.hpp"
+#include <memory>
+
+namespace contech {
+
+//
+// A read-only view of one task in a decoded TaskBlock
+//
+//   The actions, successors and predecessors are spans into the block's columns,
+//   so reading a task through a view does not allocate.  The view shares ownership
+//   of the block, so it stays valid after the reader has moved on to other blocks.
+//   Views are cheap to copy; use toTask() for a mutable copy.
+//
+class TaskView
+{
+public:
+    TaskView();
+    TaskView(std::shared_ptr<TaskBlock> b, uint32_t slot);
+
+    bool isValid() const;
+    // Drop the reference to the block
+    void clear();
+
+    TaskId getTaskId() const;
+    ct_timestamp getStartTime() const;
+    ct_timestamp getEndTime() const;
+    task_type getType() const;
+    sync_type getSyncType() const;
+    bool hasDroppedActions() const;
+    uint32_t getBBCount() const;
+    uint64 getMemOpCount() const;
+    // See Task::getAddressSummary
+    TaskAddressSummary getAddressSummary() const;
+    // See Task::getSequenceId
+    uint32_t getSequenceId() const;
+
+    Span<Action> getActions() const;
+    Span<TaskId> getSuccessorTasks() const;
+    Span<TaskId> getPredecessorTasks() const;
+    Task::memOpCollection getMemOps() const;
+    Task::memoryActionCollection getMemoryActions() const;
+    Task::basicBlockActionCollection getBasicBlockActions() const;
+
+    // Returns a new Task holding a copy of this task
+    Task* toTask() const;
+
+private:
+    std::shared_ptr<TaskBlock> block;
+    const TaskBlockEntry* entry;
+    uint32_t slot;
+    Action* actions;
+    TaskId* succ;
+    TaskId* pred;
+};
+
+}
+
+#endif
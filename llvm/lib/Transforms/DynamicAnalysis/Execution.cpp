@@ -575,8 +575,9 @@ bool EnginePass::runOnModule(Module &M)
                     if (bbm == basicBlockMap.end())
                     {
                         errs() << "Failed to find - " << (uint)bb.basic_block_id << " - ";
-                        auto bbi = tg->getTaskGraphInfo()->getBasicBlockInfo((uint)bb.basic_block_id);
-                        errs() << bbi.fileName << ":" << bbi.lineNumber << " " << bbi.functionName << "\n";
+                        TaskGraphInfo* tgi = tg->getTaskGraphInfo();
+                        const BasicBlockInfo& bbi = tgi->getBasicBlockInfo((uint)bb.basic_block_id);
+                        errs() << tgi->getString(bbi.fileId) << ":" << bbi.lineNumber << " " << tgi->getString(bbi.functionId) << "\n";
                         return false;
                     }
                     else
@@ -760,8 +761,9 @@ bool EnginePass::runOnModule(Module &M)
                     if (bbm == basicBlockMap.end())
                     {
                         errs() << "Failed to find - " << (uint)bb.basic_block_id << " - ";
-                        auto bbi = tg->getTaskGraphInfo()->getBasicBlockInfo((uint)bb.basic_block_id);
-                        errs() << bbi.fileName << ":" << bbi.lineNumber << " " << bbi.functionName << "\n";
+                        TaskGraphInfo* tgi = tg->getTaskGraphInfo();
+                        const BasicBlockInfo& bbi = tgi->getBasicBlockInfo((uint)bb.basic_block_id);
+                        errs() << tgi->getString(bbi.fileId) << ":" << bbi.lineNumber << " " << tgi->getString(bbi.functionId) << "\n";
                         return false;
                     }
                     else
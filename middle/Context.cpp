@@ -10,7 +10,7 @@ Context::Context()
 
 // Returns the currently active task
 //Task* Context::activeTask() { return this->tasks.front(); }
-Task* Context::activeTask() { return this->tasks.rbegin()->second; }
+Task* Context::activeTask() { return this->tasks.back(); }
 
 //
 // Which of this context's tasks created cid
@@ -18,72 +18,156 @@ Task* Context::activeTask() { return this->tasks.rbegin()->second; }
 TaskId Context::getCreator(ContextId cid)
 {
     TaskId tid;
-    auto it = creatorMap.find(cid);
-    if (it == creatorMap.end())
+    TaskId* ct = creatorMap.find((uint32_t)cid);
+    if (ct == NULL)
     {
         fprintf(stderr, "Failed to find creator for %d in %d\n", (unsigned int) cid, (unsigned int)activeTask()->getContextId());
         tid = activeTask()->getTaskId();
-        assert(it != creatorMap.end());
+        assert(ct != NULL);
     }
     else
     {
-        tid = it->second;
-        creatorMap.erase(it);
+        tid = *ct;
+        creatorMap.erase((uint32_t)cid);
     }
     
     return tid;
 }
 
 //
-// Remove the specified task from the list.
+// Add the task to this context, a task with the same SeqId is replaced
 //
-bool Context::removeTask(Task* t)
+void Context::addTask(Task* t)
+{
+    uint32_t seq = (uint32_t)t->getSeqId();
+    
+    t->setActionArena(&actionArena);
+    if (tasks.empty())
+    {
+        // An empty window also has an empty overflow
+        taskBase = seq;
+        tasks.push_back(t);
+        return;
+    }
+    
+    // Older than the window, which only occurs if tasks are not created in order
+    if (seq < taskBase)
+    {
+        overflowTasks[seq] = t;
+        return;
+    }
+    
+    size_t pos = seq - taskBase;
+    if (pos >= tasks.size()) tasks.resize(pos + 1, NULL);
+    tasks[pos] = t;
+    
+    trimTasks();
+}
+
+//
+// Keep the window dense, and no larger than CONTEXT_TASK_WINDOW
+//
+void Context::trimTasks()
 {
-    // Probably better to use rbegin, but erase only takes iterators and not reverse iterators
-    /*for (auto it = tasks.begin(), et = tasks.end(); it != et; ++it)
+    while (tasks.size() > CONTEXT_TASK_WINDOW ||
+           (!tasks.empty() && tasks.front() == NULL))
     {
-        if (*it == t) {tasks.erase(it); return true;}
-    }*/
+        Task* t = tasks.front();
+        if (t != NULL) overflowTasks[taskBase] = t;
+        tasks.pop_front();
+        taskBase++;
+    }
+    while (!tasks.empty() && tasks.back() == NULL) {tasks.pop_back();}
     
+    // The active task must be in the window, so restore the newest overflow task
+    if (tasks.empty() && !overflowTasks.empty())
+    {
+        uint64_t maxSeq = 0;
+        for (auto& ot : overflowTasks)
+        {
+            if (ot.first >= maxSeq) maxSeq = ot.first;
+        }
+        Task* t = *overflowTasks.find(maxSeq);
+        overflowTasks.erase(maxSeq);
+        taskBase = maxSeq;
+        tasks.push_back(t);
+    }
+}
+
+//
+// Remove the specified task from the list.
+//
+bool Context::removeTask(Task* t)
+{
     if (t->getType() == task_type_join)
     {
-        auto tjit = joinCountMap.find(t->getTaskId());
-        assert(tjit == joinCountMap.end() || tjit->second == 0);
+        int* tjc = joinCountMap.find((uint64_t)t->getTaskId());
+        assert(tjc == NULL || *tjc == 0);
     }
     
-    auto it = tasks.find(t->getTaskId());
-    if (it == tasks.end()) return false;
-    tasks.erase(it);
+    uint32_t seq = (uint32_t)t->getSeqId();
+    if (tasks.empty()) return false;
+    if (seq < taskBase) return overflowTasks.erase(seq);
     
-    return true; // false;
+    size_t pos = seq - taskBase;
+    if (pos >= tasks.size() || tasks[pos] == NULL) return false;
+    tasks[pos] = NULL;
+    
+    trimTasks();
+    
+    return true;
 }
 
 Task* Context::getTask(TaskId tid)
 {
-    Task* r = NULL;
+    uint32_t seq = (uint32_t)tid.getSeqId();
     
-    // Probably better to use rbegin, but erase only takes iterators and not reverse iterators
-    /*for (auto it = tasks.begin(), et = tasks.end(); it != et; ++it)
+    if (tasks.empty()) return NULL;
+    if (seq < taskBase)
     {
-        r = *it;
-        if (r->getTaskId() == tid) {return r;}
-    }*/
+        Task** ot = overflowTasks.find(seq);
+        return (ot == NULL) ? NULL : *ot;
+    }
     
-    auto it = tasks.find(tid);
-    if (it == tasks.end()) return NULL;
-    return it->second;
+    size_t pos = seq - taskBase;
+    if (pos >= tasks.size()) return NULL;
+    return tasks[pos];
+}
+
+bool Context::hasTasks()
+{
+    return !tasks.empty();
+}
+
+//
+// Every task in this context, in SeqId order
+//
+void Context::getAllTasks(vector<Task*>& allTasks)
+{
+    vector<pair<uint64_t, Task*> > older;
+    for (auto& ot : overflowTasks)
+    {
+        older.push_back(make_pair(ot.first, ot.second));
+    }
+    sort(older.begin(), older.end());
+    for (auto& ot : older)
+    {
+        allTasks.push_back(ot.second);
+    }
     
-    // Is it safe that r is equal to the last element in the list?
-    return r;
+    for (Task* t : tasks)
+    {
+        if (t != NULL) allTasks.push_back(t);
+    }
 }
 
 Task* Context::childExits(TaskId childId)
 {
     ContextId ctid = childId.getContextId();
-    auto it = joinMap.find(ctid);
+    Task** jt = joinMap.find((uint32_t)ctid);
     
     // Parent hasn't created the join task yet, record a 'cookie' for parent
-    if (it == joinMap.end())
+    if (jt == NULL)
     {
         //joinMap[ctid] = childId;
         // Parent finds child via context[ctid].activeTask
@@ -91,14 +175,14 @@ Task* Context::childExits(TaskId childId)
     }
     else
     {
-        Task* r = it->second;
-        joinMap.erase(it);
-        joinCountMap[r->getTaskId()] --;
+        Task* r = *jt;
+        joinMap.erase((uint32_t)ctid);
+        joinCountMap[(uint64_t)r->getTaskId()] --;
         
-        if (tasks.find(r->getTaskId()) == tasks.end())
+        if (getTask(r->getTaskId()) != r)
         {
             printf("Child exiting on task that has already been removed: %s at %d\n", 
-                r->getTaskId().toString().c_str(), joinCountMap[r->getTaskId()]);
+                r->getTaskId().toString().c_str(), joinCountMap[(uint64_t)r->getTaskId()]);
             assert(0);
         }
         
@@ -108,18 +192,18 @@ Task* Context::childExits(TaskId childId)
 
 void Context::getChildJoin(ContextId ctid, Task* tj)
 {
-    joinMap[ctid] = tj;
-    joinCountMap[tj->getTaskId()] ++;
+    joinMap[(uint32_t)ctid] = tj;
+    joinCountMap[(uint64_t)tj->getTaskId()] ++;
 }
 
 bool Context::isCompleteJoin(TaskId tid)
 {
-    auto it = joinCountMap.find(tid);
+    int* jc = joinCountMap.find((uint64_t)tid);
     
-    if (it == joinCountMap.end()) return true;
-    if (it->second > 0) return false;
+    if (jc == NULL) return true;
+    if (*jc > 0) return false;
         
-    joinCountMap.erase(it);
+    joinCountMap.erase((uint64_t)tid);
         
     return true;
 }
@@ -136,7 +220,7 @@ Task* Context::createBasicBlockContinuation()
 
     // Make the continuation active
     //tasks.push_front(continuation);
-    tasks[continuation->getTaskId()] = continuation;
+    addTask(continuation);
 
     return continuation;
 }
@@ -180,7 +264,7 @@ Task* Context::createContinuation(task_type type, ct_tsc_t tStartTime, ct_tsc_t
 
     // Make the continuation active
     //tasks.push_front(continuation);
-    tasks[continuation->getTaskId()] = continuation;
+    addTask(continuation);
 
     if (bbContinue != NULL)
     {
@@ -190,3 +274,55 @@ Task* Context::createContinuation(task_type type, ct_tsc_t tStartTime, ct_tsc_t
     
     return continuation;
 }
+
+ContextTable::ContextTable()
+{
+    ranks.clear();
+}
+
+ContextTable::~ContextTable()
+{
+    for (auto& r : ranks)
+    {
+        for (Context* c : r)
+        {
+            delete c;
+        }
+    }
+}
+
+Context& ContextTable::operator[](ContextId cid)
+{
+    uint32_t id = (uint32_t)cid;
+    uint32_t rank = id >> 24;
+    uint32_t local = id & 0xffffff;
+    
+    if (rank >= ranks.size()) ranks.resize(rank + 1);
+    vector<Context*>& r = ranks[rank];
+    if (local >= r.size()) r.resize(local + 1, NULL);
+    if (r[local] == NULL) r[local] = new Context();
+    
+    return *r[local];
+}
+
+bool ContextTable::count(ContextId cid)
+{
+    uint32_t id = (uint32_t)cid;
+    uint32_t rank = id >> 24;
+    uint32_t local = id & 0xffffff;
+    
+    return (rank < ranks.size() &&
+            local < ranks[rank].size() &&
+            ranks[rank][local] != NULL);
+}
+
+void ContextTable::getContextIds(vector<ContextId>& ids)
+{
+    for (uint32_t rank = 0; rank < ranks.size(); rank++)
+    {
+        for (uint32_t local = 0; local < ranks[rank].size(); local++)
+        {
+            if (ranks[rank][local] != NULL) ids.push_back(ContextId((rank << 24) | local));
+        }
+    }
+}
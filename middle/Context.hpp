@@ -4,8 +4,14 @@
 #include <deque>
 #include <map>
 #include <list>
+#include <vector>
 #include "../common/eventLib/ct_event.h"
 #include "../common/taskLib/Task.hpp"
+#include "OpenAddrMap.hpp"
+
+// Most recent task sequence ids held in the dense task window of a context
+//   Older tasks that are still waiting (e.g., sync owners) move to the overflow table
+#define CONTEXT_TASK_WINDOW 4096
 
 namespace contech {
 
@@ -19,24 +25,34 @@ public:
     Task* activeTask();
     Task* createBasicBlockContinuation();
     Task* createContinuation(task_type eventType, ct_tsc_t startTime, ct_tsc_t endTime);
+    void addTask(Task*);
     bool removeTask(Task*);
     Task* getTask(TaskId);
+    bool hasTasks();
+    void getAllTasks(vector<Task*>&);
     TaskId getCreator(ContextId);
     void getChildJoin(ContextId, Task*);
     Task* childExits(TaskId);
     bool isCompleteJoin(TaskId);
 
-    // Queue of tasks that are running in this contech but have not been written to file yet. These tasks may have incomplete data.
-    // The front of the queue represents more recent tasks.
-    //list<Task*> tasks;
-    map<TaskId, Task*> tasks;
+    // Tasks that are running in this contech but have not been written to file yet. These tasks may have incomplete data.
+    //   tasks[i] holds SeqId (taskBase + i), the back of the deque is the active task.
+    //   Removed tasks are NULL until they reach either end of the window.
+    deque<Task*> tasks;
+    uint32_t taskBase = 0;
+    // Tasks older than taskBase, keyed by SeqId
+    OpenAddrMap<Task*> overflowTasks;
+    // Slab of action segments for the tasks of this context
+    //   Tasks written in the background still refer to it, which is safe because
+    //   the background writer is joined before the ContextTable is destroyed.
+    ActionArena actionArena;
 
     // Map of ContextId -> TaskId, which task created which context
-    map<ContextId, TaskId> creatorMap;
+    OpenAddrMap<TaskId> creatorMap;
     // Map of child Context -> (childId -or- joinId)
-    map<ContextId, Task*> joinMap;
+    OpenAddrMap<Task*> joinMap;
     // How many joins are pending for this task, if 0 and not active then clear
-    map<TaskId, int> joinCountMap;
+    OpenAddrMap<int> joinCountMap;
     
     // Has this contech started running?
     bool hasStarted = false;
@@ -54,6 +70,32 @@ public:
     ct_tsc_t timeOffset = 0;
     
     ct_tsc_t currentTime = 0;
+
+private:
+    void trimTasks();
+};
+
+//
+// Every context, indexed by (rank << 24) | contech_id
+//
+//   Each rank has a dense array of contexts indexed by contech_id.  Contexts are
+//   separately allocated, so references remain valid as the table grows.
+//
+class ContextTable
+{
+public:
+    ContextTable();
+    ~ContextTable();
+
+    // Returns the context, creating it if it has not been seen
+    Context& operator[](ContextId);
+    // Has this context been seen
+    bool count(ContextId);
+    // Every context that has been seen, in ContextId order
+    void getContextIds(vector<ContextId>&);
+
+private:
+    vector<vector<Context*> > ranks;
 };
 
 } // end namespace contech
@@ -0,0 +1,149 @@
+#ifndef CT_OPEN_ADDR_MAP_HPP
+#define CT_OPEN_ADDR_MAP_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <vector>
+#include <utility>
+
+namespace contech {
+
+//
+// Open addressing hash table keyed by 64 bit values (addresses, TaskIds, ContextIds)
+//
+//   Linear probing over a power of 2 table, which is kept at most half full.
+//   Erase shifts the following entries back, so there are no tombstones and
+//   lookups never probe past the first empty slot.
+//
+//   N.B. Growing the table moves every entry, so pointers and references
+//   returned by find / operator[] are only valid until the next insert.
+//
+template <typename V>
+class OpenAddrMap
+{
+public:
+    struct Slot
+    {
+        bool used;
+        uint64_t first;
+        V second;
+        Slot() : used(false), first(0), second() {}
+    };
+
+    class iterator
+    {
+        public:
+            iterator(Slot* s, Slot* e) : it(s), last(e) { skip(); }
+            iterator& operator++() { ++it; skip(); return *this; }
+            Slot& operator*() { return *it; }
+            Slot* operator->() { return it; }
+            bool operator==(const iterator& rhs) const { return it == rhs.it; }
+            bool operator!=(const iterator& rhs) const { return it != rhs.it; }
+        private:
+            void skip() { while (it != last && !it->used) ++it; }
+            Slot* it;
+            Slot* last;
+    };
+
+private:
+    std::vector<Slot> slots;
+    size_t count;
+    size_t mask;
+
+    static size_t hashKey(uint64_t k)
+    {
+        // Finalizer from MurmurHash3, addresses and ids have most entropy in the low bits
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return (size_t)k;
+    }
+
+    size_t findSlot(uint64_t key) const
+    {
+        size_t i = hashKey(key) & mask;
+        while (slots[i].used && slots[i].first != key) { i = (i + 1) & mask; }
+        return i;
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(old.size() * 2);
+        mask = slots.size() - 1;
+        for (Slot& s : old)
+        {
+            if (!s.used) continue;
+            Slot& n = slots[findSlot(s.first)];
+            n.used = true;
+            n.first = s.first;
+            n.second = std::move(s.second);
+        }
+    }
+
+public:
+    // initialSize must be a power of 2
+    OpenAddrMap(size_t initialSize = 16) : slots(initialSize), count(0), mask(initialSize - 1)
+    {
+        assert(initialSize > 1 && (initialSize & mask) == 0);
+    }
+
+    V* find(uint64_t key)
+    {
+        Slot& s = slots[findSlot(key)];
+        return (s.used) ? &s.second : NULL;
+    }
+
+    // Returns the value for key, inserting a default value if not present
+    V& operator[](uint64_t key)
+    {
+        size_t i = findSlot(key);
+        if (slots[i].used) return slots[i].second;
+
+        if ((count + 1) * 2 > slots.size())
+        {
+            grow();
+            i = findSlot(key);
+        }
+        slots[i].used = true;
+        slots[i].first = key;
+        count++;
+        return slots[i].second;
+    }
+
+    bool erase(uint64_t key)
+    {
+        size_t i = findSlot(key);
+        if (!slots[i].used) return false;
+
+        // Shift back any entry in this probe run that could no longer be found
+        //   An entry at j (home k) stays only if k lies cyclically in (i, j]
+        size_t j = i;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (!slots[j].used) break;
+            size_t k = hashKey(slots[j].first) & mask;
+            if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) continue;
+            slots[i].first = slots[j].first;
+            slots[i].second = std::move(slots[j].second);
+            i = j;
+        }
+        slots[i].used = false;
+        slots[i].second = V();
+        count--;
+        return true;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+    iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+};
+
+} // end namespace contech
+
+#endif
@@ -0,0 +1,255 @@
+#include "TaskIndex.hpp"
+#include "middle.hpp"
+#include <sys/mman.h>
+
+using namespace std;
+using namespace contech;
+
+TaskIndex::TaskIndex()
+{
+    recordFile = tmpfile();
+    edgeFile = tmpfile();
+    assert(recordFile != NULL && edgeFile != NULL && "Could not create temporary index files");
+    recordCount = 0;
+    edgeTotal = 0;
+}
+
+TaskIndex::~TaskIndex()
+{
+    // Temporary files are removed on close
+    fclose(recordFile);
+    fclose(edgeFile);
+}
+
+uint64 TaskIndex::size() const
+{
+    return recordCount;
+}
+
+uint32_t* TaskIndex::findSlot(TaskId tid)
+{
+    ContextSlots* cs = slots.find((uint32_t)tid.getContextId());
+    uint32_t seq = (uint32_t)tid.getSeqId();
+
+    if (cs == NULL || seq < cs->base || seq - cs->base >= cs->rec.size()) return NULL;
+    return &cs->rec[seq - cs->base];
+}
+
+//
+// Release the slot of an emitted task
+//
+//   Tasks in a context are emitted roughly in seq order, so emitted slots
+//   are trimmed from the front of the context.
+//
+void TaskIndex::releaseSlot(TaskId tid)
+{
+    ContextSlots& cs = *slots.find((uint32_t)tid.getContextId());
+
+    cs.rec[(uint32_t)tid.getSeqId() - cs.base] = 0;
+    while (!cs.rec.empty() && cs.rec.front() == 0)
+    {
+        cs.rec.pop_front();
+        cs.base++;
+    }
+}
+
+void TaskIndex::addTask(Task& t, uint64 writePos)
+{
+    TaskRecord tr;
+    TaskId id = t.getTaskId();
+    auto& succ = t.getSuccessorTasks();
+    auto& pred = t.getPredecessorTasks();
+
+    tr.self = id;
+    tr.start = t.getStartTime();
+    tr.end = t.getEndTime();
+    tr.writePos = writePos;
+    tr.edgePos = edgeTotal;
+    tr.memOpCount = t.getMemOpCount();
+    tr.p = pred.size();
+    tr.succCount = succ.size();
+    tr.predCount = pred.size();
+    tr.bbCount = t.getBBCount();
+    tr.type = t.getType();
+    tr.syncType = t.getSyncType();
+    tr.sequenceId = t.getSequenceId();
+    tr.addresses = t.getAddressSummary();
+
+    ct_write(&tr, sizeof(tr), recordFile);
+    if (!succ.empty())
+    {
+        ct_write(succ.data(), sizeof(TaskId) * succ.size(), edgeFile);
+    }
+    if (!pred.empty())
+    {
+        ct_write(pred.data(), sizeof(TaskId) * pred.size(), edgeFile);
+    }
+    edgeTotal += succ.size() + pred.size();
+
+    recordCount++;
+    assert(recordCount < UINT32_MAX);
+
+    ContextSlots& cs = slots[(uint32_t)id.getContextId()];
+    uint32_t seq = (uint32_t)id.getSeqId();
+    assert(seq >= cs.base);
+    if (seq - cs.base >= cs.rec.size())
+    {
+        cs.rec.resize(seq - cs.base + 1, 0);
+    }
+    assert(cs.rec[seq - cs.base] == 0);
+    cs.rec[seq - cs.base] = recordCount;
+}
+
+uint64 TaskIndex::writeIndex(FILE* out, TaskId& lastTid, TaskGraphSectionWriter& sections)
+{
+    TaskRecord* records = NULL;
+    TaskId* edges = NULL;
+    size_t recordLen = recordCount * sizeof(TaskRecord);
+    size_t edgeLen = edgeTotal * sizeof(TaskId);
+
+    fflush(recordFile);
+    fflush(edgeFile);
+    if (recordLen > 0)
+    {
+        records = (TaskRecord*) mmap(NULL, recordLen, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(recordFile), 0);
+        assert(records != MAP_FAILED);
+        madvise(records, recordLen, MADV_RANDOM);
+    }
+    if (edgeLen > 0)
+    {
+        edges = (TaskId*) mmap(NULL, edgeLen, PROT_READ, MAP_SHARED, fileno(edgeFile), 0);
+        assert(edges != MAP_FAILED);
+    }
+
+    // The priority queue carries the record number in place of the offset
+    priority_queue<pair<ct_tsc_t, pair<TaskId, uint64> >, vector<pair<ct_tsc_t, pair<TaskId, uint64> > >, first_compare > taskSort;
+
+    {
+        uint32_t* rootSlot = findSlot(0);
+        assert(rootSlot != NULL && *rootSlot != 0);
+        TaskRecord& tr = records[*rootSlot - 1];
+        taskSort.push(make_pair(tr.start, make_pair(tr.self, (uint64)(*rootSlot - 1))));
+    }
+
+    //
+    // This reproduces the BFS algorithm that had been used for writing tasks
+    //   It is much faster to sort the tasks on just the graph information than
+    //   to indefinitely delay writing a task until the entire graph is available.
+    //
+    // taskSort is a priority queue, the top element is the oldest task that has all
+    //   its prior tasks in the index.
+    //
+    uint64 indexWriteCount = 0;
+    lastTid = 0;
+    while (!taskSort.empty())
+    {
+        TaskId tid = taskSort.top().second.first;
+        TaskRecord& tr = records[taskSort.top().second.second];
+        uint64 offset = tr.writePos;
+
+        lastTid = tid;
+
+        ct_write(&tid, sizeof(TaskId), out);
+        ct_write(&offset, sizeof(uint64), out);
+
+        taskSort.pop();
+
+        assert(tr.self == tid);
+        assert(tr.p == 0);
+        // Once emitted, the record keeps its position in the order for the lookup
+        tr.p = indexWriteCount;
+        writeSummary(tr, edges, sections);
+
+        for (uint32_t i = 0; i < tr.succCount; i++)
+        {
+            TaskId succ = edges[tr.edgePos + i];
+            uint32_t* suSlot = findSlot(succ);
+            assert(suSlot != NULL && *suSlot != 0);
+            TaskRecord& suTR = records[*suSlot - 1];
+
+            suTR.p--;
+            if (suTR.p == 0)
+            {
+                taskSort.push(make_pair(suTR.start, make_pair(suTR.self, (uint64)(*suSlot - 1))));
+            }
+        }
+
+        releaseSlot(tid);
+        indexWriteCount++;
+    }
+
+    if (indexWriteCount == recordCount)
+    {
+        writeLookup(records, out);
+    }
+    else
+    {
+        // Report the tasks that were never emitted
+        for (uint64 r = 0; r < recordCount; r++)
+        {
+            TaskRecord& tr = records[r];
+            uint32_t* slot = findSlot(tr.self);
+            if (slot == NULL || *slot == 0) continue;
+
+            printf("%s (pred:%u)\t", tr.self.toString().c_str(), tr.p);
+            for (uint32_t i = 0; i < tr.succCount; i++)
+            {
+                printf("%s\t", edges[tr.edgePos + i].toString().c_str());
+            }
+            printf("\n");
+        }
+    }
+
+    if (records != NULL) munmap(records, recordLen);
+    if (edges != NULL) munmap(edges, edgeLen);
+
+    return indexWriteCount;
+}
+
+//
+// Write the TaskId sorted lookup of the index
+//
+//   The records are no longer needed once every task is emitted, so they are
+//   sorted in place by TaskId, and each has its position in the order.
+//
+void TaskIndex::writeLookup(TaskRecord* records, FILE* out)
+{
+    if (recordCount == 0) return;
+    
+    sort(records, records + recordCount,
+         [](const TaskRecord& a, const TaskRecord& b) { return a.self < b.self; });
+    
+    for (uint64 r = 0; r < recordCount; r++)
+    {
+        uint64 order = records[r].p;
+        ct_write(&records[r].self, sizeof(TaskId), out);
+        ct_write(&order, sizeof(uint64), out);
+    }
+}
+
+uint64 TaskIndex::getContextCount() const
+{
+    return slots.size();
+}
+
+//
+// Add the summary of an emitted task, with its successors and predecessors
+//
+void TaskIndex::writeSummary(TaskRecord& tr, TaskId* edges, TaskGraphSectionWriter& sections)
+{
+    TaskSummary ts;
+
+    memset((void*)&ts, 0, sizeof(ts));
+    ts.taskId = tr.self;
+    ts.startTime = tr.start;
+    ts.endTime = tr.end;
+    ts.memOpCount = tr.memOpCount;
+    ts.bbCount = tr.bbCount;
+    ts.type = tr.type;
+    ts.syncType = tr.syncType;
+    ts.sequenceId = tr.sequenceId;
+
+    const TaskId* succ = edges + tr.edgePos;
+    sections.addSummary(ts, tr.addresses, Span<const TaskId>(succ, tr.succCount),
+                        Span<const TaskId>(succ + tr.succCount, tr.predCount));
+}
@@ -0,0 +1,87 @@
+#ifndef CT_TASK_INDEX_HPP
+#define CT_TASK_INDEX_HPP
+
+#include "../common/taskLib/Task.hpp"
+#include "../common/taskLib/TaskGraphSectionWriter.hpp"
+#include "../common/eventLib/ct_event.h"
+#include "OpenAddrMap.hpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+
+namespace contech {
+
+//
+// Builds the task graph index as tasks are written
+//
+//   Each task is reduced to a compact fixed size record appended to a temporary
+//   file, with its successors and predecessors appended to a second temporary file.  The only
+//   state kept in memory per task is a 4 byte slot mapping its TaskId to its
+//   record.  When the index is written, the records are mapped from the files
+//   so the kernel can page them out, and the BFS only holds the tasks that are
+//   ready.  Slots are released once a task is emitted.
+//
+//   The task summaries and address summaries are given to the section writer in
+//   order as tasks are emitted, which copies them to the graph after the index.
+//
+class TaskIndex
+{
+public:
+    TaskIndex();
+    ~TaskIndex();
+
+    // Record a task, which has been written at writePos in the task graph
+    void addTask(Task& t, uint64 writePos);
+    uint64 size() const;
+
+    // Contexts with a task in the index
+    uint64 getContextCount() const;
+    
+    // Write the index entries in BFS order, then the TaskId sorted lookup into
+    //   that order, adding the summary of each task to sections in that order.
+    //   Returns the number of entries written, lastTid is set to the final task
+    //   in the order.
+    uint64 writeIndex(FILE* out, TaskId& lastTid, TaskGraphSectionWriter& sections);
+
+private:
+    struct TaskRecord
+    {
+        TaskId      self;
+        ct_tsc_t    start;      // start time for this task
+        ct_tsc_t    end;
+        uint64      writePos;   // where the task was written
+        uint64      edgePos;    // first successor in the edge file, the predecessors follow
+        uint64      memOpCount;
+        uint32_t    p;          // number of predecessor tasks remaining, then position in the order
+        uint32_t    succCount;
+        uint32_t    predCount;
+        uint32_t    bbCount;
+        int32_t     type;
+        int32_t     syncType;
+        uint32_t    sequenceId;
+        TaskAddressSummary addresses;
+    };
+
+    // Record number + 1 for each seq id of a context, 0 if absent or emitted
+    struct ContextSlots
+    {
+        uint32_t base;
+        std::deque<uint32_t> rec;
+        ContextSlots() : base(0) {}
+    };
+
+    FILE* recordFile;
+    FILE* edgeFile;
+    uint64 recordCount;
+    uint64 edgeTotal;
+    OpenAddrMap<ContextSlots> slots;
+
+    uint32_t* findSlot(TaskId tid);
+    void releaseSlot(TaskId tid);
+    void writeLookup(TaskRecord* records, FILE* out);
+    void writeSummary(TaskRecord& tr, TaskId* edges, TaskGraphSectionWriter& sections);
+};
+
+} // end namespace contech
+
+#endif
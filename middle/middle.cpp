@@ -19,10 +19,37 @@ int main(int argc, char* argv[])
     //   then restart in serial mode.
     //   TODO: Implement restart / reset, or a flag for running serially.
 reset_middle:
-    if (argc < 3)
+    // Options precede the positional arguments
+    //   -c <n>  number of threads compressing tasks in the background writer
+    //   -b      basic block only output, memory actions are dropped but counted
+    //   -r      ROI only output, tasks outside the ROI have no actions
+    int firstInPos = 1;
+    bool bbOnly = false, roiOnly = false;
+    while (firstInPos < argc)
+    {
+        if (firstInPos + 1 < argc && !strcmp(argv[firstInPos], "-c"))
+        {
+            setCompressThreads(atoi(argv[firstInPos + 1]));
+            firstInPos += 2;
+        }
+        else if (!strcmp(argv[firstInPos], "-b"))
+        {
+            bbOnly = true;
+            firstInPos++;
+        }
+        else if (!strcmp(argv[firstInPos], "-r"))
+        {
+            roiOnly = true;
+            firstInPos++;
+        }
+        else break;
+    }
+    setOutputMode(bbOnly, roiOnly);
+    
+    if (argc - firstInPos < 2)
     {
         fprintf(stderr, "Missing positional argument(s)\n");
-        fprintf(stderr, "%s <event trace>* <taskgraph> [-d]\n", argv[0]);
+        fprintf(stderr, "%s [-c <compress threads>] [-b] [-r] <event trace>* <taskgraph> [-d]\n", argv[0]);
         return 1;
     }
     
@@ -38,7 +65,7 @@ reset_middle:
     int totalRanks = 0;
     if (DEBUG == true) lastInPos--;
     
-    for (int argPos = 1; argPos <= lastInPos; argPos++, totalRanks++)
+    for (int argPos = firstInPos; argPos <= lastInPos; argPos++, totalRanks++)
     {
         FILE* in;
         in = fopen(argv[argPos], "rb");
@@ -71,13 +98,13 @@ reset_middle:
     assert(r == 0);
     
     // Track the owners of sync primitives
-    map<ct_addr_t, Task*> ownerList;
+    OpenAddrMap<Task*> ownerList;
     
     // Track the barrier task for each address
-    map<ct_addr_t, BarrierWrapper> barrierList;
+    OpenAddrMap<BarrierWrapper> barrierList;
 
     // Declare each context
-    map<ContextId, Context> context;
+    ContextTable context;
 
     // MPI Transfers src-rank -> dst rank -> tag -> task
     map <int, map <int, map <int, Task*> > > mpiSendQ;
@@ -88,23 +115,23 @@ reset_middle:
     if (totalRanks > 1)
     {
         //context[0].tasks.push_front(new Task(0, task_type_create));
-        context[0].tasks[0] = new Task(0, task_type_create);
+        context[0].addTask(new Task(0, task_type_create));
     }
     else
     {
         //context[0].tasks.push_front(new Task(0, task_type_basic_blocks));
-        context[0].tasks[0] = new Task(0, task_type_basic_blocks);
+        context[0].addTask(new Task(0, task_type_basic_blocks));
     }
     context[0].hasStarted = true;
     
 
     // Count the number of events processed
     uint64 eventCount = 0;
+    struct timeb startTp;
 
     {
-        struct timeb tp;
-        ftime(&tp);
-        printf("MIDDLE_START: %d.%03d\n", (unsigned int)tp.time, tp.millitm);
+        ftime(&startTp);
+        printf("MIDDLE_START: %d.%03d\n", (unsigned int)startTp.time, startTp.millitm);
     }
     
     // Scan through the file for the first real event
@@ -289,6 +316,9 @@ reset_middle:
             
             // If the basic block action will overflow, then split the task at this time
             try {
+                // Reserve for the block and its memops, so they are recorded into one segment
+                activeT->reserveActions(1 + (outputBasicBlocksOnly() ? 0 : event->bb.len));
+                
                 // Record that this task executed this basic block
                 activeT->recordBasicBlockAction(event->bb.basic_block_id);
             }
@@ -301,11 +331,16 @@ reset_middle:
                 updateContextTaskList(activeContech);
                 
                 activeT = activeContech.activeTask();
+                activeT->reserveActions(1 + (outputBasicBlocksOnly() ? 0 : event->bb.len));
                 activeT->recordBasicBlockAction(event->bb.basic_block_id);
             }
 
             // Examine memory operations
-            for (uint i = 0; i < event->bb.len; i++)
+            if (outputBasicBlocksOnly())
+            {
+                activeT->recordDroppedMemOps(event->bb.len);
+            }
+            else for (uint i = 0; i < event->bb.len; i++)
             {
                 ct_memory_op memOp = event->bb.mem_op_array[i];
                 memOp.rank = currentRank;
@@ -331,7 +366,7 @@ reset_middle:
                     
                     context[(currentRank << 24) | 0].hasStarted = true;
                     //context[(currentRank << 24) | 0].tasks.push_front(new Task(childTaskId, task_type_basic_blocks));
-                    context[(currentRank << 24) | 0].tasks[childTaskId] = new Task(childTaskId, task_type_basic_blocks);
+                    context[(currentRank << 24) | 0].addTask(new Task(childTaskId, task_type_basic_blocks));
                     context[(currentRank << 24) | 0].timeOffset = event->tc.start_time;
                     taskCreate = context[0].activeTask();
                     assert(taskCreate->getType() == task_type_create);
@@ -387,7 +422,7 @@ reset_middle:
                 // Start the first task for the new context
                 activeContech.hasStarted = true;
                 //activeContech.tasks.push_front(new Task(newContechTaskId, task_type_basic_blocks));
-                activeContech.tasks[newContechTaskId] = new Task(newContechTaskId, task_type_basic_blocks);
+                activeContech.addTask(new Task(newContechTaskId, task_type_basic_blocks));
                 activeContech.activeTask()->setStartTime(endTime);
 
                 // Record parent of this task
@@ -425,12 +460,12 @@ reset_middle:
             activeContech.createBasicBlockContinuation();
             
             // Make the sync dependent on whomever accessed the sync primitive last         
-            auto it = ownerList.find(syncA.data);
-            if (it != ownerList.end() &&
+            Task** it = ownerList.find(syncA.data);
+            if (it != NULL &&
                 event->sy.sync_type != ct_cond_wait&&
                 parallelMiddle)
             {
-                Task* owner = it->second;
+                Task* owner = *it;
                 ContextId cid = owner->getContextId();
                 owner->addSuccessor(sync->getTaskId());
                 sync->addPredecessor(owner->getTaskId());
@@ -614,10 +649,10 @@ reset_middle:
                     continuation->addPredecessor(activeContech.activeTask()->getTaskId());
                     // Barrier owner is responsible for making sure the barrier task gets added to the output file
                     //activeContech.tasks.push_front(barrierTask);
-                    activeContech.tasks[barrierTask->getTaskId()] = barrierTask;
+                    activeContech.addTask(barrierTask);
                     // Make it the active task for this context
                     //activeContech.tasks.push_front(continuation);
-                    activeContech.tasks[continuation->getTaskId()] = continuation;
+                    activeContech.addTask(continuation);
                     attemptBackgroundQueueTask(activeT, activeContech);
                 }
                 else
@@ -874,13 +909,13 @@ reset_middle:
             TaskId tid = activeT->getTaskId();
             if (roiEvent == false)
             {
-                setROIStart(tid);
+                setROIStart(tid, roiTime);
                 printf("DEBUG - ROI Start - %lu - %lu\n", (uint64_t)tid, roiTime);
                 roiEvent = true;
             }
             else
             {
-                setROIEnd(tid);
+                setROIEnd(tid, roiTime);
                 printf("DEBUG - ROI End - %lu - %lu\n", (uint64_t)tid, roiTime);
             }
         }
@@ -898,16 +933,19 @@ reset_middle:
     
     char* d = NULL;
     
-    for (auto& p : context)
+    vector<ContextId> contextIds;
+    context.getContextIds(contextIds);
+    for (ContextId cid : contextIds)
     {
-        Context& c = p.second;
+        Context& c = context[cid];
+        vector<Task*> remainingTasks;
         
-        //printf("%d\t%llx\t%llx\t%llx\n", p.first, c.timeOffset, c.startTime, c.endTime);
+        //printf("%d\t%llx\t%llx\t%llx\n", cid, c.timeOffset, c.startTime, c.endTime);
         
-        //for (Task* t : c.tasks)
-        for (auto t : c.tasks)
+        c.getAllTasks(remainingTasks);
+        for (Task* t : remainingTasks)
         {
-            backgroundQueueTask(t.second);
+            backgroundQueueTask(t);
         }
     }
     
@@ -919,6 +957,13 @@ reset_middle:
         struct timeb tp;
         ftime(&tp);
         printf("MIDDLE_QUEUE: %d.%03d\n", (unsigned int)tp.time, tp.millitm);
+        
+        // Event rate of the foreground thread, which excludes the final background writes
+        double elapsed = (tp.time - startTp.time) + (tp.millitm - startTp.millitm) / 1000.0;
+        if (elapsed > 0)
+        {
+            printf("MIDDLE_EVENTS: %lu\t%.0f events/sec\n", eventCount, eventCount / elapsed);
+        }
     }
     pthread_join(backgroundT, (void**) &d);
     
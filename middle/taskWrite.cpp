@@ -1,9 +1,14 @@
 #include "taskWrite.hpp"
 #include "middle.hpp"
 #include "../common/taskLib/TaskGraph.hpp"
+#include "TaskIndex.hpp"
+#include "../common/taskLib/TaskGraphSectionWriter.hpp"
 #include <sys/timeb.h>
 #include <sys/sysinfo.h>
+#include <sys/resource.h>
 #include <map>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 using namespace contech;
@@ -15,15 +20,52 @@ deque<Task*>* taskQueue;
 
 TaskId roiStart = 0;
 TaskId roiEnd = 0;
+ct_tsc_t roiStartTime = 0;
+ct_tsc_t roiEndTime = 0;
+bool roiStarted = false;
+bool roiEnded = false;
 
-void setROIStart(TaskId t)
+// Output modes, see setOutputMode
+bool basicBlocksOnly = false;
+bool roiOnly = false;
+
+void setROIStart(TaskId t, ct_tsc_t time)
 {
     roiStart = t;
+    roiStartTime = time;
+    roiStarted = true;
 }
 
-void setROIEnd(TaskId t)
+void setROIEnd(TaskId t, ct_tsc_t time)
 {
     roiEnd = t;
+    roiEndTime = time;
+    roiEnded = true;
+}
+
+void setOutputMode(bool bbOnly, bool roi)
+{
+    basicBlocksOnly = bbOnly;
+    roiOnly = roi;
+}
+
+bool outputBasicBlocksOnly()
+{
+    return basicBlocksOnly;
+}
+
+//
+// Is the task outside the ROI?
+//
+//   A task is in the ROI if it runs during the ROI.  Tasks queued before the
+//   ROI starts are outside, as the foreground has not reached the ROI yet.
+//
+bool isOutsideROI(Task* t)
+{
+    if (!roiStarted) return true;
+    if (t->getEndTime() != 0 && t->getEndTime() <= roiStartTime) return true;
+    if (roiEnded && t->getStartTime() >= roiEndTime) return true;
+    return false;
 }
 
 //
@@ -37,6 +79,18 @@ void setROIEnd(TaskId t)
 void backgroundQueueTask(Task* t)
 {
     unsigned int qSize = 0;
+    
+    // Tasks outside the ROI are kept with their edges, so the graph is still
+    //   connected, but none of their actions.
+    if (roiOnly && isOutsideROI(t))
+    {
+        t->dropAllActions();
+    }
+    else if (basicBlocksOnly)
+    {
+        t->dropMemoryActions();
+    }
+    
     pthread_mutex_lock(&taskQueueLock);
     qSize = taskQueue->size();
     taskQueue->push_back(t);
@@ -53,15 +107,15 @@ void backgroundQueueTask(Task* t)
 //   the tasks currently queued at a context.  And to display the details of the
 //   oldest task.
 //
-void displayContextTasks(map<ContextId, Context> &context, int id)
+void displayContextTasks(ContextTable &context, int id)
 {
-    Context tgt = context[id];
+    Context& tgt = context[id];
     Task* last = NULL;
+    vector<Task*> ctxTasks;
     
-    //for (Task* t : tgt.tasks)
-    for (auto it : tgt.tasks)
+    tgt.getAllTasks(ctxTasks);
+    for (Task* t : ctxTasks)
     {
-        Task* t = it.second;
         if (last == NULL)
         {
             last = t;
@@ -74,17 +128,17 @@ void displayContextTasks(map<ContextId, Context> &context, int id)
         
         if (last->getType() == task_type_join)
         {
-            auto jc = tgt.joinCountMap.find(last->getTaskId());
-            if (jc == tgt.joinCountMap.end())
+            int* jc = tgt.joinCountMap.find((uint64_t)last->getTaskId());
+            if (jc == NULL)
             {
                 cout << "Join is not waiting on any tasks, should be queued.\n";
             }
             else
             {
-                cout << "Waiting on: " << jc->second << " tasks to join" << endl;
+                cout << "Waiting on: " << *jc << " tasks to join" << endl;
                 for (TaskId s : last->getSuccessorTasks())
                 {
-                    if (tgt.joinMap.find(s.getContextId()) != tgt.joinMap.end())
+                    if (tgt.joinMap.find((uint32_t)s.getContextId()) != NULL)
                     {
                         cout << "\tWaiting on: " << s.toString() << endl;
                     }
@@ -97,19 +151,21 @@ void displayContextTasks(map<ContextId, Context> &context, int id)
 //
 // Debug routine
 //
-void identifyMaxTaskPerContext(map<ContextId, Context> &context)
+void identifyMaxTaskPerContext(ContextTable &context)
 {
-    for (auto it = context.begin(), et = context.end(); it != et; ++it)
+    vector<ContextId> contextIds;
+    context.getContextIds(contextIds);
+    for (ContextId cid : contextIds)
     {
-        Context tgt = it->second;
+        Context& tgt = context[cid];
         int countSyn = 0, countBB = 0, countC = 0, countJ = 0, countBar = 0;
         uint64_t maxBBCount = 0;
         Task* maxBBTask = NULL;
+        vector<Task*> ctxTasks;
         
-        //for (Task* t : tgt.tasks)
-        for (auto it : tgt.tasks)
+        tgt.getAllTasks(ctxTasks);
+        for (Task* t : ctxTasks)
         {
-            Task* t = it.second;
             switch(t->getType())
             {
                 case task_type_basic_blocks:
@@ -146,7 +202,7 @@ void identifyMaxTaskPerContext(map<ContextId, Context> &context)
             }
         }
         cout << maxBBTask->getTaskId().toString() << " - " << maxBBCount << endl;
-        cout << it->first << " C: " << countC << " J: " << countJ << " S: " << countSyn;
+        cout << cid << " C: " << countC << " J: " << countJ << " S: " << countSyn;
         cout << " B: " << countBar << " BB: " << countBB << endl;
     }
 }
@@ -287,6 +343,19 @@ void debugBackground(map<TaskId, pair<Task*, int> > &tasks)
     }
 }
 
+// Peak resident memory of the middle layer
+unsigned long getPeakMemoryKB()
+{
+    struct rusage ru;
+    
+    if (0 == getrusage(RUSAGE_SELF, &ru))
+    {
+        return (unsigned long)ru.ru_maxrss;
+    }
+    
+    return 0;
+}
+
 unsigned long long getCurrentFreeMemory()
 {
     struct sysinfo t_info;
@@ -301,33 +370,14 @@ unsigned long long getCurrentFreeMemory()
     return 0;
 }
 
-struct TaskWrapper
-{
-    TaskId      self;   // probably redundant in a map
-    int         p;      // number of predecessor tasks remaining
-    vector<TaskId> s;   // tasks that follow this task
-    ct_tsc_t    start;  // start time for this task
-    long        writePos; // where was the task written
-    task_type   t;
-};
+// Blocks are compressed by the section writer's threads, by default up to this many
+#define MAX_DEFAULT_COMPRESS_THREADS 8
+
+int compressThreadCount = -1;
 
-void findPredInTaskMap(map<TaskId, TaskWrapper> &writeTaskMap, int c, int s)
+void setCompressThreads(int n)
 {
-    TaskId tid = TaskId(c, s);
-    
-    for (auto it = writeTaskMap.begin(), et = writeTaskMap.end(); it != et; ++it)
-    {
-        for (TaskId succ : it->second.s)
-        {
-            if (succ == tid)
-            {
-                printf("Found in %u:%u that is at %u\n", (uint32_t)it->first.getContextId(),
-                                                         (uint32_t)it->first.getSeqId(),
-                                                         it->second.p);
-                return;
-            }
-        }
-    }
+    compressThreadCount = n;
 }
 
 void* backgroundTaskWriter(void* v)
@@ -335,14 +385,26 @@ void* backgroundTaskWriter(void* v)
     FILE* out = *(FILE**)v;
 
     deque<Task*> writeTaskQueue;
-    map<TaskId, TaskWrapper> writeTaskMap;
+    TaskIndex taskIndex;
+    
+    // Tasks are written in blocks, which are followed by the index and the sections
+    TaskGraphSectionWriter sections(out);
     uint64 taskCount = 0, taskWriteCount = 0;
     
-    uint64 bytesWritten = ftell(out);
-    long pos;
+    uint64 pos;
     bool firstTime = true;
     unsigned int sec = 0, msec = 0, taskLastWriteCount = 0;
     
+    // By default, leave a processor each for the foreground and this thread
+    if (compressThreadCount < 0)
+    {
+        compressThreadCount = get_nprocs() - 2;
+        if (compressThreadCount < 0) compressThreadCount = 0;
+        if (compressThreadCount > MAX_DEFAULT_COMPRESS_THREADS) compressThreadCount = MAX_DEFAULT_COMPRESS_THREADS;
+    }
+    printf("MIDDLE_COMPRESS_THREADS: %d\n", compressThreadCount);
+    sections.setCompressThreads(compressThreadCount);
+    
     //
     // noMoreTasks is a flag from the foreground thread
     //   And if there are no more, then there is the worklist of ready tasks
@@ -391,161 +453,65 @@ void* backgroundTaskWriter(void* v)
         while (!writeTaskQueue.empty())
         {
             Task* t = writeTaskQueue.front();
-            TaskId id = t->getTaskId();
-            
             writeTaskQueue.pop_front();
             
             // Task will be null if it has already been handled
             assert(t != NULL);
-            // Write out the task
-            pos = ftell(out);
             
             // TaskIndex is a graph, then use the graph to
             //   determine the bfs order, this way tasks can be written out
             //   immediately
-            {
-                TaskWrapper tw;
-                
-                tw.self = id;
-                tw.start = t->getStartTime();
-                tw.p = t->getPredecessorTasks().size();
-                tw.s = t->getSuccessorTasks();
-                tw.t = t->getType();
-                tw.writePos = pos;
-                assert(writeTaskMap.find(id) == writeTaskMap.end());
-                writeTaskMap[id] = tw;
-                
-                /* Debugging code for bug where TaskId(x:0) had multiple predecessors
-                if (id.getSeqId() == 0)
-                {
-                    printf("%u:%u -- ", id.getContextId(), id.getSeqId());
-                    auto pr = t->getPredecessorTasks();
-                    for (auto it = pr.begin(), et = pr.end(); it != et; ++it)
-                    {
-                        printf("%s\t", it->toString().c_str());
-                    }
-                    printf("\n");
-                }*/
-                //printf("%s", t->toSummaryString().c_str());
-            }
-            
-            bytesWritten += Task::writeContechTask(*t, out);
+            taskIndex.addTask(*t, sections.addTask(*t));
             taskWriteCount += 1;
-                
+            
             // Delete the task
             delete t;
         }
         taskLastWriteCount = taskWriteCount;
     }
     
-    // Write how many entries are in the index
-    //   The write each index entry pair
-    pos = ftell(out);
-    if (pos == -1)
-    {
-        //int esav = errno;
-        perror("Cannot identify index position");
-    }
+    // Write the last, partial block, and then the index at an aligned position
+    sections.finishBlocks();
+    pos = sections.startIndex();
     {
         struct timeb tp;
         ftime(&tp);
-        printf("MIDDLE_TASK: %d.%03d\n", (unsigned int)tp.time, tp.millitm);
+        printf("MIDDLE_TASK: %d.%03d\t%lu KB\n", (unsigned int)tp.time, tp.millitm, getPeakMemoryKB());
     }
-    printf("Writing index for %lu at %ld\n", taskWriteCount, pos);
+    printf("Writing index for %lu at %lu\n", taskWriteCount, pos);
     size_t t = ct_write(&taskWriteCount, sizeof(taskWriteCount), out);
+    uint64 contextCount = taskIndex.getContextCount();
+    ct_write(&contextCount, sizeof(contextCount), out);
     
-    priority_queue<pair<ct_tsc_t, pair<TaskId, uint64> >, vector<pair<ct_tsc_t, pair<TaskId, uint64> > >, first_compare > taskSort;
-    
-    {
-        TaskWrapper tw = writeTaskMap.find(0)->second;
-        taskSort.push(make_pair(tw.start, make_pair(tw.self, tw.writePos)));
-    }
-    
-    //
-    // This reproduces the BFS algorithm that had been used for writing tasks
-    //   It is much faster to sort the tasks on just the graph information than
-    //   to indefinitely delay writing a task until the entire graph is available.
-    //
-    // taskSort is a priority queue, the top element is the oldest task that has all
-    //   its prior tasks in the index.
-    //
-    unsigned int indexWriteCount = 0;
     TaskId lastTid = 0;
-    while (!taskSort.empty())
-    {
-        TaskId tid = taskSort.top().second.first;
-        uint64 offset = taskSort.top().second.second;
-        
-        lastTid = tid;
-        
-        ct_write(&tid, sizeof(TaskId), out);
-        ct_write(&offset, sizeof(uint64), out);
-        //printf("%d:%d @ %llx\t", tid.getContextId(), tid.getSeqId(), offset);
-        
-        taskSort.pop();
-        
-        auto twit = writeTaskMap.find(tid);
-        assert(twit != writeTaskMap.end());
-        TaskWrapper tw = twit->second;
-        
-        assert(twit->first == tw.self);
-        
-        for (TaskId succ : tw.s)
-        {
-            TaskWrapper &suTW = writeTaskMap.find(succ)->second;
-            
-            //printf("%d:%d (%d)\t", succ.getContextId(), succ.getSeqId(), suTW.p);
-            
-            suTW.p--;
-            if (suTW.p == 0)
-            {
-                taskSort.push(make_pair(suTW.start, make_pair(suTW.self, suTW.writePos)));
-            }
-        }
-        //printf("\n");
-        
-        //  Can erase tid, but we don't need the memory, will it speed up?
-        writeTaskMap.erase(twit);
-        indexWriteCount ++;
-    }
-    printf("Wrote %u tasks to index\n", indexWriteCount);
-    
-    if (indexWriteCount != taskWriteCount)
-    {
-        for (auto it = writeTaskMap.begin(), et = writeTaskMap.end(); it != et; ++it)
-        {
-            printf("%s (type:%d) (pred:%d)\t", it->first.toString().c_str(), it->second.t, it->second.p);
-            for (TaskId succ : it->second.s)
-            {
-                printf("%s\t", succ.toString().c_str());
-            }
-            printf("\n");
-        }
-    }
+    uint64 indexWriteCount = taskIndex.writeIndex(out, lastTid, sections);
+    printf("Wrote %lu tasks to index\n", indexWriteCount);
+    printf("MIDDLE_INDEX_PEAK: %lu KB\n", getPeakMemoryKB());
     
     // Failing this assert indicates that the graph either has cycles or is disjoint
     //   Both case are bad
     assert(indexWriteCount == taskWriteCount);
     
-    // Now write the position of the index
-    fseek(out, 4, SEEK_SET);
-    
-    // With ftell, we use long, rather than the uint64 type which we track positions
-    ct_write(&pos, sizeof(pos), out);
+    // The block offsets, summaries, basic block sequences and address summaries follow the index
+    sections.writeSections();
+    printf("Wrote %u basic block sequences\n", sections.getSequences().getSequenceCount());
     
-    // Write the ROI start and end after index
-    ct_write(&roiStart, sizeof(TaskId), out);
+    // Now write the position of the index, and the ROI start and end
     if (roiEnd == 0)
     {
         roiEnd = lastTid;
     }
-    ct_write(&roiEnd, sizeof(TaskId), out);
+    sections.writeHeader(pos, roiStart, roiEnd);
     
     //
     // Stats for the background thread.
     //  TaskCount should equal taskWriteCount
     //  And there should be no tasks remaining.
     //
+    if (roiOnly && !roiStarted)
+    {
+        printf("ROI only output requested, but the trace has no ROI.  No task has actions.\n");
+    }
     printf("Tasks Received: %ld\n", taskCount);
     printf("Tasks Written: %ld\n", taskWriteCount);
     if (taskQueue != NULL)
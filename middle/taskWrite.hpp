@@ -2,6 +2,7 @@
 #define TASK_WRITE_HPP
 
 #include "../common/taskLib/Task.hpp"
+#include "../common/eventLib/ct_event.h"
 #include "Context.hpp"
 #include "pthread.h"
 #include <deque>
@@ -15,7 +16,16 @@ void updateContextTaskList(contech::Context &c);
 void attemptBackgroundQueueTask(contech::Task* t, contech::Context &c);
 void backgroundQueueTask(contech::Task* t);
 
-void setROIStart(contech::TaskId);
-void setROIEnd(contech::TaskId);
+void setROIStart(contech::TaskId, ct_tsc_t);
+void setROIEnd(contech::TaskId, ct_tsc_t);
+
+// Output modes
+//   bbOnly - drop memory actions from every task, keeping the memop counts
+//   roi - drop the actions of tasks outside the ROI, keeping the tasks and edges
+void setOutputMode(bool bbOnly, bool roi);
+bool outputBasicBlocksOnly();
+
+// Number of threads compressing tasks for the background writer, -1 picks from the processor count
+void setCompressThreads(int);
 
 #endif
\ No newline at end of file